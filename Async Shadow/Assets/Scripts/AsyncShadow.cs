@@ -1,4 +1,5 @@
-﻿using System.Runtime.InteropServices;
+﻿using System.Collections.Generic;
+using System.Runtime.InteropServices;
 using UnityEngine;
 using UnityEngine.Rendering;
 
@@ -16,6 +17,8 @@ public class AsyncShadow : MonoBehaviour
     static extern void ReleaseResources();
     [DllImport("AsyncShadow")]
     static extern bool SendMeshData(System.IntPtr _vb, System.IntPtr _ib, int _vertCount, int _indexCount);
+    [DllImport("AsyncShadow")]
+    static extern bool SendMeshBounds(System.IntPtr _vb, float[] _center, float[] _extents, float _radius);
     [DllImport("AsyncShadow")]
     static extern bool SendTextureData(System.IntPtr _texture);
     [DllImport("AsyncShadow")]
@@ -24,16 +27,71 @@ public class AsyncShadow : MonoBehaviour
     static extern void RenderShadows(bool _multiThread, float _fakeDelayTime);
     [DllImport("AsyncShadow")]
     static extern void SetObjectTransform(int _index, float[] _pos, float[] _scale, float[] _rot);
+    [DllImport("AsyncShadow")]
+    static extern void SetObjectTransforms(int _first, int _count, float[] _pos, float[] _scale, float[] _rot);
+    [DllImport("AsyncShadow")]
+    static extern void SetObjectTransformsIndexed(int[] _indices, int _count, float[] _pos, float[] _scale, float[] _rot);
+    [DllImport("AsyncShadow")]
+    static extern void SetTransformArena(bool _enable);
+    [DllImport("AsyncShadow")]
+    static extern System.IntPtr GetTransformArena();
+    [DllImport("AsyncShadow")]
+    static extern System.IntPtr PublishTransformArena(ulong _sequence);
     [DllImport("AsyncShadow")]
     static extern void SetObjTextureIndex(int _index, int _texIndex);
     [DllImport("AsyncShadow")]
+    static extern void SetObjectBounds(int _index, float[] _center, float[] _extents);
+    [DllImport("AsyncShadow")]
     static extern void SetLightTransform(float[] _lightPos, float[] _lightDir, float _radius);
     [DllImport("AsyncShadow")]
     static extern void GetLightTransform(float[] _shadowTransform);
     [DllImport("AsyncShadow")]
+    static extern void SetCameraFrustum(float[] _corners);
+    [DllImport("AsyncShadow")]
     static extern double GetShadowRenderTime();
     [DllImport("AsyncShadow")]
     static extern void SetRenderMethod(bool _useIndirect, bool _useBundle);
+    [DllImport("AsyncShadow")]
+    static extern void SetCullingMethod(int _method);
+    [DllImport("AsyncShadow")]
+    static extern void SetOcclusionCulling(bool _enable);
+    [DllImport("AsyncShadow")]
+    static extern void SetObjectOccluder(int _index, float[] _center, float[] _extents);
+    [DllImport("AsyncShadow")]
+    static extern void SetContributionCulling(float _minTexels);
+    [DllImport("AsyncShadow")]
+    static extern void GetCullingStats(int[] _stats);
+    [DllImport("AsyncShadow")]
+    static extern void SetObjectDataLayout(int _layout);
+    [DllImport("AsyncShadow")]
+    static extern void SetRecordListCount(int _count);
+    [DllImport("AsyncShadow")]
+    static extern int GetRecordTimes(double[] _times);
+    [DllImport("AsyncShadow")]
+    static extern void SetFenceSpinTime(float _us);
+    [DllImport("AsyncShadow")]
+    static extern void GetFenceStats(double[] _stats);
+    [DllImport("AsyncShadow")]
+    static extern int AddCaster(System.IntPtr _vb, System.IntPtr _ib, int _vertCount, int _indexCount, float[] _pos, float[] _scale, float[] _rot, int _texIndex);
+    [DllImport("AsyncShadow")]
+    static extern void RemoveCaster(int _handle);
+    [DllImport("AsyncShadow")]
+    static extern void UpdateCaster(int _handle, float[] _pos, float[] _scale, float[] _rot, int _texIndex);
+
+    public enum CullingMethod
+    {
+        Linear = 0,
+        BVH,
+        Temporal,
+        Grid
+    }
+
+    public enum ObjectDataLayout
+    {
+        ConstantBuffer = 0,
+        Structured,
+        Quantized
+    }
 
     public Mesh[] randomMeshes;
     public Texture2D[] randomTextures;
@@ -47,6 +105,22 @@ public class AsyncShadow : MonoBehaviour
     public bool multiThread = true;
     public bool indirectDrawing = false;
     public bool bundleDrawing = false;
+    [Tooltip("Command lists direct draws are recorded into in parallel. Bundle and indirect drawing always use one.")]
+    [Range(1, 8)]
+    public int recordLists = 1;
+    [Tooltip("Microseconds the shadow thread polls the GPU fence before it blocks. 0 blocks right away.")]
+    [Range(0, 500)]
+    public float fenceSpinTime = 50.0f;
+    [Tooltip("Structured packs object data to 52 bytes instead of a 256-byte constant buffer, Quantized to 20 bytes for static casters. Applied at startup.")]
+    public ObjectDataLayout objectDataLayout = ObjectDataLayout.ConstantBuffer;
+    [Tooltip("Write transforms straight into the native arena instead of passing arrays. Applied at startup.")]
+    public bool transformArena = false;
+    public CullingMethod cullingMethod = CullingMethod.Linear;
+    public bool occlusionCulling = false;
+    [Tooltip("Casters covering fewer shadow texels than this are skipped. 0 disables it.")]
+    public float minShadowTexels = 0.0f;
+    [Tooltip("Skip casters whose shadow can't land inside the main camera frustum.")]
+    public bool receiverCulling = false;
     public int shadowMapSize = 2048;
     public Light mainLight;
     public float directionalShadowRadius = 100.0f;
@@ -63,13 +137,21 @@ public class AsyncShadow : MonoBehaviour
     Transform mainLightTransform;
     Matrix4x4 shadowMatrix = Matrix4x4.identity;
 
-    // data buffer for sending to native
-    float[][] objPos;
-    float[][] objScale;
-    float[][] objRot;
+    // data buffer for sending to native, packed xyz / xyz / xyzw per object
+    float[] objPos;
+    float[] objScale;
+    float[] objRot;
+    float[] boundsCenter = new float[3];
+    float[] boundsExtents = new float[3];
     float[] lightPos = new float[3];
     float[] lightDir = new float[3];
     float[] shadowTransform = new float[16];
+    float[] cameraCorners = new float[24];
+    float[] casterPos = new float[3];
+    float[] casterScale = new float[3];
+    float[] casterRot = new float[4];
+    HashSet<Mesh> sentBounds = new HashSet<Mesh>();
+    Vector3[] frustumCorners = new Vector3[4];
 
     // camera cache
     Camera mainCamera;
@@ -84,6 +166,10 @@ public class AsyncShadow : MonoBehaviour
     GUIStyle guiStyle = new GUIStyle();
     float guiTime = 0.0f;
     double shadowTime = 0.0;
+    int[] cullingStats = new int[9];
+    double[] recordTimes = new double[8];
+    int recordedLists = 0;
+    double[] fenceStats = new double[5];
 #endif
 
     void Start ()
@@ -162,17 +248,32 @@ public class AsyncShadow : MonoBehaviour
         if (guiTime > 1.0f)
         {
             shadowTime = GetShadowRenderTime();
+            GetCullingStats(cullingStats);
+            recordedLists = GetRecordTimes(recordTimes);
+            GetFenceStats(fenceStats);
             guiTime = 0.0f;
         }
 
         guiRect.width = 550.0f * Screen.width / 1920;
-        guiRect.height = 85.0f * Screen.height / 1080;
+        guiRect.height = 315.0f * Screen.height / 1080;
 
         GUI.DrawTexture(guiRect, gTexture, ScaleMode.StretchToFill, true);
         guiStyle.fontSize = 40 * Screen.width / 1920;
         guiStyle.normal.textColor = Color.white;
 
         string msg = "Shadow Thread: " + shadowTime.ToString("F4") + " ms.";
+        msg += "\nDrawn: " + cullingStats[4] + " / " + cullingStats[0];
+        msg += "\nSmall: " + cullingStats[2] + " Occluded: " + cullingStats[3];
+        msg += "\nTested: " + cullingStats[5] + " Receiver: " + cullingStats[6];
+        msg += "\nUploaded: " + cullingStats[7] + " Object data: " + cullingStats[8] + " KB";
+        msg += "\nRecord:";
+        for (int i = 0; i < recordedLists; i++)
+        {
+            msg += " " + recordTimes[i].ToString("F3");
+        }
+        msg += " ms";
+        msg += "\nFence stalls: " + fenceStats[1] + " / " + fenceStats[0] + " (spin " + fenceStats[2] + ") "
+            + fenceStats[3].ToString("F2") + " ms, max " + fenceStats[4].ToString("F2") + " ms";
 
         GUI.Label(guiRect, msg, guiStyle);
 
@@ -200,7 +301,13 @@ public class AsyncShadow : MonoBehaviour
     void NativeUpdate()
     {
         SetRenderMethod(indirectDrawing, bundleDrawing);
+        SetRecordListCount(recordLists);
+        SetFenceSpinTime(fenceSpinTime);
+        SetCullingMethod((int)cullingMethod);
+        SetOcclusionCulling(occlusionCulling);
+        SetContributionCulling(minShadowTexels);
         UpdateLightTransform();
+        UpdateCameraFrustum();
         RenderShadows(multiThread, fakeDelayTime);
     }
 
@@ -212,6 +319,8 @@ public class AsyncShadow : MonoBehaviour
             return false;
         }
 
+        SetObjectDataLayout((int)objectDataLayout);
+        SetTransformArena(transformArena);
         InitMeshData();
         InitTextureData();
         if (!InitShadowMaps())
@@ -230,9 +339,9 @@ public class AsyncShadow : MonoBehaviour
         randomTransforms = new Transform[numberToGenerate];
         rangeToGenerate = Mathf.Abs(rangeToGenerate);
 
-        objPos = new float[numberToGenerate][];
-        objRot = new float[numberToGenerate][];
-        objScale = new float[numberToGenerate][];
+        objPos = new float[numberToGenerate * 3];
+        objRot = new float[numberToGenerate * 4];
+        objScale = new float[numberToGenerate * 3];
 
         MaterialPropertyBlock props = new MaterialPropertyBlock();
         for (int i = 0; i < numberToGenerate; i++)
@@ -275,22 +384,18 @@ public class AsyncShadow : MonoBehaviour
             randomTransforms[i] = randomObjects[i].transform;
 
             // cache object transform
-            objPos[i] = new float[3];
-            objScale[i] = new float[3];
-            objRot[i] = new float[4];
-
-            objPos[i][0] = randomTransforms[i].position.x;
-            objPos[i][1] = randomTransforms[i].position.y;
-            objPos[i][2] = randomTransforms[i].position.z;
-
-            objScale[i][0] = randomTransforms[i].lossyScale.x;
-            objScale[i][1] = randomTransforms[i].lossyScale.y;
-            objScale[i][2] = randomTransforms[i].lossyScale.z;
-
-            objRot[i][0] = randomTransforms[i].rotation.x;
-            objRot[i][1] = randomTransforms[i].rotation.y;
-            objRot[i][2] = randomTransforms[i].rotation.z;
-            objRot[i][3] = randomTransforms[i].rotation.w;
+            objPos[i * 3 + 0] = randomTransforms[i].position.x;
+            objPos[i * 3 + 1] = randomTransforms[i].position.y;
+            objPos[i * 3 + 2] = randomTransforms[i].position.z;
+
+            objScale[i * 3 + 0] = randomTransforms[i].lossyScale.x;
+            objScale[i * 3 + 1] = randomTransforms[i].lossyScale.y;
+            objScale[i * 3 + 2] = randomTransforms[i].lossyScale.z;
+
+            objRot[i * 4 + 0] = randomTransforms[i].rotation.x;
+            objRot[i * 4 + 1] = randomTransforms[i].rotation.y;
+            objRot[i * 4 + 2] = randomTransforms[i].rotation.z;
+            objRot[i * 4 + 3] = randomTransforms[i].rotation.w;
         }
     }
 
@@ -303,10 +408,78 @@ public class AsyncShadow : MonoBehaviour
             if (!SendMeshData(mf.sharedMesh.GetNativeVertexBufferPtr(0), mf.sharedMesh.GetNativeIndexBufferPtr(), mf.sharedMesh.vertexCount, mf.sharedMesh.GetIndices(0).Length))
             {
                 Debug.LogError("Set mesh data failed. " + mf.gameObject.name + " will be ignored.");
+                continue;
+            }
+
+            // local bounds once per unique mesh, native side derives world bounds from transforms
+            if (sentBounds.Add(mf.sharedMesh))
+            {
+                SendLocalBounds(mf.sharedMesh);
             }
         }
     }
 
+    // casters streamed in after startup, the mesh needs a 32 bit index buffer like the generated ones.
+    // returns a handle for UpdateShadowCaster / RemoveShadowCaster, -1 if the caster couldn't be added
+    public int AddShadowCaster(Mesh _mesh, Transform _transform, int _texIndex)
+    {
+        if (sentBounds.Add(_mesh))
+        {
+            SendLocalBounds(_mesh);
+        }
+
+        CacheCasterTransform(_transform);
+        return AddCaster(_mesh.GetNativeVertexBufferPtr(0), _mesh.GetNativeIndexBufferPtr(), _mesh.vertexCount, _mesh.GetIndices(0).Length, casterPos, casterScale, casterRot, _texIndex);
+    }
+
+    public void UpdateShadowCaster(int _handle, Transform _transform, int _texIndex)
+    {
+        CacheCasterTransform(_transform);
+        UpdateCaster(_handle, casterPos, casterScale, casterRot, _texIndex);
+    }
+
+    public void RemoveShadowCaster(int _handle)
+    {
+        RemoveCaster(_handle);
+    }
+
+    void CacheCasterTransform(Transform _transform)
+    {
+        casterPos[0] = _transform.position.x;
+        casterPos[1] = _transform.position.y;
+        casterPos[2] = _transform.position.z;
+
+        casterScale[0] = _transform.lossyScale.x;
+        casterScale[1] = _transform.lossyScale.y;
+        casterScale[2] = _transform.lossyScale.z;
+
+        casterRot[0] = _transform.rotation.x;
+        casterRot[1] = _transform.rotation.y;
+        casterRot[2] = _transform.rotation.z;
+        casterRot[3] = _transform.rotation.w;
+    }
+
+    void SendLocalBounds(Mesh _mesh)
+    {
+        Bounds b = _mesh.bounds;
+        boundsCenter[0] = b.center.x;
+        boundsCenter[1] = b.center.y;
+        boundsCenter[2] = b.center.z;
+        boundsExtents[0] = b.extents.x;
+        boundsExtents[1] = b.extents.y;
+        boundsExtents[2] = b.extents.z;
+
+        // tight sphere around the box center, it beats the box for rotated round meshes
+        float radiusSq = 0.0f;
+        Vector3[] vertices = _mesh.vertices;
+        for (int i = 0; i < vertices.Length; i++)
+        {
+            radiusSq = Mathf.Max(radiusSq, (vertices[i] - b.center).sqrMagnitude);
+        }
+
+        SendMeshBounds(_mesh.GetNativeVertexBufferPtr(0), boundsCenter, boundsExtents, Mathf.Sqrt(radiusSq));
+    }
+
     void InitTextureData()
     {
         for (int i = 0; i < randomTextures.Length; i++)
@@ -342,14 +515,85 @@ public class AsyncShadow : MonoBehaviour
     {
         mainLightTransform = mainLight.transform;
 
+        // set transform once, one call for every object
+        if (!WriteTransformArena())
+        {
+            SetObjectTransforms(0, randomObjects.Length, objPos, objScale, objRot);
+        }
+
         for (int i = 0; i < randomObjects.Length; i++)
         {
-            // set transform once
-            SetObjectTransform(i, objPos[i], objScale[i], objRot[i]);
             SetObjTextureIndex(i, (i > numberToGenerate / 2) ? i % randomTextures.Length : -1);
         }
     }
 
+    bool WriteTransformArena()
+    {
+        System.IntPtr arena = GetTransformArena();
+        if (arena == System.IntPtr.Zero)
+        {
+            return false;
+        }
+
+        // header: ulong sequence, uint count, stride, dirty offset, dirty words, record offset
+        long basePtr = arena.ToInt64();
+        int stride = Marshal.ReadInt32(arena, 12);
+        int dirtyOffset = Marshal.ReadInt32(arena, 16);
+        int dirtyWords = Marshal.ReadInt32(arena, 20);
+        int recordOffset = Marshal.ReadInt32(arena, 24);
+
+        // records are pos xyz, scale xyz, rot xyzw
+        const int recordFloats = 10;
+        if (stride != recordFloats * sizeof(float))
+        {
+            return false;
+        }
+
+        int count = randomObjects.Length;
+        float[] records = new float[count * recordFloats];
+        int[] dirty = new int[dirtyWords];
+        for (int i = 0; i < count; i++)
+        {
+            System.Array.Copy(objPos, i * 3, records, i * recordFloats, 3);
+            System.Array.Copy(objScale, i * 3, records, i * recordFloats + 3, 3);
+            System.Array.Copy(objRot, i * 4, records, i * recordFloats + 6, 4);
+            dirty[i >> 5] |= 1 << (i & 31);
+        }
+
+        Marshal.Copy(records, 0, new System.IntPtr(basePtr + recordOffset), records.Length);
+        Marshal.Copy(dirty, 0, new System.IntPtr(basePtr + dirtyOffset), dirty.Length);
+        PublishTransformArena((ulong)Time.frameCount);
+
+        return true;
+    }
+
+    void UpdateCameraFrustum()
+    {
+        if (!receiverCulling || mainCamera == null)
+        {
+            SetCameraFrustum(null);
+            return;
+        }
+
+        // near plane corners then far plane corners, in world space
+        Transform camTransform = mainCamera.transform;
+        for (int i = 0; i < 2; i++)
+        {
+            float dist = (i == 0) ? mainCamera.nearClipPlane : mainCamera.farClipPlane;
+            mainCamera.CalculateFrustumCorners(new Rect(0, 0, 1, 1), dist, Camera.MonoOrStereoscopicEye.Mono, frustumCorners);
+
+            for (int j = 0; j < 4; j++)
+            {
+                Vector3 corner = camTransform.position + camTransform.TransformVector(frustumCorners[j]);
+                cameraCorners[(i * 4 + j) * 3 + 0] = corner.x;
+                cameraCorners[(i * 4 + j) * 3 + 1] = corner.y;
+                cameraCorners[(i * 4 + j) * 3 + 2] = corner.z;
+            }
+        }
+
+        SetCameraFrustum(cameraCorners);
+    }
+
     void UpdateLightTransform()
     {
         mainLightTransform.Rotate(0.0f, 20.0f * Time.deltaTime, 0.0f, Space.World);
@@ -1,8 +1,35 @@
+#ifdef STRUCTURED_OBJECT_DATA
+#ifdef QUANTIZED_OBJECT_DATA
+// 20-byte static layout, see QuantizedTransform in ShadowQuantize.h for the encoding
+struct ObjectData
+{
+	uint packed[5];
+};
+
+// xyz origin of each sector, w is the length of one position step
+StructuredBuffer<float4> gSectors : register(t1, space1);
+#else
+// compact layout, world stored as the first three rows, last row is (0, 0, 0, 1)
+struct ObjectData
+{
+	float4 world[3];
+	uint texIndex;
+};
+#endif
+
+cbuffer cbObjectIndex : register(b0)
+{
+	uint gObjectIndex;
+};
+
+StructuredBuffer<ObjectData> gObjects : register(t0, space1);
+#else
 cbuffer cbPerObject : register(b0)
 {
     float4x4 gWorld;
 	uint gTexIndex;
 };
+#endif
 
 cbuffer cbPass : register(b1)
 {
@@ -24,14 +51,58 @@ struct VOut
 {
 	float4 vertex    : SV_POSITION;
 	float2 uv : TEXCOORD;
+	nointerpolation uint texIndex : TEXINDEX;
 };
 
+#ifdef QUANTIZED_OBJECT_DATA
+// rows of the transposed scale * rotation * translation, the same matrix the plugin composes on the cpu
+float4x4 DecodeWorld(ObjectData obj, out uint texIndex)
+{
+	// smallest three, the dropped component is positive and rebuilt from the unit length
+	uint r = obj.packed[2];
+	float3 abc = (float3(r & 1023, (r >> 10) & 1023, (r >> 20) & 1023) / 1023.0f * 2.0f - 1.0f) * 0.70710678f;
+	float d = sqrt(saturate(1.0f - dot(abc, abc)));
+	uint largest = r >> 30;
+	float4 q = (largest == 0) ? float4(d, abc) : (largest == 1) ? float4(abc.x, d, abc.yz) : (largest == 2) ? float4(abc.xy, d, abc.z) : float4(abc, d);
+
+	float3 s = f16tof32(uint3(obj.packed[3], obj.packed[3] >> 16, obj.packed[4]));
+	float4 sector = gSectors[obj.packed[1] >> 16];
+	float3 p = sector.xyz + float3(obj.packed[0] & 0xffff, obj.packed[0] >> 16, obj.packed[1] & 0xffff) * sector.w;
+
+	float3 q2 = q.xyz * 2.0f;
+	float xx = q.x * q2.x, yy = q.y * q2.y, zz = q.z * q2.z;
+	float xy = q.x * q2.y, xz = q.x * q2.z, yz = q.y * q2.z;
+	float wx = q.w * q2.x, wy = q.w * q2.y, wz = q.w * q2.z;
+
+	uint tex = obj.packed[4] >> 16;
+	texIndex = (tex == 0xffff) ? 0xffffffff : tex;
+
+	return float4x4(
+		s.x * (1.0f - yy - zz), s.y * (xy - wz), s.z * (xz + wy), p.x,
+		s.x * (xy + wz), s.y * (1.0f - xx - zz), s.z * (yz - wx), p.y,
+		s.x * (xz - wy), s.y * (yz + wx), s.z * (1.0f - xx - yy), p.z,
+		0.0f, 0.0f, 0.0f, 1.0f);
+}
+#endif
+
 VOut VS(VIn i)
 {
 	VOut o = (VOut)0.0f;
 
     // Transform to world space.
+#ifdef STRUCTURED_OBJECT_DATA
+	ObjectData obj = gObjects[gObjectIndex];
+#ifdef QUANTIZED_OBJECT_DATA
+	float4x4 world = DecodeWorld(obj, o.texIndex);
+#else
+	float4x4 world = float4x4(obj.world[0], obj.world[1], obj.world[2], float4(0.0f, 0.0f, 0.0f, 1.0f));
+	o.texIndex = obj.texIndex;
+#endif
+	o.vertex = mul(world, float4(i.vertex, 1.0f));
+#else
     o.vertex = mul(float4(i.vertex, 1.0f), gWorld);
+	o.texIndex = gTexIndex;
+#endif
 	o.vertex = mul(o.vertex, gViewProj);
 	
 	o.uv = i.uv;
@@ -41,9 +112,9 @@ VOut VS(VIn i)
 
 void PS(VOut i) 
 {
-	if(gTexIndex != -1)
+	if(i.texIndex != -1)
 	{
-		float alpha = cutoutMaps[gTexIndex].Sample(samAnisoWrap, i.uv);
+		float alpha = cutoutMaps[i.texIndex].Sample(samAnisoWrap, i.uv);
 		clip(alpha - 0.5f);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,65 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "CasterRegistry.h"
+
+int CasterRegistry::Add(D3D12_VERTEX_BUFFER_VIEW _vbv, D3D12_INDEX_BUFFER_VIEW _ibv, int _mesh)
+{
+	CasterDraw draw;
+	draw.vbv = _vbv;
+	draw.ibv = _ibv;
+	draws.push_back(draw);
+	mesh.push_back(_mesh);
+
+	return (int)draws.size() - 1;
+}
+
+void CasterRegistry::Resize(int _count)
+{
+	CasterDraw emptyDraw = {};
+	world.resize(_count, Identity4x4);
+	bounds.Resize(_count);
+	flags.resize(_count, 0);
+	mesh.resize(_count, -1);
+	sector.resize(_count, 0);
+	draws.resize(_count, emptyDraw);
+	texIndex.resize(_count, -1);
+}
+
+void CasterRegistry::Clear()
+{
+	world.clear();
+	bounds.Clear();
+	flags.clear();
+	mesh.clear();
+	sector.clear();
+	draws.clear();
+	texIndex.clear();
+}
+
+int CasterRegistry::Size() const
+{
+	return (int)draws.size();
+}
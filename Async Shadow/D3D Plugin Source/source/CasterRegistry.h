@@ -0,0 +1,69 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include "stdafx.h"
+#include "ShadowCulling.h"
+#include <cstdint>
+
+// flags column, the low bits are the frame resources still holding old object data
+const BYTE CasterFlag_DirtyFrames = (1 << NumOfFrameResources) - 1;
+const BYTE CasterFlag_Alive = 0x80;
+
+// what recording a draw needs, vertex and index views share one line
+struct CasterDraw
+{
+	D3D12_VERTEX_BUFFER_VIEW vbv;
+	D3D12_INDEX_BUFFER_VIEW ibv;
+};
+
+// every caster as one index into a set of columns.
+// hot columns are walked by culling, packing and bounds updates every frame, cold ones only when draws are recorded.
+// all columns always have the same size, free slots stay in them with the alive flag cleared.
+class CasterRegistry
+{
+public:
+	// appends a caster before the other columns are sized, returns its index
+	int Add(D3D12_VERTEX_BUFFER_VIEW _vbv, D3D12_INDEX_BUFFER_VIEW _ibv, int _mesh);
+
+	// grows or shrinks every column, new entries are free slots with identity world and unknown bounds
+	void Resize(int _count);
+	void Clear();
+	int Size() const;
+
+	bool IsAlive(int _index) const
+	{
+		return (flags[_index] & CasterFlag_Alive) != 0;
+	}
+
+	// hot
+	vector<XMFLOAT4X4> world;		// transposed
+	ShadowBoundsStore bounds;
+	vector<BYTE> flags;
+	vector<int> mesh;				// -1 for a free slot that never had a mesh
+	vector<uint16_t> sector;		// quantized layout only
+
+	// cold
+	vector<CasterDraw> draws;
+	vector<int> texIndex;
+};
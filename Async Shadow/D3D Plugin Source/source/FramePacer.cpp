@@ -0,0 +1,171 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "FramePacer.h"
+#include <chrono>
+#include <thread>
+
+FramePacer::FramePacer()
+	: spinUs(50.0f), frames(0), stalls(0), spinResolved(0), stallUs(0), maxStallUs(0)
+{
+
+}
+
+void FramePacer::Init(FrameFence * _fence, int _numFrames, uint64_t _firstValue)
+{
+	fence = _fence;
+	fenceValues.assign(_numFrames, _firstValue);
+	lastSignaled = (_firstValue > 0) ? _firstValue - 1 : 0;
+	frameIndex = 0;
+}
+
+int FramePacer::GetFrameIndex()
+{
+	return frameIndex;
+}
+
+void FramePacer::SetSpinTime(float _us)
+{
+	spinUs.store((_us > 0.0f) ? _us : 0.0f, memory_order_relaxed);
+}
+
+FenceStats FramePacer::GetStats(bool _reset)
+{
+	FenceStats stats;
+	if (_reset)
+	{
+		stats.frames = frames.exchange(0, memory_order_relaxed);
+		stats.stalls = stalls.exchange(0, memory_order_relaxed);
+		stats.spinResolved = spinResolved.exchange(0, memory_order_relaxed);
+		stats.stallMs = stallUs.exchange(0, memory_order_relaxed) / 1000.0;
+		stats.maxStallMs = maxStallUs.exchange(0, memory_order_relaxed) / 1000.0;
+	}
+	else
+	{
+		stats.frames = frames.load(memory_order_relaxed);
+		stats.stalls = stalls.load(memory_order_relaxed);
+		stats.spinResolved = spinResolved.load(memory_order_relaxed);
+		stats.stallMs = stallUs.load(memory_order_relaxed) / 1000.0;
+		stats.maxStallMs = maxStallUs.load(memory_order_relaxed) / 1000.0;
+	}
+
+	return stats;
+}
+
+bool FramePacer::WaitForValue(int _slot, uint64_t _value)
+{
+	if (fence->GetCompletedValue() >= _value)
+	{
+		return true;
+	}
+
+	// poll first, a blocking wait costs a kernel round trip on both ends
+	auto start = chrono::steady_clock::now();
+	auto spinEnd = start + chrono::nanoseconds((int64_t)(spinUs.load(memory_order_relaxed) * 1000.0f));
+	bool completed = false;
+	while (chrono::steady_clock::now() < spinEnd)
+	{
+		if (fence->GetCompletedValue() >= _value)
+		{
+			completed = true;
+			break;
+		}
+		this_thread::yield();
+	}
+
+	if (!completed && !fence->Wait(_slot, _value))
+	{
+		return false;
+	}
+
+	uint64_t us = (uint64_t)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+	stalls.fetch_add(1, memory_order_relaxed);
+	spinResolved.fetch_add(completed ? 1 : 0, memory_order_relaxed);
+	stallUs.fetch_add(us, memory_order_relaxed);
+	if (us > maxStallUs.load(memory_order_relaxed))
+	{
+		maxStallUs.store(us, memory_order_relaxed);
+	}
+
+	return true;
+}
+
+bool FramePacer::NextFrame()
+{
+	if (fence == nullptr)
+	{
+		return false;
+	}
+
+	// Schedule a Signal command in the queue.
+	const uint64_t currentFenceValue = fenceValues[frameIndex];
+	if (!fence->Signal(currentFenceValue))
+	{
+		return false;
+	}
+	lastSignaled = currentFenceValue;
+
+	// Cycle through the circular frame resource array.
+	frameIndex = (frameIndex + 1) % (int)fenceValues.size();
+
+	// If the next frame is not ready to be rendered yet, wait until it is ready.
+	if (!WaitForValue(frameIndex, fenceValues[frameIndex]))
+	{
+		return false;
+	}
+
+	// Set the fence value for the next frame.
+	fenceValues[frameIndex] = currentFenceValue + 1;
+	frames.fetch_add(1, memory_order_relaxed);
+	return true;
+}
+
+bool FramePacer::Flush(int _frameIndex)
+{
+	if (fence == nullptr || _frameIndex < 0 || _frameIndex >= (int)fenceValues.size())
+	{
+		return false;
+	}
+
+	if (_frameIndex != frameIndex)
+	{
+		// nothing was signalled for a slot that hasn't been used since Init()
+		return (fenceValues[_frameIndex] > lastSignaled) || WaitForValue(_frameIndex, fenceValues[_frameIndex]);
+	}
+
+	if (!fence->Signal(fenceValues[_frameIndex]))
+	{
+		return false;
+	}
+	lastSignaled = fenceValues[_frameIndex];
+
+	if (!WaitForValue(_frameIndex, fenceValues[_frameIndex]))
+	{
+		return false;
+	}
+
+	fenceValues[_frameIndex]++;
+	return true;
+}
@@ -0,0 +1,96 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// the queue and fence frame pacing runs against, the render queue in the plugin and a fake one anywhere else
+class FrameFence
+{
+public:
+	virtual ~FrameFence() { }
+
+	// the fence reaches _value once the work submitted so far is done
+	virtual bool Signal(uint64_t _value) = 0;
+	virtual uint64_t GetCompletedValue() = 0;
+
+	// blocks until the fence reaches _value, every frame slot has its own wait object
+	virtual bool Wait(int _slot, uint64_t _value) = 0;
+};
+
+// waits on the fence since the last GetStats(true)
+struct FenceStats
+{
+	uint64_t frames;
+	uint64_t stalls;			// waits that found the fence behind
+	uint64_t spinResolved;		// stalls the spin covered without blocking
+	double stallMs;
+	double maxStallMs;
+};
+
+// fence bookkeeping of the frame resources. every frame resource keeps the fence value that retires it,
+// the CPU only waits when it comes back around to one the GPU is still using.
+class FramePacer
+{
+public:
+	FramePacer();
+	FramePacer(const FramePacer& rhs) = delete;
+	FramePacer& operator=(const FramePacer& rhs) = delete;
+
+	// _firstValue is what every frame resource waits for first, the fence starts below it
+	void Init(FrameFence *_fence, int _numFrames, uint64_t _firstValue);
+
+	int GetFrameIndex();
+
+	// how long a wait polls the fence before it blocks, the GPU is often only a few microseconds behind
+	void SetSpinTime(float _us);
+
+	// safe to call from any thread, _reset starts a new window
+	FenceStats GetStats(bool _reset);
+
+	// signals the end of the current frame and moves to the next frame resource, waits while the GPU still uses it
+	bool NextFrame();
+
+	// waits until everything submitted for _frameIndex is done, the current frame is signalled first.
+	// other frames already signalled their value at the end of the frame, signalling it again would move the fence back
+	bool Flush(int _frameIndex);
+
+private:
+	bool WaitForValue(int _slot, uint64_t _value);
+
+	FrameFence *fence = nullptr;
+	vector<uint64_t> fenceValues;
+	uint64_t lastSignaled = 0;
+	int frameIndex = 0;
+	atomic<float> spinUs;
+
+	// written by the waiting thread, read and reset by whoever asks for stats
+	atomic<uint64_t> frames;
+	atomic<uint64_t> stalls;
+	atomic<uint64_t> spinResolved;
+	atomic<uint64_t> stallUs;
+	atomic<uint64_t> maxStallUs;
+};
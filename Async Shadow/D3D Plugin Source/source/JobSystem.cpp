@@ -0,0 +1,206 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#include "JobSystem.h"
+
+JobSystem::JobSystem()
+	: running(false), pendingJobs(0)
+{
+
+}
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+void JobSystem::Init(int _numWorkers)
+{
+	Shutdown();
+
+	if (_numWorkers <= 0)
+	{
+		int hardwareThreads = (int)thread::hardware_concurrency();
+		_numWorkers = (hardwareThreads > 1) ? hardwareThreads - 1 : 0;
+	}
+
+	running = true;
+	pendingJobs = 0;
+
+	for (int i = 0; i < _numWorkers; i++)
+	{
+		queues.push_back(make_unique<WorkerQueue>());
+	}
+
+	for (int i = 0; i < _numWorkers; i++)
+	{
+		workers.push_back(thread(&JobSystem::WorkerThread, this, i));
+	}
+}
+
+void JobSystem::Shutdown()
+{
+	{
+		lock_guard<mutex> lk(sleepMutex);
+		running = false;
+	}
+	sleepCv.notify_all();
+
+	for (int i = 0; i < (int)workers.size(); i++)
+	{
+		if (workers[i].joinable())
+		{
+			workers[i].join();
+		}
+	}
+
+	workers.clear();
+	queues.clear();
+	pendingJobs = 0;
+}
+
+int JobSystem::GetThreadCount()
+{
+	return (int)workers.size() + 1;
+}
+
+void JobSystem::ParallelFor(int _count, int _chunkSize, const function<void(int, int, int)> &_func)
+{
+	if (_count <= 0)
+	{
+		return;
+	}
+
+	int numChunks = (_count + _chunkSize - 1) / _chunkSize;
+
+	// nothing to share, run inline
+	if (numChunks == 1 || queues.empty())
+	{
+		for (int c = 0; c < numChunks; c++)
+		{
+			int begin = c * _chunkSize;
+			int end = (begin + _chunkSize < _count) ? begin + _chunkSize : _count;
+			_func(begin, end, c);
+		}
+		return;
+	}
+
+	atomic<int> remaining(numChunks);
+
+	// deal chunks round robin, stealing balances whatever this gets wrong
+	for (int c = 0; c < numChunks; c++)
+	{
+		Job job;
+		job.func = &_func;
+		job.begin = c * _chunkSize;
+		job.end = (job.begin + _chunkSize < _count) ? job.begin + _chunkSize : _count;
+		job.chunk = c;
+		job.remaining = &remaining;
+
+		WorkerQueue &queue = *queues[c % queues.size()];
+		lock_guard<mutex> lk(queue.lock);
+		queue.jobs.push_back(job);
+	}
+
+	{
+		lock_guard<mutex> lk(sleepMutex);
+		pendingJobs += numChunks;
+	}
+	sleepCv.notify_all();
+
+	// caller helps instead of waiting idle
+	while (remaining.load(memory_order_acquire) > 0)
+	{
+		Job job;
+		if (PopOrSteal(-1, job))
+		{
+			Execute(job);
+		}
+		else
+		{
+			this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::WorkerThread(int _workerIndex)
+{
+	while (true)
+	{
+		Job job;
+		if (PopOrSteal(_workerIndex, job))
+		{
+			Execute(job);
+			continue;
+		}
+
+		unique_lock<mutex> lk(sleepMutex);
+		sleepCv.wait(lk, [this] { return !running || pendingJobs > 0; });
+		if (!running)
+		{
+			return;
+		}
+	}
+}
+
+bool JobSystem::PopOrSteal(int _workerIndex, Job &_job)
+{
+	int numQueues = (int)queues.size();
+
+	// own queue first, newest job is the one most likely still in cache
+	if (_workerIndex >= 0)
+	{
+		WorkerQueue &own = *queues[_workerIndex];
+		lock_guard<mutex> lk(own.lock);
+		if (!own.jobs.empty())
+		{
+			_job = own.jobs.back();
+			own.jobs.pop_back();
+			pendingJobs--;
+			return true;
+		}
+	}
+
+	// steal the oldest job of someone else
+	int start = (_workerIndex >= 0) ? _workerIndex + 1 : 0;
+	for (int i = 0; i < numQueues; i++)
+	{
+		WorkerQueue &victim = *queues[(start + i) % numQueues];
+		lock_guard<mutex> lk(victim.lock);
+		if (!victim.jobs.empty())
+		{
+			_job = victim.jobs.front();
+			victim.jobs.pop_front();
+			pendingJobs--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::Execute(const Job &_job)
+{
+	(*_job.func)(_job.begin, _job.end, _job.chunk);
+	_job.remaining->fetch_sub(1, memory_order_release);
+}
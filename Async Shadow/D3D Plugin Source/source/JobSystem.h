@@ -0,0 +1,82 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+using namespace std;
+
+// fixed pool of workers with one deque each, owners pop from the back and idle workers steal from the front
+class JobSystem
+{
+public:
+	JobSystem();
+	~JobSystem();
+	JobSystem(const JobSystem& rhs) = delete;
+	JobSystem& operator=(const JobSystem& rhs) = delete;
+
+	// _numWorkers <= 0 uses every hardware thread except the calling one
+	void Init(int _numWorkers);
+	void Shutdown();
+
+	// threads that execute jobs, the caller of ParallelFor included
+	int GetThreadCount();
+
+	// splits [0, _count) into chunks of _chunkSize and blocks until all chunks are done.
+	// _func(begin, end, chunkIndex) must only write data owned by its chunk.
+	void ParallelFor(int _count, int _chunkSize, const function<void(int, int, int)> &_func);
+
+private:
+	struct Job
+	{
+		const function<void(int, int, int)> *func;
+		int begin;
+		int end;
+		int chunk;
+		atomic<int> *remaining;
+	};
+
+	struct WorkerQueue
+	{
+		mutex lock;
+		deque<Job> jobs;
+	};
+
+	void WorkerThread(int _workerIndex);
+	bool PopOrSteal(int _workerIndex, Job &_job);
+	void Execute(const Job &_job);
+
+	vector<thread> workers;
+	vector<unique_ptr<WorkerQueue>> queues;
+
+	atomic<bool> running;
+	atomic<int> pendingJobs;
+	mutex sleepMutex;
+	condition_variable sleepCv;
+};
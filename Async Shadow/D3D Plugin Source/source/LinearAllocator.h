@@ -0,0 +1,70 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include <cstdint>
+
+// bump allocator over one linear block. it hands out offsets only, the owner decides what memory backs them.
+// nothing is freed one by one, Reset() releases every allocation at once.
+class LinearAllocator
+{
+public:
+	void Init(uint64_t _capacity)
+	{
+		capacity = _capacity;
+		used = 0;
+	}
+
+	// _alignment must be a power of two. returns false and leaves the allocator untouched when it doesn't fit
+	bool Allocate(uint64_t _size, uint64_t _alignment, uint64_t &_offset)
+	{
+		uint64_t start = (used + _alignment - 1) & ~(_alignment - 1);
+		if (start > capacity || _size > capacity - start)
+		{
+			return false;
+		}
+
+		_offset = start;
+		used = start + _size;
+		return true;
+	}
+
+	void Reset()
+	{
+		used = 0;
+	}
+
+	uint64_t GetCapacity() const
+	{
+		return capacity;
+	}
+
+	uint64_t GetUsed() const
+	{
+		return used;
+	}
+
+private:
+	uint64_t capacity = 0;
+	uint64_t used = 0;
+};
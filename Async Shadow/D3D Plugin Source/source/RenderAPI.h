@@ -17,6 +17,12 @@ public:
 	// Process general event like initialization, shutdown, device loss/reset etc.
 	virtual void ProcessDeviceEvent(UnityGfxDeviceEventType type, IUnityInterfaces* interfaces) = 0;
 	virtual void SetRenderMethod(bool _useIndirect, bool _useBundle) = 0;
+	virtual void SetCullingMethod(int _method) = 0;
+	virtual void SetOcclusionCulling(bool _enable) = 0;
+	virtual void SetContributionCulling(float _minTexels) = 0;
+	virtual void SetObjectDataLayout(int _layout) = 0;
+	virtual void SetRecordListCount(int _count) = 0;
+	virtual void SetFenceSpinTime(float _us) = 0;
 
 	virtual bool CreateResources() = 0;
 	virtual void ReleaseResources() = 0;
@@ -24,17 +30,32 @@ public:
 
 	virtual bool CheckDevice() = 0;
 	virtual bool SetMeshData(void* _vertexBuffer, void* _indexBuffer, int _vertexCount, int _indexCount) = 0;
+	virtual bool SetMeshBounds(void* _vertexBuffer, float *_center, float *_extents, float _radius) = 0;
 	virtual void SetTextureData(void* _texture) = 0;
 	virtual bool SetShadowTextureData(void* _shadowTexture) = 0;
-	virtual void WorkerThread() = 0;
 	virtual void NotifyShadowThread(bool _multithread, float _fakeDelay) = 0;
 	virtual void InternalUpdate() = 0;
 	virtual bool RenderShadows() = 0;
 	virtual void SetObjectMatrix(int _index, XMMATRIX _matrix) = 0;
+	virtual void SetObjectTransforms(int _first, int _count, float *_pos, float *_scale, float *_rot) = 0;
+	virtual void SetObjectTransformsIndexed(int *_indices, int _count, float *_pos, float *_scale, float *_rot) = 0;
+	virtual void SetObjectTransformsSoA(int _first, int _count, float *_streams) = 0;
+	virtual void SetTransformArena(bool _enable) = 0;
+	virtual void *GetTransformArena() = 0;
+	virtual void *PublishTransformArena(unsigned long long _sequence) = 0;
 	virtual void SetObjTextureIndex(int _index, int _val) = 0;
+	virtual void SetObjectBounds(int _index, float *_center, float *_extents) = 0;
+	virtual void SetObjectOccluder(int _index, float *_center, float *_extents) = 0;
+	virtual int AddCaster(void* _vertexBuffer, void* _indexBuffer, int _vertexCount, int _indexCount, float *_pos, float *_scale, float *_rot, int _texIndex) = 0;
+	virtual void RemoveCaster(int _handle) = 0;
+	virtual void UpdateCaster(int _handle, float *_pos, float *_scale, float *_rot, int _texIndex) = 0;
 	virtual void SetLightTransform(float *_lightPos, float *_lightDir, float _radius) = 0;
 	virtual float *GetLightTransform() = 0;
+	virtual void SetCameraFrustum(float *_corners) = 0;
 	virtual double GetShadowTime() = 0;
+	virtual void GetCullingStats(int *_stats) = 0;
+	virtual int GetRecordTimes(double *_times) = 0;
+	virtual void GetFenceStats(double *_stats) = 0;
 };
 
 
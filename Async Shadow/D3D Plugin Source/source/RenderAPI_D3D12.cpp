@@ -2,12 +2,84 @@
 #include "PlatformBase.h"
 #include "stdafx.h"
 #include "ShadowMap.h"
+#include "FramePacer.h"
+#include "Threading.h"
 
 // Direct3D 12 implementation of RenderAPI.
 
 
 #if SUPPORT_D3D12
 
+// frame pacing waits on the render queue's fence
+class D3D12FrameFence : public FrameFence
+{
+public:
+	virtual ~D3D12FrameFence() { Release(); }
+
+	void Init(ID3D12CommandQueue *_queue, ID3D12Fence *_fence);
+	void Release();
+
+	virtual bool Signal(uint64_t _value);
+	virtual uint64_t GetCompletedValue();
+	virtual bool Wait(int _slot, uint64_t _value);
+
+private:
+	ID3D12CommandQueue *queue = nullptr;
+	ID3D12Fence *fence = nullptr;
+
+	// one per frame slot, created with the fence and reused by every wait on that slot
+	HANDLE fenceEvents[NumOfFrameResources] = {};
+};
+
+void D3D12FrameFence::Init(ID3D12CommandQueue * _queue, ID3D12Fence * _fence)
+{
+	queue = _queue;
+	fence = _fence;
+
+	for (int i = 0; i < NumOfFrameResources; i++)
+	{
+		if (fenceEvents[i] == nullptr)
+		{
+			fenceEvents[i] = CreateEvent(NULL, FALSE, FALSE, NULL);
+		}
+	}
+}
+
+void D3D12FrameFence::Release()
+{
+	queue = nullptr;
+	fence = nullptr;
+
+	for (int i = 0; i < NumOfFrameResources; i++)
+	{
+		SafeClose(fenceEvents[i]);
+		fenceEvents[i] = nullptr;
+	}
+}
+
+bool D3D12FrameFence::Signal(uint64_t _value)
+{
+	return queue != nullptr && fence != nullptr && SUCCEEDED(queue->Signal(fence, _value));
+}
+
+uint64_t D3D12FrameFence::GetCompletedValue()
+{
+	return (fence != nullptr) ? fence->GetCompletedValue() : 0;
+}
+
+bool D3D12FrameFence::Wait(int _slot, uint64_t _value)
+{
+	HANDLE fenceEvent = fenceEvents[_slot];
+	if (fence == nullptr || fenceEvent == nullptr
+		|| FAILED(fence->SetEventOnCompletion(_value, fenceEvent)))
+	{
+		return false;
+	}
+	WaitForSingleObjectEx(fenceEvent, INFINITE, FALSE);
+
+	return true;
+}
+
 class RenderAPI_D3D12 : public RenderAPI
 {
 public:
@@ -17,6 +89,12 @@ public:
 
 	virtual void ProcessDeviceEvent(UnityGfxDeviceEventType type, IUnityInterfaces* interfaces);
 	virtual void SetRenderMethod(bool _useIndirect, bool _useBundle);
+	virtual void SetCullingMethod(int _method);
+	virtual void SetOcclusionCulling(bool _enable);
+	virtual void SetContributionCulling(float _minTexels);
+	virtual void SetObjectDataLayout(int _layout);
+	virtual void SetRecordListCount(int _count);
+	virtual void SetFenceSpinTime(float _us);
 	virtual bool CheckDevice();
 
 	virtual bool CreateResources();
@@ -24,47 +102,74 @@ public:
 	virtual void WaitGPU(int _frameIndex);
 
 	virtual bool SetMeshData(void* _vertexBuffer, void* _indexBuffer, int _vertexCount, int _indexCount);
+	virtual bool SetMeshBounds(void* _vertexBuffer, float *_center, float *_extents, float _radius);
 	virtual void SetTextureData(void* _texture);
 	virtual bool SetShadowTextureData(void* _shadowTexture);
-	virtual void WorkerThread();
 	virtual void NotifyShadowThread(bool _multithread, float _fakeDelay);
 	virtual void InternalUpdate();
 	virtual bool RenderShadows();
 	virtual void SetObjectMatrix(int _index, XMMATRIX _matrix);
+	virtual void SetObjectTransforms(int _first, int _count, float *_pos, float *_scale, float *_rot);
+	virtual void SetObjectTransformsIndexed(int *_indices, int _count, float *_pos, float *_scale, float *_rot);
+	virtual void SetObjectTransformsSoA(int _first, int _count, float *_streams);
+	virtual void SetTransformArena(bool _enable);
+	virtual void *GetTransformArena();
+	virtual void *PublishTransformArena(unsigned long long _sequence);
 	virtual void SetObjTextureIndex(int _index, int _val);
+	virtual void SetObjectBounds(int _index, float *_center, float *_extents);
+	virtual void SetObjectOccluder(int _index, float *_center, float *_extents);
+	virtual int AddCaster(void* _vertexBuffer, void* _indexBuffer, int _vertexCount, int _indexCount, float *_pos, float *_scale, float *_rot, int _texIndex);
+	virtual void RemoveCaster(int _handle);
+	virtual void UpdateCaster(int _handle, float *_pos, float *_scale, float *_rot, int _texIndex);
 	virtual void SetLightTransform(float *_lightPos, float *_lightDir, float _radius);
 	virtual float *GetLightTransform();
+	virtual void SetCameraFrustum(float *_corners);
 	virtual double GetShadowTime();
+	virtual void GetCullingStats(int *_stats);
+	virtual int GetRecordTimes(double *_times);
+	virtual void GetFenceStats(double *_stats);
 
 private:
+	bool GetMeshViews(void* _vertexBuffer, void* _indexBuffer, int _vertexCount, D3D12_VERTEX_BUFFER_VIEW &_vbv, D3D12_INDEX_BUFFER_VIEW &_ibv);
 	void ToNextFrame();
 	void ExecuteAndTiming();
 	void ExecuteCmdList(ID3D12GraphicsCommandList *_cmdList);
 
 	IUnityGraphicsD3D12v2* s_D3D12;
 
-	// command for using in render thread
-	ComPtr<ID3D12CommandAllocator> renderCmdAllocator[NumOfFrameResources];
-	ComPtr<ID3D12GraphicsCommandList> renderCmdGraphicList[NumOfFrameResources];
+	// command for using in render thread, direct draws can be recorded into several lists at once
+	static const int MaxRecordLists = 8;
+	ComPtr<ID3D12CommandAllocator> renderCmdAllocator[MaxRecordLists][NumOfFrameResources];
+	ComPtr<ID3D12GraphicsCommandList> renderCmdGraphicList[MaxRecordLists][NumOfFrameResources];
 	ComPtr<ID3D12CommandQueue> renderQueue;
 
 	// fence
-	HANDLE fenceEvent;
 	ComPtr<ID3D12Fence> renderFence;
-	UINT64 renderFenceValue[NumOfFrameResources];
-	int frameIndex = 0;
+	D3D12FrameFence frameFence;
+	FramePacer framePacer;
 
 	// shadow instance
 	unique_ptr<ShadowMap> shadowMap;
 
-	// thread HANDLE
-	HANDLE beginShadowThread = nullptr;
+	// workers for culling and packing
+	JobSystem jobSystem;
+
+	// timings of the frame being rendered, copied for the getters once the frame is done
 	double shadowTime;
+	double recordTime[MaxRecordLists];
+	int recordedLists = 0;
+	mutex timingMutex;
+	double lastShadowTime = 0.0;
+	double lastRecordTime[MaxRecordLists] = {};
+	int lastRecordedLists = 0;
+
+	// drawing flags, set by the script on the main thread and read once per RenderShadows() by the shadow thread
+	atomic<bool> useIndirect;
+	atomic<bool> useBundle;
+	atomic<int> recordListCount;
 
-	// drawing flag
-	bool useIndirect;
-	bool useBundle;
-	float delayTime;
+	// shadow thread, last so it's joined before anything it uses goes away
+	ShadowWorker shadowWorker;
 };
 
 RenderAPI* CreateRenderAPI_D3D12()
@@ -75,7 +180,7 @@ RenderAPI* CreateRenderAPI_D3D12()
 const UINT kNodeMask = 0;
 
 RenderAPI_D3D12::RenderAPI_D3D12()
-	: s_D3D12(NULL)
+	: s_D3D12(NULL), useIndirect(false), useBundle(false), recordListCount(1)
 {
 
 }
@@ -84,111 +189,85 @@ bool RenderAPI_D3D12::CreateResources()
 {
 	// ------------------------------------------------------- Create Frame Resource
 	// ------------------------------------------------------- Any resource that would be updated per frame is recommended to use a circular list access.
-	for (int i = 0; i < NumOfFrameResources; i++)
+	// the device event and the script both create, the shadow thread has to let go of the old resources first
+	shadowWorker.Stop();
+
+	// frames still in flight use the old shadow map's buffers, the pacer keeps its fence values so they never go back
+	if (shadowMap != nullptr)
 	{
-		renderFenceValue[i] = 0;
+		for (int i = 0; i < NumOfFrameResources; i++)
+		{
+			WaitGPU(i);
+		}
 	}
-	frameIndex = 0;
 
 	shadowMap = make_unique<ShadowMap>(s_D3D12->GetDevice());
+	jobSystem.Init(0);
+	shadowMap->SetJobSystem(&jobSystem);
 	useIndirect = false;
 	useBundle = false;
+	recordListCount = 1;
+	recordedLists = 0;
+	lastRecordedLists = 0;
 
 	// ------------------------------------------------------- Create Thread
-	// a handle for waiting main thread signal
-	beginShadowThread = CreateEvent(NULL, FALSE, FALSE, NULL);
+	// sleeps until NotifyShadowThread() signals a frame, restarted here after every ReleaseResources()
+	shadowWorker.Start([this]() { ExecuteAndTiming(); });
 
 	return true;
 }
 
 void RenderAPI_D3D12::ReleaseResources()
 {
-	SafeClose(beginShadowThread);
+	// the shadow thread may be in the middle of a frame, it has to be joined before anything below goes away
+	shadowWorker.Stop();
 
 	for (int i = 0; i < NumOfFrameResources; i++)
 	{
 		WaitGPU(i);
-		SafeReset(renderCmdGraphicList[i]);
-		SafeReset(renderCmdAllocator[i]);
+		for (int j = 0; j < MaxRecordLists; j++)
+		{
+			SafeReset(renderCmdGraphicList[j][i]);
+			SafeReset(renderCmdAllocator[j][i]);
+		}
 	}
 
-	SafeClose(fenceEvent);
 	SafeReset(shadowMap);
+	jobSystem.Shutdown();
+	frameFence.Release();
 	SafeReset(renderFence);
 	SafeReset(renderQueue);
 
-	for (int i = 0; i < NumOfFrameResources; i++)
-	{
-		renderFenceValue[i] = 0;
-	}
-	frameIndex = 0;
+	framePacer.Init(&frameFence, NumOfFrameResources, 0);
 }
 
 void RenderAPI_D3D12::WaitGPU(int _frameIndex)
 {
-	if (renderQueue == nullptr ||
-		renderFence == nullptr)
-	{
-		return;
-	}
-
-	if (FAILED(renderQueue->Signal(renderFence.Get(), renderFenceValue[_frameIndex])))
-	{
-		return;
-	}
-
-	fenceEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-	if (FAILED(renderFence->SetEventOnCompletion(renderFenceValue[_frameIndex], fenceEvent)))
-	{
-		return;
-	}
-	WaitForSingleObjectEx(fenceEvent, INFINITE, FALSE);
-
-	renderFenceValue[_frameIndex]++;
+	framePacer.Flush(_frameIndex);
 }
 
 void RenderAPI_D3D12::ToNextFrame()
 {
-	// Schedule a Signal command in the queue.
-	const UINT64 currentFenceValue = renderFenceValue[frameIndex];
-	if (FAILED(renderQueue->Signal(renderFence.Get(), currentFenceValue)))
-	{
-		return;
-	}
-
-	// Cycle through the circular frame resource array.
-	frameIndex = (frameIndex + 1) % NumOfFrameResources;
-
-	// If the next frame is not ready to be rendered yet, wait until it is ready.
-	if (renderFence->GetCompletedValue() < renderFenceValue[frameIndex])
-	{
-		fenceEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-		if (FAILED(renderFence->SetEventOnCompletion(renderFenceValue[frameIndex], fenceEvent)))
-		{
-			return;
-		}
-		WaitForSingleObjectEx(fenceEvent, INFINITE, FALSE);
-	}
-
-	// Set the fence value for the next frame.
-	renderFenceValue[frameIndex] = currentFenceValue + 1;
+	framePacer.NextFrame();
 }
 
 void RenderAPI_D3D12::ExecuteAndTiming()
 {
 	// debug timer
-	LARGE_INTEGER frequency;        // ticks per second
-	LARGE_INTEGER t1, t2;           // ticks
-
-									// get ticks per second
-	QueryPerformanceFrequency(&frequency);
-
-	QueryPerformanceCounter(&t1);
+	auto t1 = chrono::high_resolution_clock::now();
 	InternalUpdate();
 	RenderShadows();
-	QueryPerformanceCounter(&t2);
+	auto t2 = chrono::high_resolution_clock::now();
+
+	shadowTime = chrono::duration<double, milli>(t2 - t1).count();
 
-	shadowTime = (t2.QuadPart - t1.QuadPart) * 1000.0 / frequency.QuadPart;
+	lock_guard<mutex> lock(timingMutex);
+	lastShadowTime = shadowTime;
+	lastRecordedLists = recordedLists;
+	for (int i = 0; i < recordedLists; i++)
+	{
+		lastRecordTime[i] = recordTime[i];
+	}
 }
 
 void RenderAPI_D3D12::ExecuteCmdList(ID3D12GraphicsCommandList * _cmdList)
@@ -213,8 +292,38 @@ void RenderAPI_D3D12::ProcessDeviceEvent(UnityGfxDeviceEventType type, IUnityInt
 
 void RenderAPI_D3D12::SetRenderMethod(bool _useIndirect, bool _useBundle)
 {
-	useIndirect = _useIndirect;
-	useBundle = _useBundle;
+	useIndirect.store(_useIndirect, memory_order_relaxed);
+	useBundle.store(_useBundle, memory_order_relaxed);
+}
+
+void RenderAPI_D3D12::SetCullingMethod(int _method)
+{
+	shadowMap->SetCullingMethod((CullingMethod)_method);
+}
+
+void RenderAPI_D3D12::SetOcclusionCulling(bool _enable)
+{
+	shadowMap->SetOcclusionCulling(_enable);
+}
+
+void RenderAPI_D3D12::SetContributionCulling(float _minTexels)
+{
+	shadowMap->SetContributionCulling(_minTexels);
+}
+
+void RenderAPI_D3D12::SetObjectDataLayout(int _layout)
+{
+	shadowMap->SetObjectDataLayout((ObjectDataLayout)_layout);
+}
+
+void RenderAPI_D3D12::SetRecordListCount(int _count)
+{
+	recordListCount.store(min(max(_count, 1), MaxRecordLists), memory_order_relaxed);
+}
+
+void RenderAPI_D3D12::SetFenceSpinTime(float _us)
+{
+	framePacer.SetSpinTime(_us);
 }
 
 bool RenderAPI_D3D12::CheckDevice()
@@ -226,40 +335,59 @@ bool RenderAPI_D3D12::CheckDevice()
 
 	for (int i = 0; i < NumOfFrameResources; i++)
 	{
-		if (FAILED(s_D3D12->GetDevice()->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&renderCmdAllocator[i]))))
+		for (int j = 0; j < MaxRecordLists; j++)
 		{
-			return false;
+			if (FAILED(s_D3D12->GetDevice()->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&renderCmdAllocator[j][i]))))
+			{
+				return false;
+			}
+
+			if (FAILED(s_D3D12->GetDevice()->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, renderCmdAllocator[j][i].Get(), nullptr, IID_PPV_ARGS(&renderCmdGraphicList[j][i]))))
+			{
+				return false;
+			}
+
+			if (FAILED(renderCmdGraphicList[j][i]->Close()))
+			{
+				return false;
+			}
 		}
+	}
 
-		if (FAILED(s_D3D12->GetDevice()->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, renderCmdAllocator[i].Get(), nullptr, IID_PPV_ARGS(&renderCmdGraphicList[i]))))
-		{
-			return false;
-		}
+	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+	if (FAILED(s_D3D12->GetDevice()->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&renderQueue))))
+	{
+		return false;
+	}
 
-		if (FAILED(renderCmdGraphicList[i]->Close()))
-		{
-			return false;
-		}
+	// fence starts at 0, every frame resource waits for 1 first
+	if (FAILED(s_D3D12->GetDevice()->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&renderFence))))
+	{
+		return false;
+	}
+	frameFence.Init(renderQueue.Get(), renderFence.Get());
+	framePacer.Init(&frameFence, NumOfFrameResources, 1);
 
-		D3D12_COMMAND_QUEUE_DESC queueDesc = {};
-		queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
-		queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
-		if (FAILED(s_D3D12->GetDevice()->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&renderQueue))))
-		{
-			return false;
-		}
+	return true;
+}
 
-		if (FAILED(s_D3D12->GetDevice()->CreateFence(renderFenceValue[i], D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&renderFence))))
-		{
-			return false;
-		}
-		renderFenceValue[i]++;
+bool RenderAPI_D3D12::SetMeshData(void * _vertexBuffer, void * _indexBuffer, int _vertexCount, int _indexCount)
+{
+	D3D12_VERTEX_BUFFER_VIEW vbv;
+	D3D12_INDEX_BUFFER_VIEW ibv;
+	if (!GetMeshViews(_vertexBuffer, _indexBuffer, _vertexCount, vbv, ibv))
+	{
+		return false;
 	}
 
+	shadowMap->AddMesh(vbv, ibv);
+
 	return true;
 }
 
-bool RenderAPI_D3D12::SetMeshData(void * _vertexBuffer, void * _indexBuffer, int _vertexCount, int _indexCount)
+bool RenderAPI_D3D12::GetMeshViews(void * _vertexBuffer, void * _indexBuffer, int _vertexCount, D3D12_VERTEX_BUFFER_VIEW &_vbv, D3D12_INDEX_BUFFER_VIEW &_ibv)
 {
 	D3D12_RESOURCE_DESC desc;
 
@@ -271,10 +399,9 @@ bool RenderAPI_D3D12::SetMeshData(void * _vertexBuffer, void * _indexBuffer, int
 	}
 	desc = VB->GetDesc();
 
-	D3D12_VERTEX_BUFFER_VIEW vbv;
-	vbv.BufferLocation = VB->GetGPUVirtualAddress();
-	vbv.SizeInBytes = (UINT)desc.Width;							// width equals to size byte if it is a buffer resource
-	vbv.StrideInBytes = (UINT)desc.Width / _vertexCount;
+	_vbv.BufferLocation = VB->GetGPUVirtualAddress();
+	_vbv.SizeInBytes = (UINT)desc.Width;							// width equals to size byte if it is a buffer resource
+	_vbv.StrideInBytes = (UINT)desc.Width / _vertexCount;
 
 	// copy index buffer
 	ID3D12Resource *IB = (ID3D12Resource*)_indexBuffer;
@@ -284,12 +411,23 @@ bool RenderAPI_D3D12::SetMeshData(void * _vertexBuffer, void * _indexBuffer, int
 	}
 	desc = IB->GetDesc();
 
-	D3D12_INDEX_BUFFER_VIEW ibv;
-	ibv.BufferLocation = IB->GetGPUVirtualAddress();
-	ibv.SizeInBytes = (UINT)desc.Width;							// width equals to size byte if it is a buffer resource
-	ibv.Format = DXGI_FORMAT_R32_UINT;
+	_ibv.BufferLocation = IB->GetGPUVirtualAddress();
+	_ibv.SizeInBytes = (UINT)desc.Width;							// width equals to size byte if it is a buffer resource
+	_ibv.Format = DXGI_FORMAT_R32_UINT;
 
-	shadowMap->AddMesh(vbv, ibv);
+	return true;
+}
+
+bool RenderAPI_D3D12::SetMeshBounds(void * _vertexBuffer, float * _center, float * _extents, float _radius)
+{
+	// meshes are told apart by their vertex buffer
+	ID3D12Resource *VB = (ID3D12Resource*)_vertexBuffer;
+	if (VB == nullptr)
+	{
+		return false;
+	}
+
+	shadowMap->SetMeshBounds(VB->GetGPUVirtualAddress(), XMFLOAT3(_center), XMFLOAT3(_extents), _radius);
 
 	return true;
 }
@@ -332,7 +470,7 @@ bool RenderAPI_D3D12::SetShadowTextureData(void * _shadowTexture)
 		return false;
 	}
 
-	if (!shadowMap->CreateIndirectBuffer(renderCmdGraphicList, renderCmdAllocator))
+	if (!shadowMap->CreateIndirectBuffer(renderCmdGraphicList[0], renderCmdAllocator[0]))
 	{
 		return false;
 	}
@@ -340,7 +478,7 @@ bool RenderAPI_D3D12::SetShadowTextureData(void * _shadowTexture)
 	// submit init job
 	for (int i = 0; i < NumOfFrameResources; i++)
 	{
-		ExecuteCmdList(renderCmdGraphicList[i].Get());
+		ExecuteCmdList(renderCmdGraphicList[0][i].Get());
 		WaitGPU(i);
 	}
 
@@ -352,55 +490,122 @@ bool RenderAPI_D3D12::SetShadowTextureData(void * _shadowTexture)
 	return true;
 }
 
-void RenderAPI_D3D12::WorkerThread()
+void RenderAPI_D3D12::NotifyShadowThread(bool _multithread,  float _fakeDelay)
 {
-	while (true)
+	// released and not created again yet
+	if (shadowMap == nullptr)
 	{
-		WaitForSingleObject(beginShadowThread, INFINITE);
-		Sleep(delayTime);
-		ExecuteAndTiming();
+		return;
 	}
-}
 
-void RenderAPI_D3D12::NotifyShadowThread(bool _multithread,  float _fakeDelay)
-{
-	delayTime = _fakeDelay;
+	// view, transforms and bounds set since the last frame go out as one snapshot, caster ops are applied by the shadow thread
+	shadowMap->PublishScene();
+
+	// switching modes hands the frame over, the two paths never run one at the same time
 	if (_multithread)
 	{
-		SetEvent(beginShadowThread);
+		shadowWorker.Start([this]() { ExecuteAndTiming(); });
+		shadowWorker.Notify(_fakeDelay);
 	}
 	else
 	{
+		shadowWorker.Stop();
 		ExecuteAndTiming();
 	}
 }
 
 void RenderAPI_D3D12::InternalUpdate()
 {
-	shadowMap->UpdateConstantBuffer(frameIndex);
+	shadowMap->ApplyCasterChanges();
+	shadowMap->ConsumeSceneSnapshot();
+	shadowMap->ConsumeTransformArena();
+	shadowMap->CullShadowObjects();
+	shadowMap->UpdateConstantBuffer(framePacer.GetFrameIndex());
 }
 
 bool RenderAPI_D3D12::RenderShadows()
 {
-	auto cmdAlloc = renderCmdAllocator[frameIndex];
-	auto cmdList = renderCmdGraphicList[frameIndex];
+	// the script may change these meanwhile, the whole frame records with one set
+	bool indirect = useIndirect.load(memory_order_relaxed);
+	bool bundle = useBundle.load(memory_order_relaxed);
+
+	// bundles and indirect draws are a handful of calls, only direct draws are worth splitting
+	int listCount = (indirect || bundle) ? 1 : recordListCount.load(memory_order_relaxed);
+	int visibleCount = shadowMap->GetVisibleObjectCount();
+	listCount = max(min(listCount, visibleCount), 1);
+	int rangeSize = (visibleCount + listCount - 1) / listCount;
+	int frameIndex = framePacer.GetFrameIndex();
+
+	// each list owns an allocator per frame, so they can be reset and recorded on any thread
+	atomic<bool> failed(false);
+	auto recordLists = [&](int _begin, int _end, int _chunk)
+	{
+		for (int i = _begin; i < _end; i++)
+		{
+			auto t1 = chrono::high_resolution_clock::now();
+
+			auto cmdAlloc = renderCmdAllocator[i][frameIndex].Get();
+			auto cmdList = renderCmdGraphicList[i][frameIndex].Get();
+
+			// reset command list
+			if (FAILED(cmdAlloc->Reset())
+				|| FAILED(cmdList->Reset(cmdAlloc, nullptr)))
+			{
+				failed = true;
+				continue;
+			}
+
+			if (listCount == 1)
+			{
+				shadowMap->RenderShadow(cmdList, frameIndex, indirect, bundle);
+			}
+			else
+			{
+				// first list clears, the last one transitions back, queue order keeps them around the rest
+				if (i == 0)
+				{
+					shadowMap->BeginShadow(cmdList);
+				}
+				shadowMap->SetShadowState(cmdList, frameIndex);
+				shadowMap->RenderVisibleRange(cmdList, frameIndex, i * rangeSize, (i + 1) * rangeSize);
+				if (i == listCount - 1)
+				{
+					shadowMap->EndShadow(cmdList);
+				}
+			}
+
+			if (FAILED(cmdList->Close()))
+			{
+				failed = true;
+			}
+
+			auto t2 = chrono::high_resolution_clock::now();
+			recordTime[i] = chrono::duration<double, milli>(t2 - t1).count();
+		}
+	};
 
-	// reset command list
-	if (FAILED(cmdAlloc->Reset())
-		|| FAILED(cmdList->Reset(cmdAlloc.Get(), nullptr)))
+	if (listCount == 1)
 	{
-		return false;
+		recordLists(0, 1, 0);
 	}
+	else
+	{
+		jobSystem.ParallelFor(listCount, 1, recordLists);
+	}
+	recordedLists = listCount;
 
-	shadowMap->RenderShadow(cmdList.Get(), frameIndex, useIndirect, useBundle);
-
-	if (HRESULT hr = FAILED(cmdList->Close()))
+	if (failed)
 	{
 		return false;
 	}
 
-	// Execute the rendering work.
-	ExecuteCmdList(cmdList.Get());
+	// Execute the rendering work, all lists in one submission.
+	ID3D12CommandList* ppCommandLists[MaxRecordLists];
+	for (int i = 0; i < listCount; i++)
+	{
+		ppCommandLists[i] = renderCmdGraphicList[i][frameIndex].Get();
+	}
+	renderQueue->ExecuteCommandLists(listCount, ppCommandLists);
 
 	ToNextFrame();
 
@@ -412,11 +617,96 @@ void RenderAPI_D3D12::SetObjectMatrix(int _index, XMMATRIX _matrix)
 	shadowMap->SetObjectTransform(_index, XMMatrixTranspose(_matrix));
 }
 
+void RenderAPI_D3D12::SetObjectTransforms(int _first, int _count, float *_pos, float *_scale, float *_rot)
+{
+	shadowMap->SetObjectTransforms(_first, _count, _pos, _scale, _rot);
+}
+
+void RenderAPI_D3D12::SetObjectTransformsIndexed(int *_indices, int _count, float *_pos, float *_scale, float *_rot)
+{
+	shadowMap->SetObjectTransforms(_indices, _count, _pos, _scale, _rot);
+}
+
+void RenderAPI_D3D12::SetObjectTransformsSoA(int _first, int _count, float *_streams)
+{
+	// ten columns of _count floats each
+	TransformStreams streams;
+	streams.posX = _streams;
+	streams.posY = _streams + _count;
+	streams.posZ = _streams + _count * 2;
+	streams.rotX = _streams + _count * 3;
+	streams.rotY = _streams + _count * 4;
+	streams.rotZ = _streams + _count * 5;
+	streams.rotW = _streams + _count * 6;
+	streams.scaleX = _streams + _count * 7;
+	streams.scaleY = _streams + _count * 8;
+	streams.scaleZ = _streams + _count * 9;
+
+	shadowMap->SetObjectTransforms(_first, _count, streams);
+}
+
+void RenderAPI_D3D12::SetTransformArena(bool _enable)
+{
+	shadowMap->SetTransformArena(_enable);
+}
+
+void *RenderAPI_D3D12::GetTransformArena()
+{
+	return shadowMap->GetTransformArena();
+}
+
+void *RenderAPI_D3D12::PublishTransformArena(unsigned long long _sequence)
+{
+	return shadowMap->PublishTransformArena(_sequence);
+}
+
 void RenderAPI_D3D12::SetObjTextureIndex(int _index, int _val)
 {
 	shadowMap->SetObjTextureIndex(_index, _val);
 }
 
+void RenderAPI_D3D12::SetObjectBounds(int _index, float *_center, float *_extents)
+{
+	shadowMap->SetObjectBounds(_index, XMFLOAT3(_center), XMFLOAT3(_extents));
+}
+
+void RenderAPI_D3D12::SetObjectOccluder(int _index, float *_center, float *_extents)
+{
+	shadowMap->SetObjectOccluder(_index, XMFLOAT3(_center), XMFLOAT3(_extents));
+}
+
+int RenderAPI_D3D12::AddCaster(void * _vertexBuffer, void * _indexBuffer, int _vertexCount, int _indexCount, float *_pos, float *_scale, float *_rot, int _texIndex)
+{
+	D3D12_VERTEX_BUFFER_VIEW vbv;
+	D3D12_INDEX_BUFFER_VIEW ibv;
+	if (!GetMeshViews(_vertexBuffer, _indexBuffer, _vertexCount, vbv, ibv))
+	{
+		return -1;
+	}
+
+	TransformRecord transform;
+	transform.position = XMFLOAT3(_pos);
+	transform.scale = XMFLOAT3(_scale);
+	transform.rotation = XMFLOAT4(_rot);
+
+	return shadowMap->AddCaster(vbv, ibv, transform, _texIndex);
+}
+
+void RenderAPI_D3D12::RemoveCaster(int _handle)
+{
+	shadowMap->RemoveCaster(_handle);
+}
+
+void RenderAPI_D3D12::UpdateCaster(int _handle, float *_pos, float *_scale, float *_rot, int _texIndex)
+{
+	TransformRecord transform;
+	transform.position = XMFLOAT3(_pos);
+	transform.scale = XMFLOAT3(_scale);
+	transform.rotation = XMFLOAT4(_rot);
+
+	shadowMap->UpdateCaster(_handle, transform, _texIndex);
+}
+
 void RenderAPI_D3D12::SetLightTransform(float *_lightPos, float *_lightDir, float _radius)
 {
 	// calculate light transform
@@ -443,6 +733,12 @@ void RenderAPI_D3D12::SetLightTransform(float *_lightPos, float *_lightDir, floa
 	shadowMap->SetShadowTransform(viewProj);
 }
 
+void RenderAPI_D3D12::SetCameraFrustum(float *_corners)
+{
+	// 8 world space corners packed as xyz, null turns receiver culling off
+	shadowMap->SetCameraFrustum((XMFLOAT3*)_corners);
+}
+
 float * RenderAPI_D3D12::GetLightTransform()
 {
 	float *m = new float[16];
@@ -474,7 +770,44 @@ float * RenderAPI_D3D12::GetLightTransform()
 
 double RenderAPI_D3D12::GetShadowTime()
 {
-	return shadowTime;
+	lock_guard<mutex> lock(timingMutex);
+	return lastShadowTime;
+}
+
+void RenderAPI_D3D12::GetCullingStats(int *_stats)
+{
+	CullingStats stats = shadowMap->GetCullingStats();
+
+	_stats[0] = stats.totalObjects;
+	_stats[1] = stats.frustumVisible;
+	_stats[2] = stats.smallCulled;
+	_stats[3] = stats.occluded;
+	_stats[4] = stats.drawn;
+	_stats[5] = stats.tested;
+	_stats[6] = stats.receiverCulled;
+	_stats[7] = stats.uploaded;
+	_stats[8] = stats.objectDataKB;
+}
+
+void RenderAPI_D3D12::GetFenceStats(double *_stats)
+{
+	FenceStats stats = framePacer.GetStats(true);
+
+	_stats[0] = (double)stats.frames;
+	_stats[1] = (double)stats.stalls;
+	_stats[2] = (double)stats.spinResolved;
+	_stats[3] = stats.stallMs;
+	_stats[4] = stats.maxStallMs;
+}
+
+int RenderAPI_D3D12::GetRecordTimes(double *_times)
+{
+	lock_guard<mutex> lock(timingMutex);
+	for (int i = 0; i < lastRecordedLists; i++)
+	{
+		_times[i] = lastRecordTime[i];
+	}
+	return lastRecordedLists;
 }
 
 #endif // #if SUPPORT_D3D12
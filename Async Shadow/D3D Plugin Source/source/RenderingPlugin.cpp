@@ -4,16 +4,7 @@
 #include "RenderAPI.h"
 #include "stdafx.h"
 
-static RenderAPI* s_CurrentAPI = NULL;
-static HANDLE shadowThread = nullptr;
-struct threadwrapper
-{
-	static unsigned int WINAPI thunk(LPVOID lpParameter)
-	{
-		s_CurrentAPI->WorkerThread();
-		return 0;
-	}
-};
+static RenderAPI* s_CurrentAPI = NULL;
 
 // check d3d device
 extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API CheckDevice()
@@ -21,27 +12,16 @@ extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API CheckDevice()
 	return s_CurrentAPI->CheckDevice();
 }
 
-// create resource
-extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API CreateResources()
-{
-	bool result = s_CurrentAPI->CreateResources();
-	shadowThread = reinterpret_cast<HANDLE>(_beginthreadex(
-		nullptr,
-		0,
-		threadwrapper::thunk,
-		nullptr,
-		0,
-		nullptr));
-
-	return result;
-}
-
-// release resource
-extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ReleaseResources()
-{
-	SafeClose(shadowThread);
-
-	s_CurrentAPI->ReleaseResources();
+// create resource, the shadow thread starts with it
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API CreateResources()
+{
+	return s_CurrentAPI->CreateResources();
+}
+
+// release resource, the shadow thread is joined first
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ReleaseResources()
+{
+	s_CurrentAPI->ReleaseResources();
 }
 
 // get mesh data from unity
@@ -50,6 +30,12 @@ extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SendMeshData(void* _v
 	return s_CurrentAPI->SetMeshData(_vertexBuffer, _indexBuffer, _vertexCount, _indexCount);
 }
 
+// get local space mesh bounds from Unity, world bounds are derived in SetObjectTransform()
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SendMeshBounds(void* _vertexBuffer, float *_center, float *_extents, float _radius)
+{
+	return s_CurrentAPI->SetMeshBounds(_vertexBuffer, _center, _extents, _radius);
+}
+
 // get render texture data from Unity
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SendTextureData(void* _texture)
 {
@@ -71,11 +57,44 @@ extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API RenderShadows(bool _m
 // set matrix
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetObjectTransform(int _index, float *_pos, float *_scale, float *_rot)
 {
-	XMMATRIX m = XMMatrixScaling(_scale[0], _scale[1], _scale[2])
-		* XMMatrixRotationQuaternion(XMVectorSet(_rot[0], _rot[1], _rot[2], _rot[3]))
-		* XMMatrixTranslation(_pos[0], _pos[1], _pos[2]);
+	// composed directly in the transposed layout, no separate transpose pass
+	s_CurrentAPI->SetObjectTransforms(_index, 1, _pos, _scale, _rot);
+}
 
-	s_CurrentAPI->SetObjectMatrix(_index, m);
+// set matrices of objects [_first, _first + _count), arrays are packed float3 pos, float3 scale, float4 rot
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetObjectTransforms(int _first, int _count, float *_pos, float *_scale, float *_rot)
+{
+	s_CurrentAPI->SetObjectTransforms(_first, _count, _pos, _scale, _rot);
+}
+
+// same as above for a sparse list, entry i of the arrays belongs to object _indices[i]
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetObjectTransformsIndexed(int *_indices, int _count, float *_pos, float *_scale, float *_rot)
+{
+	s_CurrentAPI->SetObjectTransformsIndexed(_indices, _count, _pos, _scale, _rot);
+}
+
+// same for structure of arrays input, _streams holds pos xyz, rot xyzw and scale xyz as ten columns of _count floats
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetObjectTransformsSoA(int _first, int _count, float *_streams)
+{
+	s_CurrentAPI->SetObjectTransformsSoA(_first, _count, _streams);
+}
+
+// enable the shared transform arena, must be called before SendShadowTextureData
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetTransformArena(bool _enable)
+{
+	s_CurrentAPI->SetTransformArena(_enable);
+}
+
+// current arena write buffer, starts with a TransformArenaHeader describing where bits and records are
+extern "C" void UNITY_INTERFACE_EXPORT * UNITY_INTERFACE_API GetTransformArena()
+{
+	return s_CurrentAPI->GetTransformArena();
+}
+
+// hand the written buffer to the shadow thread, returns the buffer to write next
+extern "C" void UNITY_INTERFACE_EXPORT * UNITY_INTERFACE_API PublishTransformArena(unsigned long long _sequence)
+{
+	return s_CurrentAPI->PublishTransformArena(_sequence);
 }
 
 // set texture index
@@ -84,6 +103,36 @@ extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetObjTextureIndex(in
 	s_CurrentAPI->SetObjTextureIndex(_index, _val);
 }
 
+// set world space bounds of an object, used for culling until its transform and mesh bounds replace them
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetObjectBounds(int _index, float *_center, float *_extents)
+{
+	s_CurrentAPI->SetObjectBounds(_index, _center, _extents);
+}
+
+// register an occluder box for the object, zero extents remove it
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetObjectOccluder(int _index, float *_center, float *_extents)
+{
+	s_CurrentAPI->SetObjectOccluder(_index, _center, _extents);
+}
+
+// add a caster after SendShadowTextureData, returns its handle or -1. pos xyz, scale xyz, rot xyzw
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API AddCaster(void* _vertexBuffer, void* _indexBuffer, int _vertexCount, int _indexCount, float *_pos, float *_scale, float *_rot, int _texIndex)
+{
+	return s_CurrentAPI->AddCaster(_vertexBuffer, _indexBuffer, _vertexCount, _indexCount, _pos, _scale, _rot, _texIndex);
+}
+
+// casters sent with SendMeshData can be removed too, their handle is their index
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API RemoveCaster(int _handle)
+{
+	s_CurrentAPI->RemoveCaster(_handle);
+}
+
+// move a caster or change its texture, pos xyz, scale xyz, rot xyzw
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UpdateCaster(int _handle, float *_pos, float *_scale, float *_rot, int _texIndex)
+{
+	s_CurrentAPI->UpdateCaster(_handle, _pos, _scale, _rot, _texIndex);
+}
+
 // set light transform
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetLightTransform(float *_lightPos, float *_lightDir, float _radius)
 {
@@ -100,18 +149,78 @@ extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetLightTransform(flo
 	}
 }
 
+// set main camera frustum corners for receiver culling
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetCameraFrustum(float *_corners)
+{
+	s_CurrentAPI->SetCameraFrustum(_corners);
+}
+
 // get shadow render time
 extern "C" double UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetShadowRenderTime()
 {
 	return s_CurrentAPI->GetShadowTime();
 }
 
+// culling counters of the last frame, _stats holds 9 ints in CullingStats order
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetCullingStats(int *_stats)
+{
+	s_CurrentAPI->GetCullingStats(_stats);
+}
+
+// per list recording time of the last frame in ms, _times holds up to 8, returns the list count
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetRecordTimes(double *_times)
+{
+	return s_CurrentAPI->GetRecordTimes(_times);
+}
+
+// fence waits since the previous call: frames, stalls, stalls covered by the spin, total ms, longest ms
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetFenceStats(double *_stats)
+{
+	s_CurrentAPI->GetFenceStats(_stats);
+}
+
 // set indirect drawing
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetRenderMethod(bool _useIndirect, bool _useBundle)
 {
 	s_CurrentAPI->SetRenderMethod(_useIndirect, _useBundle);
 }
 
+// set culling method, 0 linear, 1 bvh, 2 temporal, 3 grid
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetCullingMethod(int _method)
+{
+	s_CurrentAPI->SetCullingMethod(_method);
+}
+
+// set occlusion culling against the registered occluders
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetOcclusionCulling(bool _enable)
+{
+	s_CurrentAPI->SetOcclusionCulling(_enable);
+}
+
+// set the minimum shadow texels a caster has to cover, 0 disables it
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetContributionCulling(float _minTexels)
+{
+	s_CurrentAPI->SetContributionCulling(_minTexels);
+}
+
+// choose per-object data layout, must be called before SendShadowTextureData
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetObjectDataLayout(int _layout)
+{
+	s_CurrentAPI->SetObjectDataLayout(_layout);
+}
+
+// number of command lists direct draws are recorded into in parallel, 1 to 8
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetRecordListCount(int _count)
+{
+	s_CurrentAPI->SetRecordListCount(_count);
+}
+
+// microseconds a fence wait polls before it blocks, 0 blocks right away
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetFenceSpinTime(float _us)
+{
+	s_CurrentAPI->SetFenceSpinTime(_us);
+}
+
 // --------------------------------------------------------------------------
 // UnitySetInterfaces
 
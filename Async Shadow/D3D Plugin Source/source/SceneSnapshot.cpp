@@ -0,0 +1,196 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "SceneSnapshot.h"
+#include <string.h>
+
+static const XMFLOAT4X4 IdentityMatrix(
+	1.0f, 0.0f, 0.0f, 0.0f,
+	0.0f, 1.0f, 0.0f, 0.0f,
+	0.0f, 0.0f, 1.0f, 0.0f,
+	0.0f, 0.0f, 0.0f, 1.0f);
+
+SceneSnapshotBuffer::SceneSnapshotBuffer()
+{
+	Reset();
+}
+
+void SceneSnapshotBuffer::Reset()
+{
+	for (int i = 0; i < NumBuffers; i++)
+	{
+		buffers[i].sequence = 0;
+		buffers[i].shadowTransform = IdentityMatrix;
+		memset(buffers[i].cameraCorners, 0, sizeof(buffers[i].cameraCorners));
+		buffers[i].useReceiverCulling = false;
+		buffers[i].transformIndex.clear();
+		buffers[i].transformWorld.clear();
+		buffers[i].bounds.clear();
+	}
+
+	// writer starts on 0, reader holds 1, 2 is the shared slot with nothing new in it
+	writeIndex = 0;
+	readIndex = 1;
+	latest = 2;
+	sequence = 0;
+	writeSequence.clear();
+}
+
+SceneSnapshot &SceneSnapshotBuffer::GetWriteBuffer()
+{
+	return buffers[writeIndex];
+}
+
+XMFLOAT4X4 *SceneSnapshotBuffer::AddTransforms(int _first, int _count)
+{
+	SceneSnapshot &snapshot = buffers[writeIndex];
+	size_t base = snapshot.transformIndex.size();
+	snapshot.transformIndex.resize(base + _count);
+	snapshot.transformWorld.resize(base + _count);
+	for (int i = 0; i < _count; i++)
+	{
+		snapshot.transformIndex[base + i] = _first + i;
+	}
+
+	StampTransforms(base);
+	return &snapshot.transformWorld[base];
+}
+
+XMFLOAT4X4 *SceneSnapshotBuffer::AddTransforms(const int *_indices, int _count)
+{
+	SceneSnapshot &snapshot = buffers[writeIndex];
+	size_t base = snapshot.transformIndex.size();
+	snapshot.transformIndex.insert(snapshot.transformIndex.end(), _indices, _indices + _count);
+	snapshot.transformWorld.resize(base + _count);
+
+	StampTransforms(base);
+	return &snapshot.transformWorld[base];
+}
+
+void SceneSnapshotBuffer::AddBounds(int _index, const XMFLOAT3 &_center, const XMFLOAT3 &_extents)
+{
+	SceneBounds bounds;
+	bounds.index = _index;
+	bounds.center = _center;
+	bounds.extents = _extents;
+	buffers[writeIndex].bounds.push_back(bounds);
+}
+
+void SceneSnapshotBuffer::StampTransforms(size_t _first)
+{
+	// the write snapshot goes out with the next sequence
+	const vector<int> &indices = buffers[writeIndex].transformIndex;
+	for (size_t i = _first; i < indices.size(); i++)
+	{
+		int idx = indices[i];
+		if (idx < 0)
+		{
+			continue;
+		}
+
+		if (idx >= (int)writeSequence.size())
+		{
+			writeSequence.resize(idx + 1, 0);
+		}
+		writeSequence[idx] = sequence + 1;
+	}
+}
+
+uint64_t SceneSnapshotBuffer::Publish()
+{
+	SceneSnapshot &published = buffers[writeIndex];
+	published.sequence = ++sequence;
+
+	// the last snapshot still waiting in the shared slot will be skipped by the reader.
+	// its transforms go out again in front of this one's, except the objects rewritten since.
+	// the reader may take it meanwhile, then it just applies the same values twice.
+	uint32_t waiting = latest.load(memory_order_acquire);
+	if (waiting & FreshBit)
+	{
+		const SceneSnapshot &skipped = buffers[waiting & ~FreshBit];
+		carryIndex.clear();
+		carryWorld.clear();
+		for (int i = 0; i < (int)skipped.transformIndex.size(); i++)
+		{
+			int idx = skipped.transformIndex[i];
+			if (idx < 0 || writeSequence[idx] == sequence)
+			{
+				continue;
+			}
+
+			carryIndex.push_back(idx);
+			carryWorld.push_back(skipped.transformWorld[i]);
+		}
+
+		carryIndex.insert(carryIndex.end(), published.transformIndex.begin(), published.transformIndex.end());
+		carryWorld.insert(carryWorld.end(), published.transformWorld.begin(), published.transformWorld.end());
+		published.transformIndex.swap(carryIndex);
+		published.transformWorld.swap(carryWorld);
+
+		// bounds are rare, all of them go out again and the newer ones are applied last
+		if (!skipped.bounds.empty())
+		{
+			carryBounds.assign(skipped.bounds.begin(), skipped.bounds.end());
+			carryBounds.insert(carryBounds.end(), published.bounds.begin(), published.bounds.end());
+			published.bounds.swap(carryBounds);
+		}
+	}
+
+	uint32_t prev = latest.exchange(writeIndex | FreshBit, memory_order_acq_rel);
+	writeIndex = prev & ~FreshBit;
+
+	// whatever comes back was read or carried over already.
+	// nobody writes the published snapshot until it comes back here, reading it is safe.
+	SceneSnapshot &next = buffers[writeIndex];
+	next.transformIndex.clear();
+	next.transformWorld.clear();
+	next.bounds.clear();
+
+	// setters only touch what changed, the rest of the view carries over
+	next.shadowTransform = published.shadowTransform;
+	memcpy(next.cameraCorners, published.cameraCorners, sizeof(next.cameraCorners));
+	next.useReceiverCulling = published.useReceiverCulling;
+
+	return sequence;
+}
+
+const SceneSnapshot *SceneSnapshotBuffer::Acquire()
+{
+	if ((latest.load(memory_order_acquire) & FreshBit) == 0)
+	{
+		return nullptr;
+	}
+
+	// hand back the snapshot consumed last time
+	uint32_t prev = latest.exchange(readIndex, memory_order_acq_rel);
+	readIndex = prev & ~FreshBit;
+
+	return &buffers[readIndex];
+}
+
+const SceneSnapshot &SceneSnapshotBuffer::GetReadBuffer()
+{
+	return buffers[readIndex];
+}
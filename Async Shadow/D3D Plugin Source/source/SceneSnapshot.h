@@ -0,0 +1,103 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include <DirectXMath.h>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+using namespace std;
+using namespace DirectX;
+
+// world space bounds the engine set for one object
+struct SceneBounds
+{
+	int index;
+	XMFLOAT3 center;
+	XMFLOAT3 extents;
+};
+
+// view state, transforms and bounds the engine set for one frame.
+// texture indices, occluders and caster add/remove don't go through here, ShadowMap queues them as caster ops.
+struct SceneSnapshot
+{
+	uint64_t sequence;
+
+	// view state, carried over from the previous snapshot until it's set again
+	XMFLOAT4X4 shadowTransform;
+	XMFLOAT3 cameraCorners[8];
+	bool useReceiverCulling;
+
+	// transposed world matrices set since the previous snapshot, applied in order
+	vector<int> transformIndex;
+	vector<XMFLOAT4X4> transformWorld;
+
+	// bounds set since the previous snapshot, applied in order before the transforms
+	vector<SceneBounds> bounds;
+};
+
+// scene snapshots between one producer (the engine thread) and one consumer (the shadow thread).
+// the producer fills the write snapshot and publishes it with one atomic index swap, the consumer takes the newest one.
+// same three buffer protocol as TransformArena, neither side waits or touches a snapshot the other one holds.
+class SceneSnapshotBuffer
+{
+public:
+	static const int NumBuffers = 3;
+
+	SceneSnapshotBuffer();
+	SceneSnapshotBuffer(const SceneSnapshotBuffer& rhs) = delete;
+	SceneSnapshotBuffer& operator=(const SceneSnapshotBuffer& rhs) = delete;
+
+	// both sides must be idle
+	void Reset();
+
+	// producer side. the returned matrices are appended to the write snapshot and filled by the caller.
+	SceneSnapshot &GetWriteBuffer();
+	XMFLOAT4X4 *AddTransforms(int _first, int _count);
+	XMFLOAT4X4 *AddTransforms(const int *_indices, int _count);
+	void AddBounds(int _index, const XMFLOAT3 &_center, const XMFLOAT3 &_extents);
+	uint64_t Publish();
+
+	// consumer side, null when nothing new was published since the last call.
+	// the view state of the last acquired snapshot stays readable through GetReadBuffer()
+	const SceneSnapshot *Acquire();
+	const SceneSnapshot &GetReadBuffer();
+
+private:
+	static const uint32_t FreshBit = 0x4;	// set on the shared index until the reader takes that snapshot
+
+	void StampTransforms(size_t _first);
+
+	SceneSnapshot buffers[NumBuffers];
+
+	atomic<uint32_t> latest;
+	int writeIndex = 0;
+	int readIndex = 0;
+	uint64_t sequence = 0;
+
+	// sequence of the snapshot each object was last written into, producer only
+	vector<uint64_t> writeSequence;
+	vector<int> carryIndex;
+	vector<XMFLOAT4X4> carryWorld;
+	vector<SceneBounds> carryBounds;
+};
@@ -0,0 +1,461 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#include "ShadowBVH.h"
+#include <algorithm>
+
+static const int MaxLeafSize = 4;
+static const int NumBins = 16;
+
+static float HalfArea(const float *_min, const float *_max)
+{
+	float dx = _max[0] - _min[0];
+	float dy = _max[1] - _min[1];
+	float dz = _max[2] - _min[2];
+	return dx * dy + dy * dz + dz * dx;
+}
+
+ShadowBVH::ShadowBVH()
+{
+
+}
+
+ShadowBVH::~ShadowBVH()
+{
+	Clear();
+}
+
+void ShadowBVH::Build(const ShadowBoundsStore &_bounds)
+{
+	int count = _bounds.Size();
+
+	nodes.clear();
+	objectIndices.resize(count);
+	objectLeaf.assign(count, 0);
+	centroids.resize(count);
+	dirtyObjects.clear();
+	dirtyFlag.assign(count, false);
+	built = true;
+
+	for (int i = 0; i < count; i++)
+	{
+		objectIndices[i] = i;
+		centroids[i] = XMFLOAT3(_bounds.centerX[i], _bounds.centerY[i], _bounds.centerZ[i]);
+	}
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	// a binary tree with leaves of at least one object never exceeds 2N - 1 nodes
+	nodes.reserve(2 * count);
+
+	BVHNode root;
+	root.left = -1;
+	root.parent = -1;
+	root.first = 0;
+	root.count = count;
+	nodes.push_back(root);
+
+	UpdateNodeBounds(0, _bounds);
+	Subdivide(0, _bounds);
+}
+
+void ShadowBVH::Clear()
+{
+	nodes.clear();
+	objectIndices.clear();
+	objectLeaf.clear();
+	centroids.clear();
+	dirtyObjects.clear();
+	dirtyFlag.clear();
+	traverseStack.clear();
+	built = false;
+}
+
+bool ShadowBVH::IsBuilt()
+{
+	return built;
+}
+
+void ShadowBVH::MarkDirty(int _index)
+{
+	if (!built || _index < 0 || _index >= (int)dirtyFlag.size())
+	{
+		return;
+	}
+
+	if (!dirtyFlag[_index])
+	{
+		dirtyFlag[_index] = true;
+		dirtyObjects.push_back(_index);
+	}
+}
+
+void ShadowBVH::Refit(const ShadowBoundsStore &_bounds)
+{
+	if (!built || dirtyObjects.empty())
+	{
+		return;
+	}
+
+	if ((int)dirtyObjects.size() * 8 > (int)objectIndices.size())
+	{
+		// many movers, one pass from the back refits children before their parents
+		for (int i = (int)nodes.size() - 1; i >= 0; i--)
+		{
+			UpdateNodeBounds(i, _bounds);
+		}
+	}
+	else
+	{
+		// few movers, only walk their leaf-to-root paths
+		for (int i = 0; i < (int)dirtyObjects.size(); i++)
+		{
+			int node = objectLeaf[dirtyObjects[i]];
+			while (node != -1)
+			{
+				UpdateNodeBounds(node, _bounds);
+				node = nodes[node].parent;
+			}
+		}
+	}
+
+	for (int i = 0; i < (int)dirtyObjects.size(); i++)
+	{
+		dirtyFlag[dirtyObjects[i]] = false;
+	}
+	dirtyObjects.clear();
+}
+
+void ShadowBVH::Update(const ShadowBoundsStore &_bounds)
+{
+	// refitting a tree whose objects nearly all moved is worse than building a new one
+	if (!built || (int)objectIndices.size() != _bounds.Size() || (int)dirtyObjects.size() * 2 > _bounds.Size())
+	{
+		Build(_bounds);
+	}
+	else
+	{
+		Refit(_bounds);
+	}
+}
+
+int ShadowBVH::Cull(const ShadowFrustum &_frustum, const ShadowBoundsStore &_bounds, vector<int> &_visible)
+{
+	_visible.clear();
+	if (nodes.empty())
+	{
+		return 0;
+	}
+
+	// stack holds node index and the mask of planes that still need testing
+	traverseStack.clear();
+	traverseStack.push_back(0);
+	traverseStack.push_back(0x3F);
+
+	while (!traverseStack.empty())
+	{
+		int mask = traverseStack.back();
+		traverseStack.pop_back();
+		int n = traverseStack.back();
+		traverseStack.pop_back();
+
+		const BVHNode &node = nodes[n];
+
+		// half sums avoid overflow on never culled bounds
+		float cx = node.boundsMax.x * 0.5f + node.boundsMin.x * 0.5f;
+		float cy = node.boundsMax.y * 0.5f + node.boundsMin.y * 0.5f;
+		float cz = node.boundsMax.z * 0.5f + node.boundsMin.z * 0.5f;
+		float ex = node.boundsMax.x * 0.5f - node.boundsMin.x * 0.5f;
+		float ey = node.boundsMax.y * 0.5f - node.boundsMin.y * 0.5f;
+		float ez = node.boundsMax.z * 0.5f - node.boundsMin.z * 0.5f;
+
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+		{
+			if ((mask & (1 << p)) == 0)
+			{
+				continue;
+			}
+
+			const XMFLOAT4 &plane = _frustum.planes[p];
+			float dist = cx * plane.x + cy * plane.y + cz * plane.z + plane.w;
+			float radius = ex * fabsf(plane.x) + ey * fabsf(plane.y) + ez * fabsf(plane.z);
+
+			outside = dist > radius;
+			if (dist < -radius)
+			{
+				// fully inside this plane, children don't need to test it again
+				mask &= ~(1 << p);
+			}
+		}
+
+		if (outside)
+		{
+			continue;
+		}
+
+		if (mask == 0)
+		{
+			// whole subtree accepted
+			AppendSubtree(n, _visible);
+		}
+		else if (node.left == -1)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				int obj = objectIndices[i];
+				bool objOutside = false;
+				for (int p = 0; p < 6 && !objOutside; p++)
+				{
+					if ((mask & (1 << p)) == 0)
+					{
+						continue;
+					}
+
+					const XMFLOAT4 &plane = _frustum.planes[p];
+					float dist = _bounds.centerX[obj] * plane.x + _bounds.centerY[obj] * plane.y + _bounds.centerZ[obj] * plane.z + plane.w;
+					float radius = _bounds.extentX[obj] * fabsf(plane.x) + _bounds.extentY[obj] * fabsf(plane.y) + _bounds.extentZ[obj] * fabsf(plane.z);
+					objOutside = dist > radius;
+				}
+
+				if (!objOutside)
+				{
+					_visible.push_back(obj);
+				}
+			}
+		}
+		else
+		{
+			traverseStack.push_back(node.left);
+			traverseStack.push_back(mask);
+			traverseStack.push_back(node.left + 1);
+			traverseStack.push_back(mask);
+		}
+	}
+
+	return (int)_visible.size();
+}
+
+void ShadowBVH::Subdivide(int _root, const ShadowBoundsStore &_bounds)
+{
+	struct Bin
+	{
+		float boundsMin[3];
+		float boundsMax[3];
+		int count;
+	};
+
+	vector<int> work;
+	work.push_back(_root);
+
+	while (!work.empty())
+	{
+		int n = work.back();
+		work.pop_back();
+
+		int first = nodes[n].first;
+		int count = nodes[n].count;
+
+		if (count <= MaxLeafSize)
+		{
+			for (int i = first; i < first + count; i++)
+			{
+				objectLeaf[objectIndices[i]] = n;
+			}
+			continue;
+		}
+
+		// ------------------------------------------------ split along the longest axis of centroid bounds
+		float cMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float cMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (int i = first; i < first + count; i++)
+		{
+			const XMFLOAT3 &c = centroids[objectIndices[i]];
+			cMin[0] = min(cMin[0], c.x); cMax[0] = max(cMax[0], c.x);
+			cMin[1] = min(cMin[1], c.y); cMax[1] = max(cMax[1], c.y);
+			cMin[2] = min(cMin[2], c.z); cMax[2] = max(cMax[2], c.z);
+		}
+
+		int axis = 0;
+		if (cMax[1] - cMin[1] > cMax[axis] - cMin[axis]) axis = 1;
+		if (cMax[2] - cMin[2] > cMax[axis] - cMin[axis]) axis = 2;
+		float extent = cMax[axis] - cMin[axis];
+
+		int leftCount = 0;
+		if (extent > 0.0f)
+		{
+			// ------------------------------------------------ binned sah
+			Bin bins[NumBins];
+			for (int b = 0; b < NumBins; b++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					bins[b].boundsMin[k] = FLT_MAX;
+					bins[b].boundsMax[k] = -FLT_MAX;
+				}
+				bins[b].count = 0;
+			}
+
+			float scale = NumBins / extent;
+			for (int i = first; i < first + count; i++)
+			{
+				int obj = objectIndices[i];
+				const float *c = &centroids[obj].x;
+				int b = min(NumBins - 1, (int)((c[axis] - cMin[axis]) * scale));
+
+				float oMin[3] = { _bounds.centerX[obj] - _bounds.extentX[obj], _bounds.centerY[obj] - _bounds.extentY[obj], _bounds.centerZ[obj] - _bounds.extentZ[obj] };
+				float oMax[3] = { _bounds.centerX[obj] + _bounds.extentX[obj], _bounds.centerY[obj] + _bounds.extentY[obj], _bounds.centerZ[obj] + _bounds.extentZ[obj] };
+				for (int k = 0; k < 3; k++)
+				{
+					bins[b].boundsMin[k] = min(bins[b].boundsMin[k], oMin[k]);
+					bins[b].boundsMax[k] = max(bins[b].boundsMax[k], oMax[k]);
+				}
+				bins[b].count++;
+			}
+
+			// sweep from both sides, split s puts bins [0, s) to the left
+			float leftCost[NumBins];
+			float rightCost[NumBins];
+			float accMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float accMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			int accCount = 0;
+			for (int b = 0; b < NumBins - 1; b++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					accMin[k] = min(accMin[k], bins[b].boundsMin[k]);
+					accMax[k] = max(accMax[k], bins[b].boundsMax[k]);
+				}
+				accCount += bins[b].count;
+				leftCost[b + 1] = (accCount > 0) ? accCount * HalfArea(accMin, accMax) : 0.0f;
+			}
+
+			for (int k = 0; k < 3; k++)
+			{
+				accMin[k] = FLT_MAX;
+				accMax[k] = -FLT_MAX;
+			}
+			accCount = 0;
+			for (int b = NumBins - 1; b > 0; b--)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					accMin[k] = min(accMin[k], bins[b].boundsMin[k]);
+					accMax[k] = max(accMax[k], bins[b].boundsMax[k]);
+				}
+				accCount += bins[b].count;
+				rightCost[b] = (accCount > 0) ? accCount * HalfArea(accMin, accMax) : 0.0f;
+			}
+
+			int bestSplit = -1;
+			float bestCost = FLT_MAX;
+			for (int s = 1; s < NumBins; s++)
+			{
+				float cost = leftCost[s] + rightCost[s];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestSplit = s;
+				}
+			}
+
+			if (bestSplit != -1)
+			{
+				int *mid = partition(objectIndices.data() + first, objectIndices.data() + first + count, [&](int _obj)
+				{
+					const float *c = &centroids[_obj].x;
+					return min(NumBins - 1, (int)((c[axis] - cMin[axis]) * scale)) < bestSplit;
+				});
+				leftCount = (int)(mid - (objectIndices.data() + first));
+			}
+		}
+
+		if (leftCount == 0 || leftCount == count)
+		{
+			// sah found nothing useful (stacked centroids or overflowing areas), fall back to a median split
+			leftCount = count / 2;
+			nth_element(objectIndices.begin() + first, objectIndices.begin() + first + leftCount, objectIndices.begin() + first + count, [&](int _a, int _b)
+			{
+				return (&centroids[_a].x)[axis] < (&centroids[_b].x)[axis];
+			});
+		}
+
+		// ------------------------------------------------ create children
+		int left = (int)nodes.size();
+
+		BVHNode child;
+		child.left = -1;
+		child.parent = n;
+		child.first = first;
+		child.count = leftCount;
+		nodes.push_back(child);
+
+		child.first = first + leftCount;
+		child.count = count - leftCount;
+		nodes.push_back(child);
+
+		nodes[n].left = left;
+		UpdateNodeBounds(left, _bounds);
+		UpdateNodeBounds(left + 1, _bounds);
+
+		work.push_back(left);
+		work.push_back(left + 1);
+	}
+}
+
+void ShadowBVH::UpdateNodeBounds(int _node, const ShadowBoundsStore &_bounds)
+{
+	BVHNode &node = nodes[_node];
+
+	if (node.left != -1)
+	{
+		const BVHNode &l = nodes[node.left];
+		const BVHNode &r = nodes[node.left + 1];
+		node.boundsMin = XMFLOAT3(min(l.boundsMin.x, r.boundsMin.x), min(l.boundsMin.y, r.boundsMin.y), min(l.boundsMin.z, r.boundsMin.z));
+		node.boundsMax = XMFLOAT3(max(l.boundsMax.x, r.boundsMax.x), max(l.boundsMax.y, r.boundsMax.y), max(l.boundsMax.z, r.boundsMax.z));
+		return;
+	}
+
+	node.boundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	node.boundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for (int i = node.first; i < node.first + node.count; i++)
+	{
+		int obj = objectIndices[i];
+		node.boundsMin.x = min(node.boundsMin.x, _bounds.centerX[obj] - _bounds.extentX[obj]);
+		node.boundsMin.y = min(node.boundsMin.y, _bounds.centerY[obj] - _bounds.extentY[obj]);
+		node.boundsMin.z = min(node.boundsMin.z, _bounds.centerZ[obj] - _bounds.extentZ[obj]);
+		node.boundsMax.x = max(node.boundsMax.x, _bounds.centerX[obj] + _bounds.extentX[obj]);
+		node.boundsMax.y = max(node.boundsMax.y, _bounds.centerY[obj] + _bounds.extentY[obj]);
+		node.boundsMax.z = max(node.boundsMax.z, _bounds.centerZ[obj] + _bounds.extentZ[obj]);
+	}
+}
+
+void ShadowBVH::AppendSubtree(int _node, vector<int> &_visible)
+{
+	const BVHNode &node = nodes[_node];
+	_visible.insert(_visible.end(), objectIndices.begin() + node.first, objectIndices.begin() + node.first + node.count);
+}
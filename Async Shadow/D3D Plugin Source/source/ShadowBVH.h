@@ -0,0 +1,68 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include "ShadowCulling.h"
+
+// bounding volume hierarchy over caster bounds, built with binned sah and refitted for moving casters
+class ShadowBVH
+{
+public:
+	ShadowBVH();
+	~ShadowBVH();
+
+	void Build(const ShadowBoundsStore &_bounds);
+	void Clear();
+	bool IsBuilt();
+
+	// objects whose bounds changed are refitted before next traversal instead of a full rebuild
+	void MarkDirty(int _index);
+	void Refit(const ShadowBoundsStore &_bounds);
+	void Update(const ShadowBoundsStore &_bounds);
+
+	int Cull(const ShadowFrustum &_frustum, const ShadowBoundsStore &_bounds, vector<int> &_visible);
+
+private:
+	struct BVHNode
+	{
+		XMFLOAT3 boundsMin;
+		int left;				// first child, children are stored next to each other. -1 for leaf.
+		XMFLOAT3 boundsMax;
+		int parent;
+		int first;				// every node covers a continuous range of objectIndices
+		int count;
+	};
+
+	void Subdivide(int _node, const ShadowBoundsStore &_bounds);
+	void UpdateNodeBounds(int _node, const ShadowBoundsStore &_bounds);
+	void AppendSubtree(int _node, vector<int> &_visible);
+
+	vector<BVHNode> nodes;
+	vector<int> objectIndices;
+	vector<int> objectLeaf;
+	vector<XMFLOAT3> centroids;
+	vector<int> dirtyObjects;
+	vector<bool> dirtyFlag;
+	vector<int> traverseStack;
+	bool built = false;
+};
@@ -0,0 +1,516 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#include "ShadowCulling.h"
+#include <intrin.h>
+#include <string.h>
+#include <immintrin.h>
+
+static float *AllocColumn(int _capacity)
+{
+	return (float*)_aligned_malloc(sizeof(float) * _capacity, 32);
+}
+
+static void FreeColumn(float *&_column)
+{
+	if (_column != nullptr)
+	{
+		_aligned_free(_column);
+		_column = nullptr;
+	}
+}
+
+static void GrowColumn(float *&_column, int _count, int _capacity)
+{
+	float *newColumn = AllocColumn(_capacity);
+	if (_column != nullptr)
+	{
+		memcpy(newColumn, _column, sizeof(float) * _count);
+	}
+
+	FreeColumn(_column);
+	_column = newColumn;
+}
+
+ShadowBoundsStore::ShadowBoundsStore()
+{
+
+}
+
+ShadowBoundsStore::~ShadowBoundsStore()
+{
+	Clear();
+}
+
+void ShadowBoundsStore::Resize(int _count)
+{
+	// keep capacity a multiple of 8 so the widest kernel never reads past the columns
+	int newCapacity = (_count + 7) & ~7;
+	if (newCapacity > capacity)
+	{
+		GrowColumn(centerX, count, newCapacity);
+		GrowColumn(centerY, count, newCapacity);
+		GrowColumn(centerZ, count, newCapacity);
+		GrowColumn(extentX, count, newCapacity);
+		GrowColumn(extentY, count, newCapacity);
+		GrowColumn(extentZ, count, newCapacity);
+		capacity = newCapacity;
+	}
+
+	int oldCount = count;
+	count = _count;
+
+	// new entries and padding are never culled until real bounds arrive
+	for (int i = oldCount; i < capacity; i++)
+	{
+		SetBounds(i, InfiniteBounds);
+	}
+}
+
+void ShadowBoundsStore::Clear()
+{
+	FreeColumn(centerX);
+	FreeColumn(centerY);
+	FreeColumn(centerZ);
+	FreeColumn(extentX);
+	FreeColumn(extentY);
+	FreeColumn(extentZ);
+	count = 0;
+	capacity = 0;
+}
+
+void ShadowBoundsStore::SetBounds(int _index, const BoundingBox &_bounds)
+{
+	centerX[_index] = _bounds.Center.x;
+	centerY[_index] = _bounds.Center.y;
+	centerZ[_index] = _bounds.Center.z;
+	extentX[_index] = _bounds.Extents.x;
+	extentY[_index] = _bounds.Extents.y;
+	extentZ[_index] = _bounds.Extents.z;
+}
+
+BoundingBox ShadowBoundsStore::GetBounds(int _index) const
+{
+	return BoundingBox(XMFLOAT3(centerX[_index], centerY[_index], centerZ[_index]),
+		XMFLOAT3(extentX[_index], extentY[_index], extentZ[_index]));
+}
+
+int ShadowBoundsStore::Size() const
+{
+	return count;
+}
+
+ShadowCulling::ShadowCulling()
+{
+	// default to an "accept all" frustum until a light transform arrives
+	for (int i = 0; i < 6; i++)
+	{
+		frustum.planes[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, -FLT_MAX);
+	}
+
+	viewProj = XMFLOAT4X4(
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+
+	kernel = GetSupportedKernel();
+}
+
+ShadowCulling::~ShadowCulling()
+{
+
+}
+
+void ShadowCulling::SetFrustum(const XMFLOAT4X4 &_transposedViewProj)
+{
+	// shadow transform is stored transposed for hlsl, so the rows here are the columns of view projection
+	viewProj = _transposedViewProj;
+	const XMFLOAT4X4 &m = _transposedViewProj;
+	XMVECTOR row0 = XMVectorSet(m._11, m._12, m._13, m._14);
+	XMVECTOR row1 = XMVectorSet(m._21, m._22, m._23, m._24);
+	XMVECTOR row2 = XMVectorSet(m._31, m._32, m._33, m._34);
+	XMVECTOR row3 = XMVectorSet(m._41, m._42, m._43, m._44);
+
+	XMVECTOR planes[6];
+	planes[0] = XMVectorAdd(row3, row0);		// left
+	planes[1] = XMVectorSubtract(row3, row0);	// right
+	planes[2] = XMVectorAdd(row3, row1);		// bottom
+	planes[3] = XMVectorSubtract(row3, row1);	// top
+	planes[4] = row2;							// near (d3d clip z starts from 0)
+	planes[5] = XMVectorSubtract(row3, row2);	// far
+
+	// the equations above point inside the volume, flip them for ContainedBy()
+	for (int i = 0; i < 6; i++)
+	{
+		XMStoreFloat4(&frustum.planes[i], XMVectorNegate(XMPlaneNormalize(planes[i])));
+	}
+}
+
+const ShadowFrustum &ShadowCulling::GetFrustum()
+{
+	return frustum;
+}
+
+void ShadowCulling::SetKernel(CullingKernel _kernel)
+{
+	CullingKernel supported = GetSupportedKernel();
+	kernel = (_kernel > supported) ? supported : _kernel;
+}
+
+CullingKernel ShadowCulling::GetKernel()
+{
+	return kernel;
+}
+
+CullingKernel ShadowCulling::GetSupportedKernel()
+{
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	// avx2 needs both cpu support and os saving ymm registers
+	if (osxsave && avx && maxLeaf >= 7 && (_xgetbv(0) & 6) == 6)
+	{
+		__cpuidex(info, 7, 0);
+		if ((info[1] & (1 << 5)) != 0)
+		{
+			return CullingKernel_AVX2;
+		}
+	}
+
+	return sse2 ? CullingKernel_SSE : CullingKernel_Scalar;
+}
+
+void ShadowCulling::SetMapSize(float _width, float _height)
+{
+	mapWidth = _width;
+	mapHeight = _height;
+}
+
+bool ShadowCulling::TestBounds(const BoundingBox &_bounds)
+{
+	ContainmentType result = _bounds.ContainedBy(
+		XMLoadFloat4(&frustum.planes[0]),
+		XMLoadFloat4(&frustum.planes[1]),
+		XMLoadFloat4(&frustum.planes[2]),
+		XMLoadFloat4(&frustum.planes[3]),
+		XMLoadFloat4(&frustum.planes[4]),
+		XMLoadFloat4(&frustum.planes[5]));
+
+	return result != DISJOINT;
+}
+
+int ShadowCulling::Cull(const ShadowBoundsStore &_bounds, vector<int> &_visible)
+{
+	// kernels write one slot past every accepted index, reserve a full vector of slack
+	_visible.resize(_bounds.Size() + 8);
+
+	int visibleCount = CullRange(_bounds, 0, _bounds.Size(), _visible.data());
+
+	_visible.resize(visibleCount);
+	return visibleCount;
+}
+
+int ShadowCulling::CullRange(const ShadowBoundsStore &_bounds, int _begin, int _end, int *_visible)
+{
+	switch (kernel)
+	{
+	case CullingKernel_AVX2:
+		return CullAVX2(_bounds, _begin, _end, _visible);
+	case CullingKernel_SSE:
+		return CullSSE(_bounds, _begin, _end, _visible);
+	default:
+		return CullScalar(_bounds, _begin, _end, _visible);
+	}
+}
+
+int ShadowCulling::CullSmall(const ShadowBoundsStore &_bounds, float _minTexels, vector<int> &_visible)
+{
+	// ndc spans 2 units across the map, so extents in ndc times resolution is the covered texel count per axis
+	float scaleX = mapWidth;
+	float scaleY = mapHeight;
+	float ax = fabsf(viewProj._11), ay = fabsf(viewProj._12), az = fabsf(viewProj._13);
+	float bx = fabsf(viewProj._21), by = fabsf(viewProj._22), bz = fabsf(viewProj._23);
+
+	int survivors = 0;
+	for (int i = 0; i < (int)_visible.size(); i++)
+	{
+		int obj = _visible[i];
+		float ex = _bounds.extentX[obj];
+		float ey = _bounds.extentY[obj];
+		float ez = _bounds.extentZ[obj];
+
+		float texelsX = (ax * ex + ay * ey + az * ez) * scaleX;
+		float texelsY = (bx * ex + by * ey + bz * ez) * scaleY;
+
+		if (texelsX * texelsY >= _minTexels)
+		{
+			_visible[survivors++] = obj;
+		}
+	}
+
+	int culled = (int)_visible.size() - survivors;
+	_visible.resize(survivors);
+
+	return culled;
+}
+
+void ShadowCulling::SetReceiverVolume(const XMFLOAT3 *_cameraCorners)
+{
+	// light space depth grows along the light direction, the third row of the transposed matrix is its gradient
+	XMVECTOR lightDir = XMVector3Normalize(XMVectorSet(viewProj._31, viewProj._32, viewProj._33, 0.0f));
+
+	// casters cast along the light direction, so receivers are reached by sweeping the camera volume back to the light
+	XMVECTOR sweepDir = XMVectorNegate(lightDir);
+
+	XMVECTOR corners[8];
+	XMVECTOR centroid = XMVectorZero();
+	for (int i = 0; i < 8; i++)
+	{
+		corners[i] = XMLoadFloat3(&_cameraCorners[i]);
+		centroid = XMVectorAdd(centroid, corners[i]);
+	}
+	centroid = XMVectorScale(centroid, 1.0f / 8.0f);
+
+	// near, far, then the four sides. side k goes through corners k and k + 1.
+	static const int faceCorners[6][3] = { { 0, 1, 2 }, { 4, 5, 6 }, { 0, 1, 5 }, { 1, 2, 6 }, { 2, 3, 7 }, { 3, 0, 4 } };
+	bool faceKept[6];
+
+	receiverVolume.planeCount = 0;
+	for (int f = 0; f < 6; f++)
+	{
+		XMVECTOR a = corners[faceCorners[f][0]];
+		XMVECTOR b = corners[faceCorners[f][1]];
+		XMVECTOR c = corners[faceCorners[f][2]];
+		XMVECTOR normal = XMVector3Normalize(XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a)));
+		XMVECTOR plane = XMPlaneFromPointNormal(a, normal);
+
+		// point outward
+		if (XMVectorGetX(XMPlaneDotCoord(plane, centroid)) > 0.0f)
+		{
+			plane = XMVectorNegate(plane);
+		}
+
+		// faces looking along the sweep are pushed away to infinity, the others still bound the volume
+		faceKept[f] = XMVectorGetX(XMVector3Dot(plane, sweepDir)) <= 0.0f;
+		if (faceKept[f])
+		{
+			XMStoreFloat4(&receiverVolume.planes[receiverVolume.planeCount++], plane);
+		}
+	}
+
+	// silhouette edges, between a kept face and a dropped face, close the volume with planes parallel to the sweep
+	static const int edges[12][4] =
+	{
+		// corner, corner, face, face
+		{ 0, 1, 0, 2 }, { 1, 2, 0, 3 }, { 2, 3, 0, 4 }, { 3, 0, 0, 5 },
+		{ 4, 5, 1, 2 }, { 5, 6, 1, 3 }, { 6, 7, 1, 4 }, { 7, 4, 1, 5 },
+		{ 0, 4, 2, 5 }, { 1, 5, 2, 3 }, { 2, 6, 3, 4 }, { 3, 7, 4, 5 }
+	};
+
+	for (int e = 0; e < 12; e++)
+	{
+		if (faceKept[edges[e][2]] == faceKept[edges[e][3]])
+		{
+			continue;
+		}
+
+		XMVECTOR a = corners[edges[e][0]];
+		XMVECTOR b = corners[edges[e][1]];
+		XMVECTOR normal = XMVector3Cross(XMVectorSubtract(b, a), sweepDir);
+		if (XMVectorGetX(XMVector3Length(normal)) < 1e-6f)
+		{
+			continue;
+		}
+
+		XMVECTOR plane = XMPlaneFromPointNormal(a, XMVector3Normalize(normal));
+		if (XMVectorGetX(XMPlaneDotCoord(plane, centroid)) > 0.0f)
+		{
+			plane = XMVectorNegate(plane);
+		}
+		XMStoreFloat4(&receiverVolume.planes[receiverVolume.planeCount++], plane);
+	}
+}
+
+const ShadowReceiverVolume &ShadowCulling::GetReceiverVolume()
+{
+	return receiverVolume;
+}
+
+int ShadowCulling::CullReceivers(const ShadowBoundsStore &_bounds, vector<int> &_visible)
+{
+	int survivors = 0;
+	for (int i = 0; i < (int)_visible.size(); i++)
+	{
+		int obj = _visible[i];
+
+		bool outside = false;
+		for (int p = 0; p < receiverVolume.planeCount; p++)
+		{
+			const XMFLOAT4 &plane = receiverVolume.planes[p];
+			float dist = _bounds.centerX[obj] * plane.x + _bounds.centerY[obj] * plane.y + _bounds.centerZ[obj] * plane.z + plane.w;
+			float radius = _bounds.extentX[obj] * fabsf(plane.x) + _bounds.extentY[obj] * fabsf(plane.y) + _bounds.extentZ[obj] * fabsf(plane.z);
+			outside |= dist > radius;
+		}
+
+		_visible[survivors] = obj;
+		survivors += outside ? 0 : 1;
+	}
+
+	int culled = (int)_visible.size() - survivors;
+	_visible.resize(survivors);
+
+	return culled;
+}
+
+int ShadowCulling::CullScalar(const ShadowBoundsStore &_bounds, int _begin, int _end, int *_visible)
+{
+	int visibleCount = 0;
+
+	for (int i = _begin; i < _end; i++)
+	{
+		bool outside = false;
+		for (int p = 0; p < 6; p++)
+		{
+			const XMFLOAT4 &plane = frustum.planes[p];
+			float dist = _bounds.centerX[i] * plane.x + _bounds.centerY[i] * plane.y + _bounds.centerZ[i] * plane.z + plane.w;
+			float radius = _bounds.extentX[i] * fabsf(plane.x) + _bounds.extentY[i] * fabsf(plane.y) + _bounds.extentZ[i] * fabsf(plane.z);
+			outside |= dist > radius;
+		}
+
+		_visible[visibleCount] = i;
+		visibleCount += outside ? 0 : 1;
+	}
+
+	return visibleCount;
+}
+
+int ShadowCulling::CullSSE(const ShadowBoundsStore &_bounds, int _begin, int _end, int *_visible)
+{
+	__m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+	for (int p = 0; p < 6; p++)
+	{
+		const XMFLOAT4 &plane = frustum.planes[p];
+		nx[p] = _mm_set1_ps(plane.x);
+		ny[p] = _mm_set1_ps(plane.y);
+		nz[p] = _mm_set1_ps(plane.z);
+		nw[p] = _mm_set1_ps(plane.w);
+		ax[p] = _mm_set1_ps(fabsf(plane.x));
+		ay[p] = _mm_set1_ps(fabsf(plane.y));
+		az[p] = _mm_set1_ps(fabsf(plane.z));
+	}
+
+	int visibleCount = 0;
+
+	for (int i = _begin; i < _end; i += 4)
+	{
+		__m128 cx = _mm_load_ps(_bounds.centerX + i);
+		__m128 cy = _mm_load_ps(_bounds.centerY + i);
+		__m128 cz = _mm_load_ps(_bounds.centerZ + i);
+		__m128 ex = _mm_load_ps(_bounds.extentX + i);
+		__m128 ey = _mm_load_ps(_bounds.extentY + i);
+		__m128 ez = _mm_load_ps(_bounds.extentZ + i);
+
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, nx[p]), _mm_mul_ps(cy, ny[p])), _mm_add_ps(_mm_mul_ps(cz, nz[p]), nw[p]));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, ax[p]), _mm_mul_ps(ey, ay[p])), _mm_mul_ps(ez, az[p]));
+			outside = _mm_or_ps(outside, _mm_cmpgt_ps(dist, radius));
+		}
+
+		// drop the padding lanes of the last block
+		int mask = ~_mm_movemask_ps(outside) & 0xF;
+		if (_end - i < 4)
+		{
+			mask &= (1 << (_end - i)) - 1;
+		}
+
+		// branchless compaction, always write and only advance on visible lanes
+		for (int j = 0; j < 4; j++)
+		{
+			_visible[visibleCount] = i + j;
+			visibleCount += (mask >> j) & 1;
+		}
+	}
+
+	return visibleCount;
+}
+
+int ShadowCulling::CullAVX2(const ShadowBoundsStore &_bounds, int _begin, int _end, int *_visible)
+{
+	__m256 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+	for (int p = 0; p < 6; p++)
+	{
+		const XMFLOAT4 &plane = frustum.planes[p];
+		nx[p] = _mm256_set1_ps(plane.x);
+		ny[p] = _mm256_set1_ps(plane.y);
+		nz[p] = _mm256_set1_ps(plane.z);
+		nw[p] = _mm256_set1_ps(plane.w);
+		ax[p] = _mm256_set1_ps(fabsf(plane.x));
+		ay[p] = _mm256_set1_ps(fabsf(plane.y));
+		az[p] = _mm256_set1_ps(fabsf(plane.z));
+	}
+
+	int visibleCount = 0;
+
+	for (int i = _begin; i < _end; i += 8)
+	{
+		__m256 cx = _mm256_load_ps(_bounds.centerX + i);
+		__m256 cy = _mm256_load_ps(_bounds.centerY + i);
+		__m256 cz = _mm256_load_ps(_bounds.centerZ + i);
+		__m256 ex = _mm256_load_ps(_bounds.extentX + i);
+		__m256 ey = _mm256_load_ps(_bounds.extentY + i);
+		__m256 ez = _mm256_load_ps(_bounds.extentZ + i);
+
+		__m256 outside = _mm256_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, nx[p]), _mm256_mul_ps(cy, ny[p])), _mm256_add_ps(_mm256_mul_ps(cz, nz[p]), nw[p]));
+			__m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, ax[p]), _mm256_mul_ps(ey, ay[p])), _mm256_mul_ps(ez, az[p]));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, radius, _CMP_GT_OQ));
+		}
+
+		// drop the padding lanes of the last block
+		int mask = ~_mm256_movemask_ps(outside) & 0xFF;
+		if (_end - i < 8)
+		{
+			mask &= (1 << (_end - i)) - 1;
+		}
+
+		// branchless compaction, always write and only advance on visible lanes
+		for (int j = 0; j < 8; j++)
+		{
+			_visible[visibleCount] = i + j;
+			visibleCount += (mask >> j) & 1;
+		}
+	}
+
+	return visibleCount;
+}
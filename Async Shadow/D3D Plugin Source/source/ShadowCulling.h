@@ -0,0 +1,130 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include <vector>
+#include <cfloat>
+#include <malloc.h>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+using namespace DirectX;
+using namespace std;
+
+// six planes of the light view projection, pointing outward as DirectXCollision expects
+struct ShadowFrustum
+{
+	XMFLOAT4 planes[6];
+};
+
+// camera frustum swept along the light direction, casters outside of it can't shadow anything on screen.
+// 6 faces and 12 edges of a frustum give at most 18 planes.
+const int MaxReceiverPlanes = 18;
+struct ShadowReceiverVolume
+{
+	XMFLOAT4 planes[MaxReceiverPlanes];
+	int planeCount = 0;
+};
+
+// bounds that never get culled, used before real bounds arrive
+static const BoundingBox InfiniteBounds(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX));
+
+// structure of arrays bounds, every column is 32-byte aligned and padded to 8 elements for avx loads
+class ShadowBoundsStore
+{
+public:
+	ShadowBoundsStore();
+	~ShadowBoundsStore();
+	ShadowBoundsStore(const ShadowBoundsStore& rhs) = delete;
+	ShadowBoundsStore& operator=(const ShadowBoundsStore& rhs) = delete;
+
+	void Resize(int _count);
+	void Clear();
+	void SetBounds(int _index, const BoundingBox &_bounds);
+	BoundingBox GetBounds(int _index) const;
+	int Size() const;
+
+	float *centerX = nullptr;
+	float *centerY = nullptr;
+	float *centerZ = nullptr;
+	float *extentX = nullptr;
+	float *extentY = nullptr;
+	float *extentZ = nullptr;
+
+private:
+	int count = 0;
+	int capacity = 0;
+};
+
+enum CullingKernel
+{
+	CullingKernel_Scalar = 0,
+	CullingKernel_SSE,
+	CullingKernel_AVX2
+};
+
+// cpu culling of shadow casters, no device needed here
+class ShadowCulling
+{
+public:
+	ShadowCulling();
+	~ShadowCulling();
+
+	void SetFrustum(const XMFLOAT4X4 &_transposedViewProj);
+	const ShadowFrustum &GetFrustum();
+
+	// kernel is picked from cpu features at construction, a forced kernel is clamped to what cpu supports
+	void SetKernel(CullingKernel _kernel);
+	CullingKernel GetKernel();
+	static CullingKernel GetSupportedKernel();
+
+	// projected size test needs the shadow map resolution
+	void SetMapSize(float _width, float _height);
+
+	bool TestBounds(const BoundingBox &_bounds);
+	int Cull(const ShadowBoundsStore &_bounds, vector<int> &_visible);
+
+	// culls [_begin, _end), _begin must be a multiple of 8 and _visible needs (_end - _begin + 8) slots
+	int CullRange(const ShadowBoundsStore &_bounds, int _begin, int _end, int *_visible);
+
+	// drops casters whose projected bounds cover fewer than _minTexels shadow texels, returns how many were dropped
+	int CullSmall(const ShadowBoundsStore &_bounds, float _minTexels, vector<int> &_visible);
+
+	// corners are near plane then far plane, both in the same winding. light direction comes from SetFrustum().
+	void SetReceiverVolume(const XMFLOAT3 *_cameraCorners);
+	const ShadowReceiverVolume &GetReceiverVolume();
+
+	// drops casters outside of the receiver volume, returns how many were dropped
+	int CullReceivers(const ShadowBoundsStore &_bounds, vector<int> &_visible);
+
+private:
+	int CullScalar(const ShadowBoundsStore &_bounds, int _begin, int _end, int *_visible);
+	int CullSSE(const ShadowBoundsStore &_bounds, int _begin, int _end, int *_visible);
+	int CullAVX2(const ShadowBoundsStore &_bounds, int _begin, int _end, int *_visible);
+
+	ShadowFrustum frustum;
+	ShadowReceiverVolume receiverVolume;
+	XMFLOAT4X4 viewProj;
+	float mapWidth = 1.0f;
+	float mapHeight = 1.0f;
+	CullingKernel kernel;
+};
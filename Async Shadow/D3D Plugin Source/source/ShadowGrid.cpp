@@ -0,0 +1,326 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+#include "ShadowGrid.h"
+#include <algorithm>
+#include <cmath>
+
+static const int TargetObjectsPerCell = 16;
+static const int CellCoordBias = 1 << 20;
+
+static bool IsUnbounded(const ShadowBoundsStore &_bounds, int _index)
+{
+	return !(_bounds.extentX[_index] < FLT_MAX && _bounds.extentY[_index] < FLT_MAX && _bounds.extentZ[_index] < FLT_MAX);
+}
+
+ShadowGrid::ShadowGrid()
+{
+
+}
+
+ShadowGrid::~ShadowGrid()
+{
+	Clear();
+}
+
+void ShadowGrid::Build(const ShadowBoundsStore &_bounds)
+{
+	Clear();
+
+	int count = _bounds.Size();
+	objectCell.assign(count, -1);
+	objectSlot.assign(count, -1);
+	dirtyFlag.assign(count, false);
+	built = true;
+
+	// pick a cell size that gives a handful of objects per cell, but never smaller than the objects themselves
+	XMFLOAT3 sceneMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 sceneMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	double extentSum = 0.0;
+	int finiteCount = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		if (IsUnbounded(_bounds, i))
+		{
+			continue;
+		}
+
+		sceneMin.x = min(sceneMin.x, _bounds.centerX[i]);
+		sceneMin.y = min(sceneMin.y, _bounds.centerY[i]);
+		sceneMin.z = min(sceneMin.z, _bounds.centerZ[i]);
+		sceneMax.x = max(sceneMax.x, _bounds.centerX[i]);
+		sceneMax.y = max(sceneMax.y, _bounds.centerY[i]);
+		sceneMax.z = max(sceneMax.z, _bounds.centerZ[i]);
+		extentSum += max(_bounds.extentX[i], max(_bounds.extentY[i], _bounds.extentZ[i]));
+		finiteCount++;
+	}
+
+	cellSize = 1.0f;
+	if (finiteCount > 0)
+	{
+		float avgExtent = (float)(extentSum / finiteCount);
+		float sizeX = max(sceneMax.x - sceneMin.x, avgExtent);
+		float sizeY = max(sceneMax.y - sceneMin.y, avgExtent);
+		float sizeZ = max(sceneMax.z - sceneMin.z, avgExtent);
+
+		float cellVolume = sizeX * sizeY * sizeZ * TargetObjectsPerCell / finiteCount;
+		cellSize = max(powf(cellVolume, 1.0f / 3.0f), avgExtent * 2.0f);
+
+		// keep cell coordinates inside the packed key range
+		float maxSize = max(sizeX, max(sizeY, sizeZ));
+		cellSize = max(cellSize, maxSize / (float)CellCoordBias);
+		cellSize = max(cellSize, 1e-3f);
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		Insert(i, _bounds);
+	}
+}
+
+void ShadowGrid::Clear()
+{
+	cells.clear();
+	cellLookup.clear();
+	unboundedObjects.clear();
+	emptyCells = 0;
+	objectCell.clear();
+	objectSlot.clear();
+	dirtyObjects.clear();
+	dirtyFlag.clear();
+	built = false;
+}
+
+bool ShadowGrid::IsBuilt()
+{
+	return built;
+}
+
+void ShadowGrid::MarkDirty(int _index)
+{
+	if (!built || _index < 0 || _index >= (int)dirtyFlag.size())
+	{
+		return;
+	}
+
+	if (!dirtyFlag[_index])
+	{
+		dirtyFlag[_index] = true;
+		dirtyObjects.push_back(_index);
+	}
+}
+
+void ShadowGrid::Update(const ShadowBoundsStore &_bounds)
+{
+	if (!built || (int)objectCell.size() != _bounds.Size())
+	{
+		Build(_bounds);
+		return;
+	}
+
+	for (int i = 0; i < (int)dirtyObjects.size(); i++)
+	{
+		int obj = dirtyObjects[i];
+		dirtyFlag[obj] = false;
+
+		// most movers stay in their cell
+		int c = objectCell[obj];
+		if (c != -1 && !IsUnbounded(_bounds, obj) && cells[c].key == CellKey(_bounds.centerX[obj], _bounds.centerY[obj], _bounds.centerZ[obj]))
+		{
+			GrowCell(c, obj, _bounds);
+			continue;
+		}
+
+		Remove(obj);
+		Insert(obj, _bounds);
+	}
+	dirtyObjects.clear();
+
+	// wandering objects leave empty cells and stretched bounds behind, start over once half of the cells are empty
+	if (emptyCells > 64 && emptyCells * 2 > (int)cells.size())
+	{
+		Build(_bounds);
+	}
+}
+
+int ShadowGrid::Cull(const ShadowFrustum &_frustum, const ShadowBoundsStore &_bounds, vector<int> &_visible)
+{
+	_visible.assign(unboundedObjects.begin(), unboundedObjects.end());
+
+	for (int c = 0; c < (int)cells.size(); c++)
+	{
+		const GridCell &cell = cells[c];
+		if (cell.objects.empty())
+		{
+			continue;
+		}
+
+		// reject or accept the whole cell first
+		bool outside = false;
+		bool inside = true;
+		for (int p = 0; p < 6; p++)
+		{
+			const XMFLOAT4 &plane = _frustum.planes[p];
+			float dist = cell.center.x * plane.x + cell.center.y * plane.y + cell.center.z * plane.z + plane.w;
+			float radius = cell.looseExtents.x * fabsf(plane.x) + cell.looseExtents.y * fabsf(plane.y) + cell.looseExtents.z * fabsf(plane.z);
+			outside |= dist > radius;
+			inside &= dist < -radius;
+		}
+
+		if (outside)
+		{
+			continue;
+		}
+
+		if (inside)
+		{
+			_visible.insert(_visible.end(), cell.objects.begin(), cell.objects.end());
+			continue;
+		}
+
+		// straddling cells test their objects one by one
+		for (int i = 0; i < (int)cell.objects.size(); i++)
+		{
+			int obj = cell.objects[i];
+
+			bool objOutside = false;
+			for (int p = 0; p < 6; p++)
+			{
+				const XMFLOAT4 &plane = _frustum.planes[p];
+				float dist = _bounds.centerX[obj] * plane.x + _bounds.centerY[obj] * plane.y + _bounds.centerZ[obj] * plane.z + plane.w;
+				float radius = _bounds.extentX[obj] * fabsf(plane.x) + _bounds.extentY[obj] * fabsf(plane.y) + _bounds.extentZ[obj] * fabsf(plane.z);
+				objOutside |= dist > radius;
+			}
+
+			if (!objOutside)
+			{
+				_visible.push_back(obj);
+			}
+		}
+	}
+
+	return (int)_visible.size();
+}
+
+float ShadowGrid::GetCellSize()
+{
+	return cellSize;
+}
+
+int ShadowGrid::GetCellCount()
+{
+	return (int)cells.size();
+}
+
+void ShadowGrid::Insert(int _index, const ShadowBoundsStore &_bounds)
+{
+	if (IsUnbounded(_bounds, _index))
+	{
+		objectCell[_index] = -1;
+		objectSlot[_index] = (int)unboundedObjects.size();
+		unboundedObjects.push_back(_index);
+		return;
+	}
+
+	int c = FindOrAddCell(CellKey(_bounds.centerX[_index], _bounds.centerY[_index], _bounds.centerZ[_index]));
+	GridCell &cell = cells[c];
+	GrowCell(c, _index, _bounds);
+
+	if (cell.objects.empty())
+	{
+		emptyCells--;
+	}
+
+	objectCell[_index] = c;
+	objectSlot[_index] = (int)cell.objects.size();
+	cell.objects.push_back(_index);
+}
+
+void ShadowGrid::Remove(int _index)
+{
+	vector<int> &list = (objectCell[_index] == -1) ? unboundedObjects : cells[objectCell[_index]].objects;
+
+	// swap remove
+	int slot = objectSlot[_index];
+	int last = list.back();
+	list[slot] = last;
+	objectSlot[last] = slot;
+	list.pop_back();
+
+	if (list.empty() && objectCell[_index] != -1)
+	{
+		emptyCells++;
+	}
+
+	objectCell[_index] = -1;
+	objectSlot[_index] = -1;
+}
+
+void ShadowGrid::GrowCell(int _cell, int _index, const ShadowBoundsStore &_bounds)
+{
+	// loose bounds only grow, a rebuild shrinks them again
+	GridCell &cell = cells[_cell];
+	cell.looseExtents.x = max(cell.looseExtents.x, fabsf(_bounds.centerX[_index] - cell.center.x) + _bounds.extentX[_index]);
+	cell.looseExtents.y = max(cell.looseExtents.y, fabsf(_bounds.centerY[_index] - cell.center.y) + _bounds.extentY[_index]);
+	cell.looseExtents.z = max(cell.looseExtents.z, fabsf(_bounds.centerZ[_index] - cell.center.z) + _bounds.extentZ[_index]);
+}
+
+long long ShadowGrid::CellKey(float _x, float _y, float _z)
+{
+	// coordinates are clamped so 21 bits per axis are enough for the key
+	long long ix = (long long)floorf(_x / cellSize);
+	long long iy = (long long)floorf(_y / cellSize);
+	long long iz = (long long)floorf(_z / cellSize);
+	ix = min(max(ix, (long long)-CellCoordBias), (long long)CellCoordBias - 1);
+	iy = min(max(iy, (long long)-CellCoordBias), (long long)CellCoordBias - 1);
+	iz = min(max(iz, (long long)-CellCoordBias), (long long)CellCoordBias - 1);
+
+	return ((ix + CellCoordBias) << 42) | ((iy + CellCoordBias) << 21) | (iz + CellCoordBias);
+}
+
+int ShadowGrid::FindOrAddCell(long long _key)
+{
+	auto it = cellLookup.find(_key);
+	if (it != cellLookup.end())
+	{
+		return it->second;
+	}
+
+	const long long mask = (1 << 21) - 1;
+	float ix = (float)(((_key >> 42) & mask) - CellCoordBias);
+	float iy = (float)(((_key >> 21) & mask) - CellCoordBias);
+	float iz = (float)((_key & mask) - CellCoordBias);
+
+	GridCell cell;
+	cell.center = XMFLOAT3((ix + 0.5f) * cellSize, (iy + 0.5f) * cellSize, (iz + 0.5f) * cellSize);
+	cell.looseExtents = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	cell.key = _key;
+
+	// new cells start empty, the insert right after fills them
+	emptyCells++;
+	int c = (int)cells.size();
+	cells.push_back(cell);
+	cellLookup[_key] = c;
+
+	return c;
+}
@@ -0,0 +1,75 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+#pragma once
+#include "ShadowCulling.h"
+#include <unordered_map>
+
+// loose uniform grid hashed on world cells, for caster sets that mostly move every frame.
+// an object lives in the cell holding its center, cell bounds grow to cover every object they ever held.
+// moving an object is a swap remove and a push back, no refit or rebuild needed.
+class ShadowGrid
+{
+public:
+	ShadowGrid();
+	~ShadowGrid();
+
+	void Build(const ShadowBoundsStore &_bounds);
+	void Clear();
+	bool IsBuilt();
+
+	// moved objects change cells on next update
+	void MarkDirty(int _index);
+	void Update(const ShadowBoundsStore &_bounds);
+
+	int Cull(const ShadowFrustum &_frustum, const ShadowBoundsStore &_bounds, vector<int> &_visible);
+
+	float GetCellSize();
+	int GetCellCount();
+
+private:
+	struct GridCell
+	{
+		XMFLOAT3 center;
+		XMFLOAT3 looseExtents;		// covers every object that was ever in this cell
+		long long key;
+		vector<int> objects;
+	};
+
+	void Insert(int _index, const ShadowBoundsStore &_bounds);
+	void Remove(int _index);
+	void GrowCell(int _cell, int _index, const ShadowBoundsStore &_bounds);
+	long long CellKey(float _x, float _y, float _z);
+	int FindOrAddCell(long long _key);
+
+	float cellSize = 1.0f;
+	vector<GridCell> cells;
+	unordered_map<long long, int> cellLookup;
+	vector<int> unboundedObjects;	// never culled bounds don't belong to any cell
+	int emptyCells = 0;
+
+	vector<int> objectCell;			// cell index, -1 for unbounded objects
+	vector<int> objectSlot;			// position in the cell's object list
+	vector<int> dirtyObjects;
+	vector<bool> dirtyFlag;
+	bool built = false;
+};
@@ -21,27 +21,88 @@
 //SOFTWARE.
 
 #include "ShadowMap.h"
+#include <intrin.h>
+#include <algorithm>
+
+// packs runs of consecutive slots into a small staging block and streams each block in order,
+// so write-combined upload memory sees whole lines instead of scattered element writes.
+// _slot gives the destination of list entry i or -1 to skip it, _pack fills its element.
+// _write(first, data, count) receives each staged run.
+template<typename T, typename Write, typename Slot, typename Pack>
+static void StreamRuns(Write _write, int _begin, int _end, Slot _slot, Pack _pack)
+{
+	static const int StageCount = (4096 / sizeof(T) > 0) ? 4096 / sizeof(T) : 1;
+	T stage[StageCount];
+	int runStart = 0;
+	int runCount = 0;
+
+	for (int i = _begin; i < _end; i++)
+	{
+		int slot = _slot(i);
+		if (slot < 0)
+		{
+			continue;
+		}
+
+		if (runCount == StageCount || (runCount > 0 && slot != runStart + runCount))
+		{
+			_write(runStart, stage, runCount);
+			runCount = 0;
+		}
+
+		if (runCount == 0)
+		{
+			runStart = slot;
+		}
+		_pack(i, stage[runCount++]);
+	}
+
+	if (runCount > 0)
+	{
+		_write(runStart, stage, runCount);
+	}
+
+	// streaming stores are weakly ordered, drain them on the thread that wrote them
+	StreamFence();
+}
+
+template<typename T, typename Slot, typename Pack>
+static void StreamRuns(UploadBuffer<T> *_buffer, int _begin, int _end, Slot _slot, Pack _pack)
+{
+	StreamRuns<T>([_buffer](int _first, const T *_data, int _count)
+	{
+		_buffer->CopyRange(_first, _data, _count);
+	}, _begin, _end, _slot, _pack);
+}
 
 ShadowMap::ShadowMap(ID3D12Device * _device)
 {
 	device = _device;
+	requestedMethod = CullingMethod_Linear;
+	useOcclusion = false;
+	minContribution = 0.0f;
 }
 
 ShadowMap::~ShadowMap()
 {
-	vertexBufferView.clear();
-	indexBufferView.clear();
-	shadowObjectMatrix.clear();
+	casters.Clear();
+	meshBounds.clear();
+	meshLookup.clear();
+	quantizer.Clear();
 	cutoutMaps.clear();
-	shadowObjTextureIndex.clear();
+	visibleObjects.clear();
+	cullChunks.clear();
+	cullChunkCount.clear();
+	occluderObjects.clear();
+	occluderBounds.clear();
 
 	for (int i = 0; i < NumOfFrameResources; i++)
 	{
-		shadowCommands[i].clear();
 		SafeReset(shadowObjectCB[i]);
-		SafeReset(shadowLightCB[i]);
+		SafeReset(shadowObjectData[i]);
+		SafeReset(shadowObjectQuantized[i]);
 		SafeReset(shadowIndirectBuffer[i]);
-		SafeReset(shadowIndirectUploader[i]);
+		uploadRing[i].Release();
 		SafeReset(bundleCmdAlloc[i]);
 		SafeReset(bundleCmdList[i]);
 	}
@@ -55,10 +116,57 @@ ShadowMap::~ShadowMap()
 	SafeReset(shadowCmdSignature);
 }
 
+void ShadowMap::SetJobSystem(JobSystem * _jobSystem)
+{
+	jobSystem = _jobSystem;
+}
+
+void ShadowMap::SetObjectDataLayout(ObjectDataLayout _layout)
+{
+	// root signature, pso and buffers depend on it, so it only counts before they are created
+	if (shadowRS == nullptr)
+	{
+		objectLayout = _layout;
+	}
+}
+
+void ShadowMap::SetTransformArena(bool _enable)
+{
+	// arena is sized with the object buffers
+	if (shadowRS == nullptr)
+	{
+		useTransformArena = _enable;
+	}
+}
+
 void ShadowMap::AddMesh(D3D12_VERTEX_BUFFER_VIEW _vbv, D3D12_INDEX_BUFFER_VIEW _ibv)
 {
-	vertexBufferView.push_back(_vbv);
-	indexBufferView.push_back(_ibv);
+	casters.Add(_vbv, _ibv, FindOrAddMesh(_vbv.BufferLocation));
+}
+
+void ShadowMap::SetMeshBounds(D3D12_GPU_VIRTUAL_ADDRESS _vertexBuffer, XMFLOAT3 _center, XMFLOAT3 _extents, float _radius)
+{
+	MeshBounds mesh;
+	mesh.center = _center;
+	mesh.extents = _extents;
+	mesh.radius = _radius;
+	mesh.valid = true;
+
+	// the shadow thread reads mesh bounds once it runs, later meshes go through the caster queue
+	if (castersCreated)
+	{
+		CasterOp op = {};
+		op.type = CasterOp_MeshBounds;
+		op.slot = -1;
+		op.vbv.BufferLocation = _vertexBuffer;
+		op.bounds = mesh;
+
+		lock_guard<mutex> lock(casterMutex);
+		casterOps.push_back(op);
+		return;
+	}
+
+	meshBounds[FindOrAddMesh(_vertexBuffer)] = mesh;
 }
 
 void ShadowMap::AddCutoutTexture(ID3D12Resource * _texture)
@@ -68,53 +176,837 @@ void ShadowMap::AddCutoutTexture(ID3D12Resource * _texture)
 
 void ShadowMap::SetShadowTransform(XMMATRIX _m)
 {
-	XMStoreFloat4x4(&shadowTransform, _m);
+	XMStoreFloat4x4(&sceneSnapshot.GetWriteBuffer().shadowTransform, _m);
+}
+
+void ShadowMap::SetCameraFrustum(const XMFLOAT3 *_corners)
+{
+	SceneSnapshot &scene = sceneSnapshot.GetWriteBuffer();
+	if (_corners == nullptr)
+	{
+		scene.useReceiverCulling = false;
+		return;
+	}
+
+	memcpy(scene.cameraCorners, _corners, sizeof(scene.cameraCorners));
+	scene.useReceiverCulling = true;
 }
 
 XMFLOAT4X4 ShadowMap::GetShadowTransform()
 {
-	return shadowTransform;
+	// main thread owns the write snapshot, it holds the newest transform
+	return sceneSnapshot.GetWriteBuffer().shadowTransform;
 }
 
 void ShadowMap::SetObjectTransform(int _index, XMMATRIX _m)
 {
-	if (_index >= 0 && _index < (int)shadowObjectMatrix.size())
+	if (_index >= 0)
+	{
+		XMStoreFloat4x4(sceneSnapshot.AddTransforms(_index, 1), _m);
+	}
+}
+
+// transforms are composed into the write snapshot, the shadow thread copies them into the registry
+// and updates bounds when it takes the snapshot. indices are checked against the registry there.
+void ShadowMap::SetObjectTransforms(int _first, int _count, const float *_pos, const float *_scale, const float *_rot)
+{
+	if (_first < 0 || _count <= 0)
+	{
+		return;
+	}
+
+	ComposeTransposedTRS(_pos, _scale, _rot, _count, sceneSnapshot.AddTransforms(_first, _count));
+}
+
+void ShadowMap::SetObjectTransforms(int _first, int _count, const TransformStreams &_streams)
+{
+	if (_first < 0 || _count <= 0)
+	{
+		return;
+	}
+
+	ComposeTransposedTRS(_streams, _count, sceneSnapshot.AddTransforms(_first, _count), sizeof(XMFLOAT4X4), 4);
+}
+
+void ShadowMap::SetObjectTransforms(const int *_indices, int _count, const float *_pos, const float *_scale, const float *_rot)
+{
+	if (_count <= 0)
+	{
+		return;
+	}
+
+	// pos/scale/rot are packed per list entry, the snapshot keeps the list order
+	ComposeTransposedTRS(_pos, _scale, _rot, _count, sceneSnapshot.AddTransforms(_indices, _count));
+}
+
+UINT64 ShadowMap::PublishScene()
+{
+	return sceneSnapshot.Publish();
+}
+
+void ShadowMap::ConsumeSceneSnapshot()
+{
+	const SceneSnapshot *scene = sceneSnapshot.Acquire();
+	if (scene == nullptr)
+	{
+		return;
+	}
+
+	// explicit bounds first, a transform with known mesh bounds replaces them
+	int count = casters.Size();
+	for (int i = 0; i < (int)scene->bounds.size(); i++)
+	{
+		const SceneBounds &bounds = scene->bounds[i];
+		if (bounds.index >= 0 && bounds.index < count)
+		{
+			UpdateObjectBounds(bounds.index, BoundingBox(bounds.center, bounds.extents));
+		}
+	}
+
+	// later entries of the same object win, dirty marks go to UpdateConstantBuffer() without the lock
+	for (int i = 0; i < (int)scene->transformIndex.size(); i++)
 	{
-		XMStoreFloat4x4(&shadowObjectMatrix[_index], _m);
+		int idx = scene->transformIndex[i];
+		if (idx < 0 || idx >= count)
+		{
+			continue;
+		}
+
+		casters.world[idx] = scene->transformWorld[i];
+		sceneDirty.push_back(idx);
+		UpdateTransformBounds(idx);
 	}
 }
 
+TransformArenaHeader *ShadowMap::GetTransformArena()
+{
+	return transformArena.IsCreated() ? transformArena.GetWriteBuffer() : nullptr;
+}
+
+TransformArenaHeader *ShadowMap::PublishTransformArena(UINT64 _sequence)
+{
+	return transformArena.Publish(_sequence);
+}
+
+void ShadowMap::ConsumeTransformArena()
+{
+	TransformArenaHeader *buffer = transformArena.Acquire();
+	if (buffer == nullptr)
+	{
+		return;
+	}
+
+	// collect dirty records and clear them, the buffer must go back to the engine clean
+	uint32_t *dirty = TransformArena::GetDirtyBits(buffer);
+	int count = min((int)buffer->recordCount, casters.Size());
+	arenaIndices.clear();
+	for (uint32_t w = 0; w < buffer->dirtyWords; w++)
+	{
+		uint32_t bits = dirty[w];
+		dirty[w] = 0;
+
+		while (bits != 0)
+		{
+			unsigned long bit;
+			_BitScanForward(&bit, bits);
+			bits &= bits - 1;
+
+			int idx = (int)(w * 32 + bit);
+			if (idx < count)
+			{
+				arenaIndices.push_back(idx);
+			}
+		}
+	}
+
+	// composed straight from the engine's records, no copy in between
+	ComposeTransposedTRS(TransformArena::GetRecords(buffer), arenaIndices.data(), (int)arenaIndices.size(), casters.world.data());
+
+	{
+		lock_guard<mutex> lock(dirtyMutex);
+		for (int i = 0; i < (int)arenaIndices.size(); i++)
+		{
+			int idx = arenaIndices[i];
+			if (!pendingFlag[idx])
+			{
+				pendingFlag[idx] = true;
+				pendingDirty.push_back(idx);
+			}
+		}
+	}
+
+	for (int i = 0; i < (int)arenaIndices.size(); i++)
+	{
+		UpdateTransformBounds(arenaIndices[i]);
+	}
+}
+
+void ShadowMap::UpdateTransformBounds(int _index)
+{
+	// world bounds follow the transform when the mesh bounds are known
+	if (_index >= casters.Size() || casters.mesh[_index] < 0 || !meshBounds[casters.mesh[_index]].valid)
+	{
+		return;
+	}
+
+	// matrix is transposed, so rows map local axes onto one world axis
+	const MeshBounds &mesh = meshBounds[casters.mesh[_index]];
+	const XMFLOAT4X4 &m = casters.world[_index];
+	const float rows[3][4] = { { m._11, m._12, m._13, m._14 }, { m._21, m._22, m._23, m._24 }, { m._31, m._32, m._33, m._34 } };
+
+	float center[3], extents[3];
+	for (int i = 0; i < 3; i++)
+	{
+		const float *r = rows[i];
+		center[i] = r[0] * mesh.center.x + r[1] * mesh.center.y + r[2] * mesh.center.z + r[3];
+
+		// transformed box, and the transformed sphere when it's tighter
+		float boxExtent = fabsf(r[0]) * mesh.extents.x + fabsf(r[1]) * mesh.extents.y + fabsf(r[2]) * mesh.extents.z;
+		float sphereExtent = mesh.radius * sqrtf(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+		extents[i] = (mesh.radius > 0.0f) ? min(boxExtent, sphereExtent) : boxExtent;
+	}
+
+	UpdateObjectBounds(_index, BoundingBox(XMFLOAT3(center), XMFLOAT3(extents)));
+}
+
 void ShadowMap::SetObjTextureIndex(int _index, int _val)
 {
-	if (_index >= 0 && _index < (int)shadowObjTextureIndex.size())
+	if (_index < 0)
+	{
+		return;
+	}
+
+	// the shadow thread may be growing the registry, the change waits in the caster ops
+	lock_guard<mutex> lock(casterMutex);
+	CasterOp op = {};
+	op.type = CasterOp_TexIndex;
+	op.slot = _index;
+	op.texIndex = _val;
+	casterOps.push_back(op);
+}
+
+void ShadowMap::SetObjectBounds(int _index, XMFLOAT3 _center, XMFLOAT3 _extents)
+{
+	// bounds, bvh, grid and temporal state belong to the shadow thread, it applies these with the snapshot
+	if (_index >= 0)
+	{
+		sceneSnapshot.AddBounds(_index, _center, _extents);
+	}
+}
+
+void ShadowMap::UpdateObjectBounds(int _index, const BoundingBox &_bounds)
+{
+	if (_index >= 0 && _index < casters.bounds.Size())
+	{
+		casters.bounds.SetBounds(_index, _bounds);
+		shadowBVH.MarkDirty(_index);
+		temporalCulling.MarkDirty(_index);
+		shadowGrid.MarkDirty(_index);
+	}
+}
+
+int ShadowMap::FindOrAddMesh(D3D12_GPU_VIRTUAL_ADDRESS _vertexBuffer)
+{
+	auto it = meshLookup.find(_vertexBuffer);
+	if (it != meshLookup.end())
+	{
+		return it->second;
+	}
+
+	int mesh = (int)meshBounds.size();
+	meshBounds.push_back(MeshBounds());
+	meshLookup[_vertexBuffer] = mesh;
+
+	return mesh;
+}
+
+int ShadowMap::GetVisibleObjectCount()
+{
+	return (int)visibleObjects.size();
+}
+
+void ShadowMap::SetCullingMethod(CullingMethod _method)
+{
+	// the script sets it every frame, the shadow thread picks it up when it culls
+	requestedMethod.store(_method, memory_order_relaxed);
+}
+
+void ShadowMap::SetObjectOccluder(int _index, XMFLOAT3 _center, XMFLOAT3 _extents)
+{
+	if (_index < 0)
+	{
+		return;
+	}
+
+	// the occluder list is read by the culling, it's changed with the other caster ops
+	lock_guard<mutex> lock(casterMutex);
+	CasterOp op = {};
+	op.type = CasterOp_Occluder;
+	op.slot = _index;
+	op.bounds.center = _center;
+	op.bounds.extents = _extents;
+	casterOps.push_back(op);
+}
+
+void ShadowMap::ApplyOccluder(int _index, const XMFLOAT3 &_center, const XMFLOAT3 &_extents)
+{
+	bool remove = (_extents.x <= 0.0f || _extents.y <= 0.0f || _extents.z <= 0.0f);
+
+	for (int i = 0; i < (int)occluderObjects.size(); i++)
+	{
+		if (occluderObjects[i] == _index)
+		{
+			if (remove)
+			{
+				occluderObjects.erase(occluderObjects.begin() + i);
+				occluderBounds.erase(occluderBounds.begin() + i);
+			}
+			else
+			{
+				occluderBounds[i] = BoundingBox(_center, _extents);
+			}
+			return;
+		}
+	}
+
+	if (!remove)
+	{
+		occluderObjects.push_back(_index);
+		occluderBounds.push_back(BoundingBox(_center, _extents));
+	}
+}
+
+void ShadowMap::SetOcclusionCulling(bool _enable)
+{
+	useOcclusion.store(_enable, memory_order_relaxed);
+}
+
+int ShadowMap::AddCaster(D3D12_VERTEX_BUFFER_VIEW _vbv, D3D12_INDEX_BUFFER_VIEW _ibv, const TransformRecord &_transform, int _texIndex)
+{
+	// before the resources exist casters are sent with AddMesh()
+	if (!castersCreated)
+	{
+		return -1;
+	}
+
+	lock_guard<mutex> lock(casterMutex);
+	int handle = casterSlots.Allocate();
+	if (handle < 0)
+	{
+		return -1;
+	}
+
+	CasterOp op = {};
+	op.type = CasterOp_Add;
+	op.slot = casterSlots.GetIndex(handle);
+	op.vbv = _vbv;
+	op.ibv = _ibv;
+	op.transform = _transform;
+	op.texIndex = _texIndex;
+	casterOps.push_back(op);
+
+	return handle;
+}
+
+void ShadowMap::RemoveCaster(int _handle)
+{
+	lock_guard<mutex> lock(casterMutex);
+	int slot = casterSlots.GetIndex(_handle);
+	if (slot < 0)
+	{
+		return;
+	}
+	casterSlots.Free(_handle);
+
+	CasterOp op = {};
+	op.type = CasterOp_Remove;
+	op.slot = slot;
+	casterOps.push_back(op);
+}
+
+void ShadowMap::UpdateCaster(int _handle, const TransformRecord &_transform, int _texIndex)
+{
+	lock_guard<mutex> lock(casterMutex);
+	int slot = casterSlots.GetIndex(_handle);
+	if (slot < 0)
+	{
+		return;
+	}
+
+	CasterOp op = {};
+	op.type = CasterOp_Update;
+	op.slot = slot;
+	op.transform = _transform;
+	op.texIndex = _texIndex;
+	casterOps.push_back(op);
+}
+
+void ShadowMap::ApplyCasterChanges()
+{
+	// the main thread only ever waits for this swap
+	{
+		lock_guard<mutex> lock(casterMutex);
+		if (casterOps.empty())
+		{
+			return;
+		}
+		appliedOps.swap(casterOps);
+	}
+
+	// only adds bring new slots, occluder and texture ops may name any object and are checked below
+	int required = casters.Size();
+	for (int i = 0; i < (int)appliedOps.size(); i++)
+	{
+		if (appliedOps[i].type == CasterOp_Add)
+		{
+			required = max(required, appliedOps[i].slot + 1);
+		}
+	}
+
+	if (required > casters.Size())
+	{
+		GrowCasters(required);
+	}
+
+	// in queue order, a slot may be freed and handed out again within one batch
+	const BYTE allFrames = (1 << NumOfFrameResources) - 1;
+	changedCasters.clear();
+	for (int i = 0; i < (int)appliedOps.size(); i++)
+	{
+		const CasterOp &op = appliedOps[i];
+		int slot = op.slot;
+
+		if (op.type == CasterOp_MeshBounds)
+		{
+			meshBounds[FindOrAddMesh(op.vbv.BufferLocation)] = op.bounds;
+			continue;
+		}
+
+		if (op.type == CasterOp_Occluder)
+		{
+			if (slot < casters.Size())
+			{
+				ApplyOccluder(slot, op.bounds.center, op.bounds.extents);
+			}
+			continue;
+		}
+
+		if (op.type == CasterOp_TexIndex)
+		{
+			if (slot < casters.Size() && casters.texIndex[slot] != op.texIndex)
+			{
+				casters.texIndex[slot] = op.texIndex;
+				changedCasters.push_back(slot);
+			}
+			continue;
+		}
+
+		if (op.type == CasterOp_Remove)
+		{
+			// a freed slot must not keep its occluder
+			ApplyOccluder(slot, XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+			casters.flags[slot] &= ~CasterFlag_Alive;
+			liveCasters--;
+			bundleDirty = allFrames;
+			continue;
+		}
+
+		if (op.type == CasterOp_Add)
+		{
+			casters.draws[slot].vbv = op.vbv;
+			casters.draws[slot].ibv = op.ibv;
+			casters.mesh[slot] = FindOrAddMesh(op.vbv.BufferLocation);
+			casters.flags[slot] |= CasterFlag_Alive;
+			liveCasters++;
+			bundleDirty = allFrames;
+
+			// bounds of the previous owner mean nothing, stay unculled until the mesh bounds are known
+			UpdateObjectBounds(slot, InfiniteBounds);
+		}
+
+		const TransformRecord &t = op.transform;
+		ComposeTransposedTRS(&t.position.x, &t.scale.x, &t.rotation.x, 1, &casters.world[slot]);
+		casters.texIndex[slot] = op.texIndex;
+		UpdateTransformBounds(slot);
+		changedCasters.push_back(slot);
+	}
+	appliedOps.clear();
+
+	lock_guard<mutex> lock(dirtyMutex);
+	for (int i = 0; i < (int)changedCasters.size(); i++)
+	{
+		int idx = changedCasters[i];
+		if (!pendingFlag[idx])
+		{
+			pendingFlag[idx] = true;
+			pendingDirty.push_back(idx);
+		}
+	}
+}
+
+void ShadowMap::GrowCasters(int _required)
+{
+	// doubling keeps a stream of adds from reallocating every frame
+	int capacity = max(_required, casters.Size() * 2);
+
+	// culling structures see the new bounds size and build once
+	casters.Resize(capacity);
+
+	lock_guard<mutex> lock(dirtyMutex);
+	pendingFlag.resize(capacity, false);
+}
+
+bool ShadowMap::GrowFrameBuffers(int _frameIndex)
+{
+	int capacity = casters.Size();
+	if (capacity <= frameCapacity[_frameIndex])
+	{
+		return true;
+	}
+
+	// the fence of this frame resource is done, its old buffers can go right away
+	if (!CreateObjectBuffers(_frameIndex, capacity))
+	{
+		return false;
+	}
+
+	shadowIndirectBuffer[_frameIndex] = make_unique<DefaultBuffer<ShadowIndirect>>();
+	if (!shadowIndirectBuffer[_frameIndex]->Init(device, (UINT)capacity, D3D12_RESOURCE_STATE_COPY_DEST))
+	{
+		return false;
+	}
+	indirectFresh[_frameIndex] = true;
+
+	// new buffers hold nothing, every live object goes up again for this frame resource
+	const BYTE frameBit = 1 << _frameIndex;
+	for (int i = 0; i < capacity; i++)
+	{
+		BYTE &flags = casters.flags[i];
+		if ((flags & CasterFlag_Alive) == 0)
+		{
+			continue;
+		}
+
+		if ((flags & CasterFlag_DirtyFrames) == 0)
+		{
+			uploadList.push_back(i);
+		}
+		flags |= frameBit;
+	}
+	bundleDirty |= frameBit;
+
+	return true;
+}
+
+void ShadowMap::SetContributionCulling(float _minTexels)
+{
+	minContribution.store(_minTexels, memory_order_relaxed);
+}
+
+CullingStats ShadowMap::GetCullingStats()
+{
+	lock_guard<mutex> lock(statsMutex);
+	return publishedStats;
+}
+
+void ShadowMap::CullShadowObjects()
+{
+	// test world bounds against the light volume, only visible objects will be drawn
+	// view state of the last snapshot taken, it can't change under the culling
+	const SceneSnapshot &scene = sceneSnapshot.GetReadBuffer();
+	shadowCulling.SetFrustum(scene.shadowTransform);
+	int tested = casters.bounds.Size();
+
+	// main thread settings, read once so the whole cull sees the same values
+	CullingMethod method = (CullingMethod)requestedMethod.load(memory_order_relaxed);
+	bool occlusion = useOcclusion.load(memory_order_relaxed);
+	float minTexels = minContribution.load(memory_order_relaxed);
+	if (method != cullingMethod)
+	{
+		// visibility kept by the temporal method is stale once another method ran
+		temporalCulling.Reset();
+		cullingMethod = method;
+	}
+
+	if (cullingMethod == CullingMethod_BVH)
+	{
+		// builds on first use, moved objects are refitted
+		shadowBVH.Update(casters.bounds);
+		shadowBVH.Cull(shadowCulling.GetFrustum(), casters.bounds, visibleObjects);
+	}
+	else if (cullingMethod == CullingMethod_Grid)
+	{
+		// movers switch cells in place, whole cells are rejected before their objects
+		shadowGrid.Update(casters.bounds);
+		shadowGrid.Cull(shadowCulling.GetFrustum(), casters.bounds, visibleObjects);
+	}
+	else if (cullingMethod == CullingMethod_Temporal)
+	{
+		// only moved objects and objects near moving planes are tested again
+		tested = temporalCulling.Cull(shadowCulling.GetFrustum(), casters.bounds, visibleObjects);
+	}
+	else
+	{
+		// every chunk culls into its own list, merged afterwards without any locking
+		int count = casters.bounds.Size();
+		int numChunks = (count + CullChunkSize - 1) / CullChunkSize;
+		if ((int)cullChunks.size() < numChunks)
+		{
+			cullChunks.resize(numChunks);
+			cullChunkCount.resize(numChunks);
+		}
+
+		ParallelFor(count, CullChunkSize, [this](int _begin, int _end, int _chunk)
+		{
+			vector<int> &chunkVisible = cullChunks[_chunk];
+			chunkVisible.resize(_end - _begin + 8);
+			cullChunkCount[_chunk] = shadowCulling.CullRange(casters.bounds, _begin, _end, chunkVisible.data());
+		});
+
+		int visibleCount = 0;
+		for (int i = 0; i < numChunks; i++)
+		{
+			visibleCount += cullChunkCount[i];
+		}
+
+		visibleObjects.resize(visibleCount);
+		int offset = 0;
+		for (int i = 0; i < numChunks; i++)
+		{
+			if (cullChunkCount[i] > 0)
+			{
+				memcpy(visibleObjects.data() + offset, cullChunks[i].data(), sizeof(int) * cullChunkCount[i]);
+				offset += cullChunkCount[i];
+			}
+		}
+	}
+
+	// free slots keep their place in the bounds store, they are dropped here
+	if (liveCasters < casters.bounds.Size())
+	{
+		visibleObjects.erase(remove_if(visibleObjects.begin(), visibleObjects.end(), [this](int i) { return !casters.IsAlive(i); }), visibleObjects.end());
+	}
+
+	CullingStats stats;
+	stats.totalObjects = liveCasters;
+	stats.frustumVisible = (int)visibleObjects.size();
+	stats.tested = tested;
+
+	// casters whose shadow can't reach the camera frustum
+	if (scene.useReceiverCulling)
 	{
-		shadowObjTextureIndex[_index] = _val;
+		shadowCulling.SetReceiverVolume(scene.cameraCorners);
+		stats.receiverCulled = shadowCulling.CullReceivers(casters.bounds, visibleObjects);
 	}
+
+	// tiny casters, it's the cheapest test
+	if (minTexels > 0.0f)
+	{
+		stats.smallCulled = shadowCulling.CullSmall(casters.bounds, minTexels, visibleObjects);
+	}
+
+	if (occlusion && !occluderBounds.empty())
+	{
+		// rasterize occluders from the light's view, then drop casters hidden behind them
+		shadowOcclusion.SetViewProj(scene.shadowTransform);
+		shadowOcclusion.Clear();
+		for (int i = 0; i < (int)occluderBounds.size(); i++)
+		{
+			shadowOcclusion.RenderOccluder(occluderBounds[i]);
+		}
+		shadowOcclusion.BuildHiZ();
+
+		stats.occluded = shadowOcclusion.Filter(casters.bounds, visibleObjects);
+	}
+
+	stats.drawn = (int)visibleObjects.size();
+	stats.uploaded = cullingStats.uploaded;
+	stats.objectDataKB = cullingStats.objectDataKB;
+	cullingStats = stats;
 }
 
 void ShadowMap::UpdateConstantBuffer(int _frameIndex)
 {
-	for (int i = 0; i < (int)shadowObjectMatrix.size(); i++)
+	const BYTE frameBit = 1 << _frameIndex;
+
+	// first thing of a frame, the fence of this frame resource was waited in ToNextFrame()
+	uploadRing[_frameIndex].Reset();
+
+	size_t listed = uploadList.size();
+	if (!GrowFrameBuffers(_frameIndex))
+	{
+		return;
+	}
+
+	// pick up changes from main thread, each of them is stale in every frame resource
+	{
+		lock_guard<mutex> lock(dirtyMutex);
+		for (int i = 0; i < (int)pendingDirty.size(); i++)
+		{
+			int obj = pendingDirty[i];
+			pendingFlag[obj] = false;
+
+			if ((casters.flags[obj] & CasterFlag_DirtyFrames) == 0)
+			{
+				uploadList.push_back(obj);
+			}
+			casters.flags[obj] |= CasterFlag_DirtyFrames;
+		}
+		pendingDirty.clear();
+	}
+
+	// transforms from the scene snapshot, only the shadow thread touches this list
+	for (int i = 0; i < (int)sceneDirty.size(); i++)
+	{
+		int obj = sceneDirty[i];
+		if ((casters.flags[obj] & CasterFlag_DirtyFrames) == 0)
+		{
+			uploadList.push_back(obj);
+		}
+		casters.flags[obj] |= CasterFlag_DirtyFrames;
+	}
+	sceneDirty.clear();
+
+	// ascending slots let neighbouring objects leave as one run
+	if (uploadList.size() != listed)
+	{
+		sort(uploadList.begin(), uploadList.end());
+	}
+
+	// new sectors are only created here, the packing jobs just read the table
+	if (objectLayout == ObjectDataLayout_Quantized)
+	{
+		for (int i = 0; i < (int)uploadList.size(); i++)
+		{
+			int obj = uploadList[i];
+			if (casters.flags[obj] & frameBit)
+			{
+				casters.sector[obj] = (uint16_t)quantizer.FindSector(casters.world[obj]);
+			}
+		}
+	}
+
+	// objects own their slots in the upload buffer, chunks never overlap
+	ParallelFor((int)uploadList.size(), PackChunkSize, [this, _frameIndex, frameBit](int _begin, int _end, int _chunk)
+	{
+		auto slot = [this, frameBit](int i)
+		{
+			int obj = uploadList[i];
+			return (casters.flags[obj] & frameBit) ? obj : -1;
+		};
+
+		if (objectLayout == ObjectDataLayout_Structured)
+		{
+			StreamRuns(shadowObjectData[_frameIndex].get(), _begin, _end, slot, [this](int i, ObjectData &_data)
+			{
+				// last row of the transposed world is always (0, 0, 0, 1)
+				int obj = uploadList[i];
+				memcpy(&_data.World, &casters.world[obj], sizeof(XMFLOAT3X4));
+				_data.texIndex = casters.texIndex[obj];
+			});
+		}
+		else if (objectLayout == ObjectDataLayout_Quantized)
+		{
+			StreamRuns(shadowObjectQuantized[_frameIndex].get(), _begin, _end, slot, [this](int i, QuantizedTransform &_data)
+			{
+				int obj = uploadList[i];
+				quantizer.Encode(casters.world[obj], casters.sector[obj], casters.texIndex[obj], _data);
+			});
+		}
+		else
+		{
+			StreamRuns(shadowObjectCB[_frameIndex].get(), _begin, _end, slot, [this](int i, ObjectConstants &_constants)
+			{
+				int obj = uploadList[i];
+				_constants.World = casters.world[obj];
+				_constants.texIndex = casters.texIndex[obj];
+			});
+		}
+	});
+
+	// clear this frame's bit, objects up to date everywhere leave the list
+	int uploaded = 0;
+	int remaining = 0;
+	for (int i = 0; i < (int)uploadList.size(); i++)
+	{
+		int obj = uploadList[i];
+		uploaded += (casters.flags[obj] & frameBit) ? 1 : 0;
+		casters.flags[obj] &= ~frameBit;
+
+		if ((casters.flags[obj] & CasterFlag_DirtyFrames) != 0)
+		{
+			uploadList[remaining++] = obj;
+		}
+	}
+	uploadList.resize(remaining);
+	cullingStats.uploaded = uploaded;
+
+	// every counter of this frame is in, hand a copy to the main thread
+	{
+		lock_guard<mutex> lock(statsMutex);
+		publishedStats = cullingStats;
+	}
+
+	// light constants are rewritten every frame into the transient ring
+	UploadAllocation lightAlloc;
+	if (uploadRing[_frameIndex].Allocate(sizeof(LightConstants), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, lightAlloc))
 	{
-		ObjectConstants objectConstants;
-		objectConstants.World = shadowObjectMatrix[i];
-		objectConstants.texIndex = shadowObjTextureIndex[i];
-		shadowObjectCB[_frameIndex]->CopyData(i, objectConstants);
+		LightConstants lightConstants;
+		XMStoreFloat4x4(&lightConstants.ViewProj, XMLoadFloat4x4(&sceneSnapshot.GetReadBuffer().shadowTransform));
+		memcpy(lightAlloc.cpuAddress, &lightConstants, sizeof(LightConstants));
+		lightCbAddress[_frameIndex] = lightAlloc.gpuAddress;
 	}
 
-	// update to constant buffer
-	LightConstants lightConstants;
-	XMStoreFloat4x4(&lightConstants.ViewProj, XMLoadFloat4x4(&shadowTransform));
-	shadowLightCB[_frameIndex]->CopyData(0, lightConstants);
+	// sector origins are a few bytes each, the whole table goes up with them
+	const vector<XMFLOAT4> &sectors = quantizer.GetSectorOrigins();
+	UploadAllocation sectorAlloc;
+	if (objectLayout == ObjectDataLayout_Quantized && !sectors.empty()
+		&& uploadRing[_frameIndex].Allocate(sectors.size() * sizeof(XMFLOAT4), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, sectorAlloc))
+	{
+		memcpy(sectorAlloc.cpuAddress, sectors.data(), sectors.size() * sizeof(XMFLOAT4));
+		sectorAddress[_frameIndex] = sectorAlloc.gpuAddress;
+	}
 }
 
 void ShadowMap::RenderShadow(ID3D12GraphicsCommandList * _cmdList, int _frameIndex, bool _indirect, bool _useBundle)
 {
-	auto shadowHeap = CD3DX12_CPU_DESCRIPTOR_HANDLE(shadowDsvHeap->GetCPUDescriptorHandleForHeapStart(), 0, dsvDescriptorSize);
+	BeginShadow(_cmdList);
+	SetShadowState(_cmdList, _frameIndex);
 
-	// ----------------------------- set view port
-	_cmdList->RSSetViewports(1, &shadowViewport);
-	_cmdList->RSSetScissorRects(1, &shadowScissorRect);
+	// render object by record draw or indirect
+	if (!_indirect)
+	{
+		if (_useBundle)
+		{
+			// bundles hold the visible set they were recorded with. one recorded before the caster set
+			// or the visible set changed is recorded again, the fence of its last use is done
+			bool stale = (bundleDirty & (1 << _frameIndex)) != 0 || bundleObjects[_frameIndex] != visibleObjects;
+			if (!stale || RecordShadowBundle(_frameIndex))
+			{
+				_cmdList->ExecuteBundle(bundleCmdList[_frameIndex].Get());
+			}
+			else
+			{
+				RenderShadowObjects(_cmdList, _frameIndex, visibleObjects.data(), (int)visibleObjects.size());
+			}
+		}
+		else
+		{
+			RenderShadowObjects(_cmdList, _frameIndex, visibleObjects.data(), (int)visibleObjects.size());
+		}
+	}
+	else if (!RenderShadowIndirect(_cmdList, _frameIndex))
+	{
+		// no upload memory for the commands this frame, draw them one by one instead of dropping the shadows
+		RenderShadowObjects(_cmdList, _frameIndex, visibleObjects.data(), (int)visibleObjects.size());
+	}
+
+	EndShadow(_cmdList);
+}
+
+void ShadowMap::BeginShadow(ID3D12GraphicsCommandList * _cmdList)
+{
+	auto shadowHeap = CD3DX12_CPU_DESCRIPTOR_HANDLE(shadowDsvHeap->GetCPUDescriptorHandleForHeapStart(), 0, dsvDescriptorSize);
 
 	// ----------------------------- rendering shadow map
 	_cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(unityShadowResource,
@@ -122,7 +1014,15 @@ void ShadowMap::RenderShadow(ID3D12GraphicsCommandList * _cmdList, int _frameInd
 
 	_cmdList->ClearDepthStencilView(shadowHeap,
 		D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+}
 
+void ShadowMap::SetShadowState(ID3D12GraphicsCommandList * _cmdList, int _frameIndex)
+{
+	auto shadowHeap = CD3DX12_CPU_DESCRIPTOR_HANDLE(shadowDsvHeap->GetCPUDescriptorHandleForHeapStart(), 0, dsvDescriptorSize);
+
+	// ----------------------------- set view port
+	_cmdList->RSSetViewports(1, &shadowViewport);
+	_cmdList->RSSetScissorRects(1, &shadowScissorRect);
 	_cmdList->OMSetRenderTargets(0, nullptr, false, &shadowHeap);
 
 	// ----------------------------- bind pipeline state & root signature & texture heap
@@ -132,60 +1032,162 @@ void ShadowMap::RenderShadow(ID3D12GraphicsCommandList * _cmdList, int _frameInd
 	ID3D12DescriptorHeap* descriptorHeaps[] = { cutoutSrvHeap.Get() };
 	_cmdList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-	// render object by record draw or indirect
-	if (!_indirect)
+	// light constants move every frame, bundles inherit this binding instead of recording one
+	_cmdList->SetGraphicsRootConstantBufferView(1, lightCbAddress[_frameIndex]);
+	if (objectLayout == ObjectDataLayout_Quantized)
 	{
-		if (_useBundle)
-		{
-			_cmdList->ExecuteBundle(bundleCmdList[_frameIndex].Get());
-		}
-		else
-		{
-			RenderShadowObjects(_cmdList, _frameIndex);
-		}
+		_cmdList->SetGraphicsRootShaderResourceView(4, sectorAddress[_frameIndex]);
 	}
-	else
+}
+
+void ShadowMap::RenderVisibleRange(ID3D12GraphicsCommandList * _cmdList, int _frameIndex, int _begin, int _end)
+{
+	_begin = max(_begin, 0);
+	_end = min(_end, (int)visibleObjects.size());
+	if (_begin < _end)
 	{
-		RenderShadowIndirect(_cmdList, _frameIndex);
+		RenderShadowObjects(_cmdList, _frameIndex, visibleObjects.data() + _begin, _end - _begin);
 	}
+}
 
+void ShadowMap::EndShadow(ID3D12GraphicsCommandList * _cmdList)
+{
 	_cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(unityShadowResource,
 		D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_GENERIC_READ));
 }
 
-void ShadowMap::RenderShadowObjects(ID3D12GraphicsCommandList * _cmdList, int _frameIndex)
+void ShadowMap::RenderShadowObjects(ID3D12GraphicsCommandList * _cmdList, int _frameIndex, const int *_objects, int _count)
 {
 	// ------------------------------------------------------------- Draw Index
+	// light constants are bound by the caller
+	if (objectLayout != ObjectDataLayout_ConstantBuffer)
+	{
+		// one structured buffer for all objects, draws only change the index
+		_cmdList->SetGraphicsRootShaderResourceView(3, GetObjectDataAddress(_frameIndex));
+
+		for (int i = 0; i < _count; i++)
+		{
+			int idx = _objects[i];
+			_cmdList->IASetVertexBuffers(0, 1, &casters.draws[idx].vbv);
+			_cmdList->IASetIndexBuffer(&casters.draws[idx].ibv);
+			_cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+			_cmdList->SetGraphicsRoot32BitConstant(0, idx, 0);
+			_cmdList->DrawIndexedInstanced(casters.draws[idx].ibv.SizeInBytes / 4, 1, 0, 0, 0);
+		}
+		return;
+	}
+
 	UINT objCBByteSize = sizeof(ObjectConstants);
 	auto objectCB = shadowObjectCB[_frameIndex]->Resource();
-	_cmdList->SetGraphicsRootConstantBufferView(1, shadowLightCB[_frameIndex]->Resource()->GetGPUVirtualAddress());
 
-	for (int i = 0; i < (int)vertexBufferView.size(); i++)
+	for (int i = 0; i < _count; i++)
 	{
-		_cmdList->IASetVertexBuffers(0, 1, &vertexBufferView[i]);
-		_cmdList->IASetIndexBuffer(&indexBufferView[i]);
+		int idx = _objects[i];
+		_cmdList->IASetVertexBuffers(0, 1, &casters.draws[idx].vbv);
+		_cmdList->IASetIndexBuffer(&casters.draws[idx].ibv);
 		_cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + i*objCBByteSize;
+		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + idx*objCBByteSize;
 
 		_cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
-		_cmdList->DrawIndexedInstanced(indexBufferView[i].SizeInBytes / 4, 1, 0, 0, 0);
+		_cmdList->DrawIndexedInstanced(casters.draws[idx].ibv.SizeInBytes / 4, 1, 0, 0, 0);
 	}
 }
 
-void ShadowMap::RenderShadowIndirect(ID3D12GraphicsCommandList * _cmdList, int _frameIndex)
+bool ShadowMap::RenderShadowIndirect(ID3D12GraphicsCommandList * _cmdList, int _frameIndex)
 {
+	UINT visibleCount = (UINT)visibleObjects.size();
+	if (visibleCount == 0)
+	{
+		return true;
+	}
+
+	// ------------------------------------------------------------- Compact visible commands
+	// visible commands are built from the registry straight into this frame's transient ring
+	UploadAllocation commandAlloc;
+	if (!uploadRing[_frameIndex].Allocate(visibleCount * sizeof(ShadowIndirect), sizeof(UINT64), commandAlloc))
+	{
+		return false;
+	}
+
+	ShadowIndirect *commands = (ShadowIndirect*)commandAlloc.cpuAddress;
+	D3D12_GPU_VIRTUAL_ADDRESS lightCbv = lightCbAddress[_frameIndex];
+	D3D12_GPU_VIRTUAL_ADDRESS objectCbBase = (objectLayout == ObjectDataLayout_ConstantBuffer) ? shadowObjectCB[_frameIndex]->Resource()->GetGPUVirtualAddress() : 0;
+	ParallelFor((int)visibleCount, PackChunkSize, [this, commands, lightCbv, objectCbBase](int _begin, int _end, int _chunk)
+	{
+		StreamRuns<ShadowIndirect>([commands](int _first, const ShadowIndirect *_data, int _count)
+		{
+			StreamCopy(commands + _first, _data, sizeof(ShadowIndirect) * _count);
+		}, _begin, _end, [](int i) { return i; },
+			[this, lightCbv, objectCbBase](int i, ShadowIndirect &_command)
+		{
+			int obj = visibleObjects[i];
+			const CasterDraw &draw = casters.draws[obj];
+			if (objectCbBase != 0)
+			{
+				_command.objectCbv = objectCbBase + obj * sizeof(ObjectConstants);
+			}
+			else
+			{
+				_command.objectIndex[0] = obj;
+				_command.objectIndex[1] = 0;
+			}
+			_command.lightCbv = lightCbv;
+			_command.vbv = draw.vbv;
+			_command.ibv = draw.ibv;
+			_command.drawIndexArgus.IndexCountPerInstance = draw.ibv.SizeInBytes / 4;
+			_command.drawIndexArgus.InstanceCount = 1;
+			_command.drawIndexArgus.StartIndexLocation = 0;
+			_command.drawIndexArgus.BaseVertexLocation = 0;
+			_command.drawIndexArgus.StartInstanceLocation = 0;
+		});
+	});
+
+	ID3D12Resource *indirectBuffer = shadowIndirectBuffer[_frameIndex]->Resource();
+	if (!indirectFresh[_frameIndex])
+	{
+		_cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(indirectBuffer,
+			D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_COPY_DEST));
+	}
+	indirectFresh[_frameIndex] = false;
+	_cmdList->CopyBufferRegion(indirectBuffer, 0, commandAlloc.resource, commandAlloc.offset, visibleCount * sizeof(ShadowIndirect));
+	_cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(indirectBuffer,
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT));
+
 	// ------------------------------------------------------------- Indirect Drawing
+	if (objectLayout != ObjectDataLayout_ConstantBuffer)
+	{
+		// not part of the command signature, bound once for every command
+		_cmdList->SetGraphicsRootShaderResourceView(3, GetObjectDataAddress(_frameIndex));
+	}
+
 	_cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	_cmdList->ExecuteIndirect(shadowCmdSignature.Get(),
-		(UINT)shadowCommands[_frameIndex].size(),
-		shadowIndirectBuffer[_frameIndex]->Resource(),
+		visibleCount,
+		indirectBuffer,
 		0,
 		nullptr,
 		0
 	);
+
+	return true;
 }
 
+void ShadowMap::ParallelFor(int _count, int _chunkSize, const function<void(int, int, int)> &_func)
+{
+	if (jobSystem != nullptr)
+	{
+		jobSystem->ParallelFor(_count, _chunkSize, _func);
+		return;
+	}
+
+	for (int begin = 0, chunk = 0; begin < _count; begin += _chunkSize, chunk++)
+	{
+		_func(begin, min(begin + _chunkSize, _count), chunk);
+	}
+}
+
 bool ShadowMap::CreateShadowDsv(ID3D12Resource *_unityResource)
 {
 	unityShadowResource = _unityResource;
@@ -207,6 +1209,7 @@ bool ShadowMap::CreateShadowDsv(ID3D12Resource *_unityResource)
 	shadowClearValue.DepthStencil.Stencil = 0;
 
 	shadowViewport = { 0.0f, 0.0f, (float)desc.Width, (float)desc.Height, 0.0f, 1.0f };
+	shadowCulling.SetMapSize((float)desc.Width, (float)desc.Height);
 	shadowScissorRect = { 0, 0, (int)desc.Width, (int)desc.Height };
 
 	// create depth stencil view heap
@@ -238,8 +1241,24 @@ bool ShadowMap::CreateShadowDsv(ID3D12Resource *_unityResource)
 
 bool ShadowMap::CreateRootSignature()
 {
-	CD3DX12_ROOT_PARAMETER slotRootParameter[3];
-	slotRootParameter[0].InitAsConstantBufferView(0);		// register b0
+	CD3DX12_ROOT_PARAMETER slotRootParameter[5];
+	UINT numParameters = 3;
+	if (objectLayout == ObjectDataLayout_ConstantBuffer)
+	{
+		slotRootParameter[0].InitAsConstantBufferView(0);		// register b0
+	}
+	else
+	{
+		slotRootParameter[0].InitAsConstants(2, 0);			// register b0, object index (2 values to keep indirect args 8-byte aligned)
+		slotRootParameter[3].InitAsShaderResourceView(0, 1);	// register t0 space1, object data
+		numParameters = 4;
+
+		if (objectLayout == ObjectDataLayout_Quantized)
+		{
+			slotRootParameter[4].InitAsShaderResourceView(1, 1);	// register t1 space1, sector origins
+			numParameters = 5;
+		}
+	}
 	slotRootParameter[1].InitAsConstantBufferView(1);		// register b1
 
 	CD3DX12_DESCRIPTOR_RANGE texTable;						// srv table for textures
@@ -257,7 +1276,7 @@ bool ShadowMap::CreateRootSignature()
 		16);
 
 
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(3, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(numParameters, slotRootParameter,
 		1, &anisotropicWrap,
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -295,14 +1314,27 @@ bool ShadowMap::CreatePSOs()
 		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
 	};
 
+	// structured layouts read object data by index instead of a per-draw cbuffer
+	D3D_SHADER_MACRO structuredDefines[] = { { "STRUCTURED_OBJECT_DATA", "1" }, { nullptr, nullptr } };
+	D3D_SHADER_MACRO quantizedDefines[] = { { "STRUCTURED_OBJECT_DATA", "1" }, { "QUANTIZED_OBJECT_DATA", "1" }, { nullptr, nullptr } };
+	const D3D_SHADER_MACRO *defines = nullptr;
+	if (objectLayout == ObjectDataLayout_Structured)
+	{
+		defines = structuredDefines;
+	}
+	else if (objectLayout == ObjectDataLayout_Quantized)
+	{
+		defines = quantizedDefines;
+	}
+
 	// complie vertex shader
-	if (FAILED(D3DCompileFromFile(L"Assets//Shaders//AsyncShadow.hlsl", nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VS", "vs_5_1", 0, 0, &shadowVS, nullptr)))
+	if (FAILED(D3DCompileFromFile(L"Assets//Shaders//AsyncShadow.hlsl", defines, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VS", "vs_5_1", 0, 0, &shadowVS, nullptr)))
 	{
 		return false;
 	}
 
 	// complie fragment shader
-	if (FAILED(D3DCompileFromFile(L"Assets//Shaders//AsyncShadow.hlsl", nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PS", "ps_5_1", 0, 0, &shadowPS, nullptr)))
+	if (FAILED(D3DCompileFromFile(L"Assets//Shaders//AsyncShadow.hlsl", defines, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PS", "ps_5_1", 0, 0, &shadowPS, nullptr)))
 	{
 		return false;
 	}
@@ -342,35 +1374,104 @@ bool ShadowMap::CreatePSOs()
 	return true;
 }
 
+bool ShadowMap::CreateObjectBuffers(int _frameIndex, int _capacity)
+{
+	// a scene may start without casters, buffers can't be empty
+	UINT elementCount = (UINT)max(_capacity, 1);
+
+	bool result = true;
+	UINT elementSize = 0;
+	if (objectLayout == ObjectDataLayout_Structured)
+	{
+		shadowObjectData[_frameIndex] = make_unique<UploadBuffer<ObjectData>>();
+		result = shadowObjectData[_frameIndex]->Init(device, elementCount, false);
+		elementSize = sizeof(ObjectData);
+	}
+	else if (objectLayout == ObjectDataLayout_Quantized)
+	{
+		shadowObjectQuantized[_frameIndex] = make_unique<UploadBuffer<QuantizedTransform>>();
+		result = shadowObjectQuantized[_frameIndex]->Init(device, elementCount, false);
+		elementSize = sizeof(QuantizedTransform);
+	}
+	else
+	{
+		shadowObjectCB[_frameIndex] = make_unique<UploadBuffer<ObjectConstants>>();
+		result = shadowObjectCB[_frameIndex]->Init(device, elementCount, true);
+		elementSize = sizeof(ObjectConstants);
+	}
+
+	frameCapacity[_frameIndex] = result ? (int)elementCount : 0;
+
+	// what the layout costs, summed over every frame resource
+	UINT64 totalBytes = 0;
+	for (int i = 0; i < NumOfFrameResources; i++)
+	{
+		totalBytes += (UINT64)frameCapacity[i] * elementSize;
+	}
+	cullingStats.objectDataKB = (int)(totalBytes / 1024);
+
+	return result;
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS ShadowMap::GetObjectDataAddress(int _frameIndex)
+{
+	if (objectLayout == ObjectDataLayout_Quantized)
+	{
+		return shadowObjectQuantized[_frameIndex]->Resource()->GetGPUVirtualAddress();
+	}
+
+	return shadowObjectData[_frameIndex]->Resource()->GetGPUVirtualAddress();
+}
+
 bool ShadowMap::CreateConstantBuffers()
 {
-	if ((int)vertexBufferView.size() != 0)
-	{
-		bool result = true;
-		for (int i = 0; i < NumOfFrameResources; i++)
-		{
-			shadowObjectCB[i] = make_unique<UploadBuffer<ObjectConstants>>();
-			result = shadowObjectCB[i]->Init(device, (UINT)vertexBufferView.size(), true);
-			if (!result)
-			{
-				return false;
-			}
+	bool result = true;
+	for (int i = 0; i < NumOfFrameResources; i++)
+	{
+		if (!CreateObjectBuffers(i, casters.Size()))
+		{
+			return false;
+		}
+
+		// enough for the light constants and every command visible, it grows if a frame ever needs more
+		result = uploadRing[i].Init(device, sizeof(LightConstants) + casters.Size() * sizeof(ShadowIndirect));
+		if (!result)
+		{
+			return false;
+		}
+	}
+
+	// views and meshes came in with AddMesh(), the other columns catch up
+	casters.Resize(casters.Size());
 
-			shadowLightCB[i] = make_unique<UploadBuffer<LightConstants>>();
-			result = shadowLightCB[i]->Init(device, 1, true);
-			if (!result)
-			{
-				return false;
-			}
-		}
+	if (useTransformArena && !transformArena.Init(casters.Size()))
+	{
+		return false;
+	}
 
-		shadowObjectMatrix.resize(vertexBufferView.size());
-		shadowObjTextureIndex.resize(vertexBufferView.size());
+	// upload buffers start with garbage, everything goes up once per frame resource
+	pendingDirty.clear();
+	pendingFlag.assign(casters.Size(), false);
+	casters.flags.assign(casters.Size(), CasterFlag_Alive | CasterFlag_DirtyFrames);
+	uploadList.resize(casters.Size());
+	for (int i = 0; i < casters.Size(); i++)
+	{
+		uploadList[i] = i;
+	}
 
-		return true;
+	// unknown bounds never get culled until SetObjectBounds() is called
+	visibleObjects.reserve(casters.Size());
+	for (int i = 0; i < casters.Size(); i++)
+	{
+		visibleObjects.push_back(i);
 	}
 
-	return false;
+	// casters sent so far take the first slots, their handles are their indices
+	casterSlots.Reset(casters.Size());
+	liveCasters = casters.Size();
+	castersCreated = true;
+
+	return true;
 }
 
 bool ShadowMap::CreateSrv()
@@ -427,8 +1528,18 @@ bool ShadowMap::CreateIndirectBuffer(ComPtr<ID3D12GraphicsCommandList> *_cmdList
 {
 	// -------------------------------------------------------------------------- create command signature here
 	D3D12_INDIRECT_ARGUMENT_DESC shadowIndirectDesc[5] = {};
-	shadowIndirectDesc[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT_BUFFER_VIEW;
-	shadowIndirectDesc[0].ConstantBufferView.RootParameterIndex = 0;
+	if (objectLayout != ObjectDataLayout_ConstantBuffer)
+	{
+		shadowIndirectDesc[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+		shadowIndirectDesc[0].Constant.RootParameterIndex = 0;
+		shadowIndirectDesc[0].Constant.DestOffsetIn32BitValues = 0;
+		shadowIndirectDesc[0].Constant.Num32BitValuesToSet = 2;
+	}
+	else
+	{
+		shadowIndirectDesc[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT_BUFFER_VIEW;
+		shadowIndirectDesc[0].ConstantBufferView.RootParameterIndex = 0;
+	}
 	shadowIndirectDesc[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT_BUFFER_VIEW;
 	shadowIndirectDesc[1].ConstantBufferView.RootParameterIndex = 1;
 	shadowIndirectDesc[2].Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW;
@@ -450,21 +1561,13 @@ bool ShadowMap::CreateIndirectBuffer(ComPtr<ID3D12GraphicsCommandList> *_cmdList
 	for (int i = 0; i < NumOfFrameResources; i++)
 	{
 		shadowIndirectBuffer[i] = make_unique<DefaultBuffer<ShadowIndirect>>();
-		if (!shadowIndirectBuffer[i]->Init(device, (UINT)vertexBufferView.size(), D3D12_RESOURCE_STATE_COPY_DEST))
+		if (!shadowIndirectBuffer[i]->Init(device, (UINT)frameCapacity[i], D3D12_RESOURCE_STATE_COPY_DEST))
 		{
 			return false;
 		}
-
-		shadowIndirectUploader[i] = make_unique<UploadBuffer<ShadowIndirect>>();
-		if(!shadowIndirectUploader[i]->Init(device, (UINT)vertexBufferView.size(), false))
-		{
-			return false;
-		}
 	}
 
 	// -------------------------------------------------------------------------- create indirect drawing data
-	UINT objCBByteSize = sizeof(ObjectConstants);
-
 	for (int i = 0; i < NumOfFrameResources; i++)
 	{
 		if (FAILED(_cmdLists[i]->Reset(_cmdAllocs[i].Get(), nullptr)))
@@ -472,30 +1575,7 @@ bool ShadowMap::CreateIndirectBuffer(ComPtr<ID3D12GraphicsCommandList> *_cmdList
 			return false;
 		}
 
-		for (int j = 0; j < (int)vertexBufferView.size(); j++)
-		{
-			ShadowIndirect si;
-
-			si.objectCbv = shadowObjectCB[i]->Resource()->GetGPUVirtualAddress() + j * objCBByteSize;
-			si.lightCbv = shadowLightCB[i]->Resource()->GetGPUVirtualAddress();
-			si.vbv = vertexBufferView[j];
-			si.ibv = indexBufferView[j];
-			si.drawIndexArgus.BaseVertexLocation = 0;
-			si.drawIndexArgus.StartIndexLocation = 0;
-			si.drawIndexArgus.StartInstanceLocation = 0;
-			si.drawIndexArgus.InstanceCount = 1;
-			si.drawIndexArgus.IndexCountPerInstance = indexBufferView[j].SizeInBytes / 4;
-
-			shadowCommands[i].push_back(si);
-		}
-
-		// copy data by uploader
-		D3D12_SUBRESOURCE_DATA commandData = {};
-		commandData.pData = shadowCommands[i].data();
-		commandData.RowPitch = sizeof(ShadowIndirect) * (UINT)vertexBufferView.size();
-		commandData.SlicePitch = commandData.RowPitch;
-
-		UpdateSubresources<1>(_cmdLists[i].Get(), shadowIndirectBuffer[i]->Resource(), shadowIndirectUploader[i]->Resource(), 0, 0, 1, &commandData);
+		// nothing to upload here, visible commands are built and copied in every frame before the draw
 		_cmdLists[i]->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(shadowIndirectBuffer[i]->Resource(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT));
 
 		if (FAILED(_cmdLists[i]->Close()))
@@ -521,12 +1601,8 @@ bool ShadowMap::CreateShadowBundle()
 			return false;
 		}
 
-		// ---------------------------------- record bundles
-		bundleCmdList[i]->SetGraphicsRootSignature(shadowRS.Get());		// record root signature so that bundle can inherit state from caller command list
-		bundleCmdList[i]->SetPipelineState(shadowPSO.Get());			// inheriting didn't contain pso state, we must record to bundle
-		RenderShadowObjects(bundleCmdList[i].Get(), i);
-
-		if (FAILED(bundleCmdList[i]->Close()))
+		// lists are created open, recording starts from a reset allocator
+		if (FAILED(bundleCmdList[i]->Close()) || !RecordShadowBundle(i))
 		{
 			return false;
 		}
@@ -534,3 +1610,28 @@ bool ShadowMap::CreateShadowBundle()
 
 	return true;
 }
+
+bool ShadowMap::RecordShadowBundle(int _frameIndex)
+{
+	if (FAILED(bundleCmdAlloc[_frameIndex]->Reset())
+		|| FAILED(bundleCmdList[_frameIndex]->Reset(bundleCmdAlloc[_frameIndex].Get(), nullptr)))
+	{
+		return false;
+	}
+
+	// ---------------------------------- record bundles
+	bundleCmdList[_frameIndex]->SetGraphicsRootSignature(shadowRS.Get());		// record root signature so that bundle can inherit state from caller command list
+	bundleCmdList[_frameIndex]->SetPipelineState(shadowPSO.Get());			// inheriting didn't contain pso state, we must record to bundle
+
+	// only what survived culling, free slots are already left out
+	RenderShadowObjects(bundleCmdList[_frameIndex].Get(), _frameIndex, visibleObjects.data(), (int)visibleObjects.size());
+
+	if (FAILED(bundleCmdList[_frameIndex]->Close()))
+	{
+		return false;
+	}
+
+	bundleObjects[_frameIndex] = visibleObjects;
+	bundleDirty &= ~(1 << _frameIndex);
+	return true;
+}
@@ -24,6 +24,20 @@
 #include "stdafx.h"
 #include "UploadBuffer.h"
 #include "DefaultBuffer.h"
+#include "ShadowCulling.h"
+#include "ShadowBVH.h"
+#include "ShadowTemporal.h"
+#include "ShadowGrid.h"
+#include "ShadowOcclusion.h"
+#include "ShadowTransform.h"
+#include "TransformArena.h"
+#include "SceneSnapshot.h"
+#include "UploadRing.h"
+#include "SlotMap.h"
+#include "ShadowQuantize.h"
+#include "CasterRegistry.h"
+#include "JobSystem.h"
+#include <unordered_map>
 
 struct ObjectConstants
 {
@@ -32,6 +46,14 @@ struct ObjectConstants
 	float padding[47];		// padding to 256 bytes
 };
 
+// tightly packed per-object data for the structured buffer layout, first three rows of the transposed world
+struct ObjectData
+{
+	XMFLOAT3X4 World;
+	UINT texIndex = -1;
+};
+static_assert(sizeof(ObjectData) == 52, "ObjectData must stay tightly packed");
+
 struct LightConstants
 {
 	XMFLOAT4X4 ViewProj = Identity4x4;
@@ -39,6 +61,46 @@ struct LightConstants
 };
 
 const int MaxTexture = 16;
+const int CullChunkSize = 4096;		// multiple of 8 for the avx kernel
+const int PackChunkSize = 1024;
+
+struct CullingStats
+{
+	int totalObjects = 0;
+	int frustumVisible = 0;
+	int smallCulled = 0;
+	int occluded = 0;
+	int drawn = 0;
+	int tested = 0;			// objects actually tested against the light volume
+	int receiverCulled = 0;
+	int uploaded = 0;		// object constants written this frame
+	int objectDataKB = 0;	// per object data held by all frame resources
+};
+
+// local space bounds of a unique mesh, shared by every object drawing it
+struct MeshBounds
+{
+	XMFLOAT3 center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	XMFLOAT3 extents = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	float radius = 0.0f;				// sphere around center, 0 if unknown
+	bool valid = false;
+};
+
+// how per-object data reaches the shader, fixed once shadow resources are created
+enum ObjectDataLayout
+{
+	ObjectDataLayout_ConstantBuffer = 0,	// 256-byte cbv per draw
+	ObjectDataLayout_Structured,			// 52-byte entries in a structured buffer, indexed by a root constant
+	ObjectDataLayout_Quantized				// 20-byte QuantizedTransform entries, indexed the same way. meant for static casters
+};
+
+enum CullingMethod
+{
+	CullingMethod_Linear = 0,
+	CullingMethod_BVH,
+	CullingMethod_Temporal,
+	CullingMethod_Grid
+};
 
 class ShadowMap
 {
@@ -46,15 +108,58 @@ public:
 	ShadowMap(ID3D12Device *_device);
 	~ShadowMap();
 
+	void SetJobSystem(JobSystem *_jobSystem);
+	void SetObjectDataLayout(ObjectDataLayout _layout);
+	void SetTransformArena(bool _enable);
+
 	void AddMesh(D3D12_VERTEX_BUFFER_VIEW _vbv, D3D12_INDEX_BUFFER_VIEW _ibv);
+	void SetMeshBounds(D3D12_GPU_VIRTUAL_ADDRESS _vertexBuffer, XMFLOAT3 _center, XMFLOAT3 _extents, float _radius);
 	void AddCutoutTexture(ID3D12Resource *_texture);
 	void SetShadowTransform(XMMATRIX _m);
+	void SetCameraFrustum(const XMFLOAT3 *_corners);
 	XMFLOAT4X4 GetShadowTransform();
 	void SetObjectTransform(int _index, XMMATRIX _m);
+	void SetObjectTransforms(int _first, int _count, const float *_pos, const float *_scale, const float *_rot);
+	void SetObjectTransforms(const int *_indices, int _count, const float *_pos, const float *_scale, const float *_rot);
+	void SetObjectTransforms(int _first, int _count, const TransformStreams &_streams);
+	TransformArenaHeader *GetTransformArena();
+	TransformArenaHeader *PublishTransformArena(UINT64 _sequence);
+	void ConsumeTransformArena();
+
+	// per frame handoff of view state, per-call transforms and bounds, published by the main thread and taken by the shadow thread
+	UINT64 PublishScene();
+	void ConsumeSceneSnapshot();
+
+	// texture indices and occluders are queued with the caster ops, bounds go out with the scene snapshot
 	void SetObjTextureIndex(int _index, int _val);
+	void SetObjectBounds(int _index, XMFLOAT3 _center, XMFLOAT3 _extents);
+	int GetVisibleObjectCount();
+	void SetCullingMethod(CullingMethod _method);
+	void SetObjectOccluder(int _index, XMFLOAT3 _center, XMFLOAT3 _extents);
+	void SetOcclusionCulling(bool _enable);
+
+	// casters coming and going after the resources exist. a handle resolves to a stable object index,
+	// casters sent through AddMesh() have their index as handle. changes are queued here and applied on the
+	// shadow thread by ApplyCasterChanges(), each frame resource grows its buffers the next time it's used.
+	// the index based setters never resize anything, runtime casters should move through UpdateCaster().
+	int AddCaster(D3D12_VERTEX_BUFFER_VIEW _vbv, D3D12_INDEX_BUFFER_VIEW _ibv, const TransformRecord &_transform, int _texIndex);
+	void RemoveCaster(int _handle);
+	void UpdateCaster(int _handle, const TransformRecord &_transform, int _texIndex);
+	void ApplyCasterChanges();
+	void SetContributionCulling(float _minTexels);
+	CullingStats GetCullingStats();
+
+	void CullShadowObjects();
 
 	void UpdateConstantBuffer(int _frameIndex);
 	void RenderShadow(ID3D12GraphicsCommandList *_cmdList, int _frameIndex, bool _indirect, bool _useBundle);
+
+	// the same pass split over several command lists recorded in parallel, direct draws only.
+	// the first list begins, every list sets the state and draws its range of visible objects, the last one ends.
+	void BeginShadow(ID3D12GraphicsCommandList *_cmdList);
+	void SetShadowState(ID3D12GraphicsCommandList *_cmdList, int _frameIndex);
+	void RenderVisibleRange(ID3D12GraphicsCommandList *_cmdList, int _frameIndex, int _begin, int _end);
+	void EndShadow(ID3D12GraphicsCommandList *_cmdList);
 	bool CreateShadowDsv(ID3D12Resource *_unityResource);
 	bool CreateRootSignature();
 	bool CreatePSOs();
@@ -64,15 +169,31 @@ public:
 	bool CreateShadowBundle();
 
 private:
-	void RenderShadowObjects(ID3D12GraphicsCommandList *_cmdList, int _frameIndex);
-	void RenderShadowIndirect(ID3D12GraphicsCommandList * _cmdList, int _frameIndex);
+	void RenderShadowObjects(ID3D12GraphicsCommandList *_cmdList, int _frameIndex, const int *_objects, int _count);
+	bool RenderShadowIndirect(ID3D12GraphicsCommandList * _cmdList, int _frameIndex);
+	void ParallelFor(int _count, int _chunkSize, const function<void(int, int, int)> &_func);
+	int FindOrAddMesh(D3D12_GPU_VIRTUAL_ADDRESS _vertexBuffer);
+	void UpdateTransformBounds(int _index);
+	void UpdateObjectBounds(int _index, const BoundingBox &_bounds);
+	void ApplyOccluder(int _index, const XMFLOAT3 &_center, const XMFLOAT3 &_extents);
+	void GrowCasters(int _required);
+	bool GrowFrameBuffers(int _frameIndex);
+	bool CreateObjectBuffers(int _frameIndex, int _capacity);
+	D3D12_GPU_VIRTUAL_ADDRESS GetObjectDataAddress(int _frameIndex);
+	bool RecordShadowBundle(int _frameIndex);
+
+	// job system, null runs everything on the calling thread
+	JobSystem *jobSystem = nullptr;
 
 	// device cache
 	ID3D12Device *device = nullptr;
 
-	// mesh
-	vector<D3D12_VERTEX_BUFFER_VIEW> vertexBufferView;
-	vector<D3D12_INDEX_BUFFER_VIEW> indexBufferView;
+	// casters, indexed the same in every column
+	CasterRegistry casters;
+
+	// objects sharing a vertex buffer share one bounds entry
+	vector<MeshBounds> meshBounds;
+	unordered_map<D3D12_GPU_VIRTUAL_ADDRESS, int> meshLookup;
 
 	// shadow resources
 	ID3D12Resource *unityShadowResource;
@@ -97,17 +218,98 @@ private:
 
 	// object transform
 	unique_ptr<UploadBuffer<ObjectConstants>> shadowObjectCB[NumOfFrameResources];
-	vector<XMFLOAT4X4> shadowObjectMatrix;
-	vector<int> shadowObjTextureIndex;
+	unique_ptr<UploadBuffer<ObjectData>> shadowObjectData[NumOfFrameResources];
+	unique_ptr<UploadBuffer<QuantizedTransform>> shadowObjectQuantized[NumOfFrameResources];
+	ObjectDataLayout objectLayout = ObjectDataLayout_ConstantBuffer;
+	TransformArena transformArena;		// engine writes TRS records here directly when enabled
+	bool useTransformArena = false;
+	vector<int> arenaIndices;
+
+	// quantized layout, matrices stay full precision here and are encoded when they go up
+	TransformQuantizer quantizer;
+	D3D12_GPU_VIRTUAL_ADDRESS sectorAddress[NumOfFrameResources] = {};
+
+	// dirty tracking, every frame resource needs a changed object once.
+	// main thread queues changes under the lock, the shadow thread owns the caster flags.
+	mutex dirtyMutex;
+	vector<int> pendingDirty;
+	vector<bool> pendingFlag;
+	vector<int> uploadList;			// objects with any CasterFlag_DirtyFrames bit left
+	vector<int> sceneDirty;			// transforms applied from the scene snapshot this frame
+
+	// runtime casters, the main thread hands out slots and queues changes, the shadow thread applies them
+	enum CasterOpType
+	{
+		CasterOp_Add = 0,
+		CasterOp_Remove,
+		CasterOp_Update,
+		CasterOp_MeshBounds,
+		CasterOp_Occluder,
+		CasterOp_TexIndex
+	};
 
-	// shadow transform
-	unique_ptr<UploadBuffer<LightConstants>> shadowLightCB[NumOfFrameResources];
-	XMFLOAT4X4 shadowTransform = Identity4x4;
+	struct CasterOp
+	{
+		CasterOpType type;
+		int slot;
+		D3D12_VERTEX_BUFFER_VIEW vbv;		// mesh bounds are keyed by vbv.BufferLocation
+		D3D12_INDEX_BUFFER_VIEW ibv;
+		TransformRecord transform;
+		int texIndex;
+		MeshBounds bounds;					// mesh bounds, or the occluder box
+	};
+
+	mutex casterMutex;
+	SlotMap casterSlots;
+	vector<CasterOp> casterOps;
+	vector<CasterOp> appliedOps;		// swapped with casterOps, keeps both allocations alive
+	vector<int> changedCasters;
+	bool castersCreated = false;
+
+	// free slots stay in the registry so indices never move, they are just never drawn
+	int liveCasters = 0;
+	int frameCapacity[NumOfFrameResources] = {};		// objects the buffers of each frame resource hold
+
+	// culling
+	ShadowCulling shadowCulling;
+	ShadowBVH shadowBVH;
+	ShadowTemporalCulling temporalCulling;
+	ShadowGrid shadowGrid;
+	CullingMethod cullingMethod = CullingMethod_Linear;		// shadow thread only
+	atomic<int> requestedMethod;							// last method set by the main thread
+
+	// occlusion culling, the occluder list is shadow thread only and changed through CasterOp_Occluder
+	ShadowOcclusion shadowOcclusion;
+	vector<int> occluderObjects;
+	vector<BoundingBox> occluderBounds;
+	atomic<bool> useOcclusion;								// set by the main thread, read once per cull
+
+	// contribution culling, casters covering fewer texels than this are skipped. 0 disables it.
+	atomic<float> minContribution;							// set by the main thread, read once per cull
+
+	// counters are written by the shadow thread, the getter reads the copy made once a frame is complete
+	CullingStats cullingStats;
+	CullingStats publishedStats;
+	mutex statsMutex;
+	vector<int> visibleObjects;
+	vector<vector<int>> cullChunks;
+	vector<int> cullChunkCount;
+
+	// shadow transform, camera frustum for receiver culling and per-call object transforms
+	SceneSnapshotBuffer sceneSnapshot;
+
+	// per frame transient uploads: light constants and compacted indirect commands
+	UploadRing uploadRing[NumOfFrameResources];
+	D3D12_GPU_VIRTUAL_ADDRESS lightCbAddress[NumOfFrameResources] = {};
 
 	// indirect drawing
 	struct ShadowIndirect
 	{
-		D3D12_GPU_VIRTUAL_ADDRESS objectCbv;
+		union
+		{
+			D3D12_GPU_VIRTUAL_ADDRESS objectCbv;
+			UINT objectIndex[2];		// root constants for the structured layout, second one is unused
+		};
 		D3D12_GPU_VIRTUAL_ADDRESS lightCbv;
 		D3D12_VERTEX_BUFFER_VIEW vbv;
 		D3D12_INDEX_BUFFER_VIEW ibv;
@@ -116,8 +318,7 @@ private:
 
 	ComPtr<ID3D12CommandSignature> shadowCmdSignature = nullptr;
 	unique_ptr<DefaultBuffer<ShadowIndirect>> shadowIndirectBuffer[NumOfFrameResources];
-	unique_ptr<UploadBuffer<ShadowIndirect>> shadowIndirectUploader[NumOfFrameResources];
-	vector<ShadowIndirect> shadowCommands[NumOfFrameResources];
+	bool indirectFresh[NumOfFrameResources] = {};		// reallocated, still in copy dest state
 
 	// texture resource (for cutout)
 	vector<ID3D12Resource*> cutoutMaps;
@@ -127,4 +328,6 @@ private:
 	// rendering bundles
 	ComPtr<ID3D12CommandAllocator> bundleCmdAlloc[NumOfFrameResources];
 	ComPtr<ID3D12GraphicsCommandList> bundleCmdList[NumOfFrameResources];
+	BYTE bundleDirty = 0;		// bit per bundle recorded before the caster set changed
+	vector<int> bundleObjects[NumOfFrameResources];		// visible set each bundle was recorded with
 };
\ No newline at end of file
@@ -0,0 +1,280 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#include "ShadowOcclusion.h"
+#include <algorithm>
+#include <emmintrin.h>
+
+ShadowOcclusion::ShadowOcclusion()
+{
+	viewProj = XMFLOAT4X4(
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f);
+
+	for (int i = 0; i < OcclusionMips; i++)
+	{
+		int size = OcclusionSize >> i;
+		depthMips[i].resize(size * size, 1.0f);
+	}
+}
+
+ShadowOcclusion::~ShadowOcclusion()
+{
+	for (int i = 0; i < OcclusionMips; i++)
+	{
+		depthMips[i].clear();
+	}
+}
+
+void ShadowOcclusion::SetViewProj(const XMFLOAT4X4 &_transposedViewProj)
+{
+	viewProj = _transposedViewProj;
+}
+
+void ShadowOcclusion::Clear()
+{
+	fill(depthMips[0].begin(), depthMips[0].end(), 1.0f);
+}
+
+void ShadowOcclusion::RenderOccluder(const BoundingBox &_box)
+{
+	// ----------------------------------------------- project 8 corners to screen space
+	XMFLOAT3 corners[8];
+	for (int i = 0; i < 8; i++)
+	{
+		float x = _box.Center.x + ((i & 1) ? _box.Extents.x : -_box.Extents.x);
+		float y = _box.Center.y + ((i & 2) ? _box.Extents.y : -_box.Extents.y);
+		float z = _box.Center.z + ((i & 4) ? _box.Extents.z : -_box.Extents.z);
+
+		float cx = viewProj._11 * x + viewProj._12 * y + viewProj._13 * z + viewProj._14;
+		float cy = viewProj._21 * x + viewProj._22 * y + viewProj._23 * z + viewProj._24;
+		float cz = viewProj._31 * x + viewProj._32 * y + viewProj._33 * z + viewProj._34;
+
+		// gpu clips against near/far instead of clamping, a partly clipped occluder may not hide anything
+		if (cz < 0.0f || cz > 1.0f)
+		{
+			return;
+		}
+
+		corners[i] = XMFLOAT3((cx * 0.5f + 0.5f) * OcclusionSize, (0.5f - cy * 0.5f) * OcclusionSize, cz);
+	}
+
+	// ----------------------------------------------- 12 triangles of the box
+	static const int indices[36] =
+	{
+		0, 1, 3, 0, 3, 2,		// -z
+		4, 6, 7, 4, 7, 5,		// +z
+		0, 4, 5, 0, 5, 1,		// -y
+		2, 3, 7, 2, 7, 6,		// +y
+		0, 2, 6, 0, 6, 4,		// -x
+		1, 5, 7, 1, 7, 3		// +x
+	};
+
+	for (int i = 0; i < 36; i += 3)
+	{
+		RasterizeTriangle(corners[indices[i]], corners[indices[i + 1]], corners[indices[i + 2]]);
+	}
+}
+
+void ShadowOcclusion::RasterizeTriangle(const XMFLOAT3 &_v0, const XMFLOAT3 &_v1, const XMFLOAT3 &_v2)
+{
+	XMFLOAT3 v0 = _v0;
+	XMFLOAT3 v1 = _v1;
+	XMFLOAT3 v2 = _v2;
+
+	// make winding positive so inside test is always w >= 0
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+	if (fabsf(area) < 1e-6f)
+	{
+		return;
+	}
+
+	if (area < 0.0f)
+	{
+		swap(v1, v2);
+		area = -area;
+	}
+
+	int minX = max(0, (int)floorf(min(v0.x, min(v1.x, v2.x))));
+	int maxX = min(OcclusionSize - 1, (int)ceilf(max(v0.x, max(v1.x, v2.x))));
+	int minY = max(0, (int)floorf(min(v0.y, min(v1.y, v2.y))));
+	int maxY = min(OcclusionSize - 1, (int)ceilf(max(v0.y, max(v1.y, v2.y))));
+	if (minX > maxX || minY > maxY)
+	{
+		return;
+	}
+
+	// start on a 4 pixel boundary, width is a multiple of 4 so whole blocks never leave the row
+	minX &= ~3;
+
+	// edge functions are linear in screen space: w(p) = a * p.x + b * p.y + c
+	float a0 = v1.y - v2.y, b0 = v2.x - v1.x, c0 = v1.x * v2.y - v1.y * v2.x;
+	float a1 = v2.y - v0.y, b1 = v0.x - v2.x, c1 = v2.x * v0.y - v2.y * v0.x;
+	float a2 = v0.y - v1.y, b2 = v1.x - v0.x, c2 = v0.x * v1.y - v0.y * v1.x;
+
+	// orthographic light, depth is linear in screen space as well
+	float invArea = 1.0f / area;
+	float za = (a0 * v0.z + a1 * v1.z + a2 * v2.z) * invArea;
+	float zb = (b0 * v0.z + b1 * v1.z + b2 * v2.z) * invArea;
+	float zc = (c0 * v0.z + c1 * v1.z + c2 * v2.z) * invArea;
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 laneOffset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	__m128 maxPixel = _mm_set1_ps((float)maxX + 1.0f);
+
+	float *depth = depthMips[0].data();
+
+	for (int y = minY; y <= maxY; y++)
+	{
+		float py = (float)y + 0.5f;
+		__m128 rowW0 = _mm_set1_ps(b0 * py + c0);
+		__m128 rowW1 = _mm_set1_ps(b1 * py + c1);
+		__m128 rowW2 = _mm_set1_ps(b2 * py + c2);
+		__m128 rowZ = _mm_set1_ps(zb * py + zc);
+
+		float *row = depth + y * OcclusionSize;
+		for (int x = minX; x <= maxX; x += 4)
+		{
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffset);
+
+			__m128 w0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a0), px), rowW0);
+			__m128 w1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a1), px), rowW1);
+			__m128 w2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a2), px), rowW2);
+
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+			inside = _mm_and_ps(inside, _mm_cmplt_ps(px, maxPixel));
+			if (_mm_movemask_ps(inside) == 0)
+			{
+				continue;
+			}
+
+			__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(za), px), rowZ);
+			__m128 old = _mm_loadu_ps(row + x);
+			__m128 nearest = _mm_min_ps(old, z);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+		}
+	}
+}
+
+void ShadowOcclusion::BuildHiZ()
+{
+	// each level keeps the farthest occluder depth of its 2x2 children, so tests stay conservative
+	for (int i = 1; i < OcclusionMips; i++)
+	{
+		int size = OcclusionSize >> i;
+		int srcSize = size * 2;
+		const float *src = depthMips[i - 1].data();
+		float *dst = depthMips[i].data();
+
+		for (int y = 0; y < size; y++)
+		{
+			const float *r0 = src + (y * 2) * srcSize;
+			const float *r1 = r0 + srcSize;
+			for (int x = 0; x < size; x++)
+			{
+				dst[y * size + x] = max(max(r0[x * 2], r0[x * 2 + 1]), max(r1[x * 2], r1[x * 2 + 1]));
+			}
+		}
+	}
+}
+
+bool ShadowOcclusion::TestBounds(float _cx, float _cy, float _cz, float _ex, float _ey, float _ez)
+{
+	// ----------------------------------------------- project bounds, affine for an orthographic light
+	float cx = viewProj._11 * _cx + viewProj._12 * _cy + viewProj._13 * _cz + viewProj._14;
+	float cy = viewProj._21 * _cx + viewProj._22 * _cy + viewProj._23 * _cz + viewProj._24;
+	float cz = viewProj._31 * _cx + viewProj._32 * _cy + viewProj._33 * _cz + viewProj._34;
+	float ex = fabsf(viewProj._11) * _ex + fabsf(viewProj._12) * _ey + fabsf(viewProj._13) * _ez;
+	float ey = fabsf(viewProj._21) * _ex + fabsf(viewProj._22) * _ey + fabsf(viewProj._23) * _ez;
+	float ez = fabsf(viewProj._31) * _ex + fabsf(viewProj._32) * _ey + fabsf(viewProj._33) * _ez;
+
+	float minDepth = cz - ez;
+	if (minDepth <= 0.0f)
+	{
+		return true;
+	}
+
+	// screen rect, dilated by one pixel to cover partially covered occluder edges
+	float sMinX = ((cx - ex) * 0.5f + 0.5f) * OcclusionSize - 1.0f;
+	float sMaxX = ((cx + ex) * 0.5f + 0.5f) * OcclusionSize + 1.0f;
+	float sMinY = (0.5f - (cy + ey) * 0.5f) * OcclusionSize - 1.0f;
+	float sMaxY = (0.5f - (cy - ey) * 0.5f) * OcclusionSize + 1.0f;
+
+	if (sMaxX < 0.0f || sMaxY < 0.0f || sMinX >= (float)OcclusionSize || sMinY >= (float)OcclusionSize)
+	{
+		// outside of the map, leave it to frustum culling
+		return true;
+	}
+
+	int x0 = max(0, (int)sMinX);
+	int y0 = max(0, (int)sMinY);
+	int x1 = min(OcclusionSize - 1, (int)sMaxX);
+	int y1 = min(OcclusionSize - 1, (int)sMaxY);
+
+	// pick the coarsest level where the rect only touches a few texels each way
+	int level = 0;
+	int span = max(x1 - x0, y1 - y0);
+	while (level < OcclusionMips - 1 && (span >> level) > 1)
+	{
+		level++;
+	}
+
+	int size = OcclusionSize >> level;
+	const float *mip = depthMips[level].data();
+	float maxDepth = 0.0f;
+	for (int y = (y0 >> level); y <= (y1 >> level); y++)
+	{
+		for (int x = (x0 >> level); x <= (x1 >> level); x++)
+		{
+			maxDepth = max(maxDepth, mip[y * size + x]);
+		}
+	}
+
+	return minDepth <= maxDepth;
+}
+
+int ShadowOcclusion::Filter(const ShadowBoundsStore &_bounds, vector<int> &_visible)
+{
+	int survivors = 0;
+	for (int i = 0; i < (int)_visible.size(); i++)
+	{
+		int obj = _visible[i];
+		if (TestBounds(_bounds.centerX[obj], _bounds.centerY[obj], _bounds.centerZ[obj],
+			_bounds.extentX[obj], _bounds.extentY[obj], _bounds.extentZ[obj]))
+		{
+			_visible[survivors++] = obj;
+		}
+	}
+
+	int occluded = (int)_visible.size() - survivors;
+	_visible.resize(survivors);
+
+	return occluded;
+}
+
+const float *ShadowOcclusion::GetDepth(int _mip)
+{
+	return depthMips[_mip].data();
+}
@@ -0,0 +1,55 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include "ShadowCulling.h"
+
+const int OcclusionSize = 256;
+const int OcclusionMips = 9;		// 256 down to 1
+
+// low resolution depth buffer from the light's view, occluders are rasterized on cpu and
+// casters are tested against a hierarchical max depth so hidden ones never reach the gpu
+class ShadowOcclusion
+{
+public:
+	ShadowOcclusion();
+	~ShadowOcclusion();
+
+	void SetViewProj(const XMFLOAT4X4 &_transposedViewProj);
+	void Clear();
+
+	// occluder boxes must lie inside the real geometry, otherwise visible casters get culled
+	void RenderOccluder(const BoundingBox &_box);
+	void BuildHiZ();
+
+	bool TestBounds(float _cx, float _cy, float _cz, float _ex, float _ey, float _ez);
+	int Filter(const ShadowBoundsStore &_bounds, vector<int> &_visible);
+
+	const float *GetDepth(int _mip);
+
+private:
+	void RasterizeTriangle(const XMFLOAT3 &_v0, const XMFLOAT3 &_v1, const XMFLOAT3 &_v2);
+
+	XMFLOAT4X4 viewProj;			// kept transposed, row k dotted with a point gives clip component k
+	vector<float> depthMips[OcclusionMips];
+};
@@ -0,0 +1,186 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "ShadowQuantize.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cmath>
+using namespace DirectX::PackedVector;
+
+void TransformQuantizer::SetSectorSize(float _size)
+{
+	if (sectorOrigins.empty() && _size > 0.0f)
+	{
+		sectorSize = _size;
+	}
+}
+
+float TransformQuantizer::GetSectorSize() const
+{
+	return sectorSize;
+}
+
+int TransformQuantizer::FindSector(const XMFLOAT4X4 &_world)
+{
+	// sectors tile the world on a grid, 21 bits per axis in the key
+	const float p[3] = { _world._14, _world._24, _world._34 };
+	int cell[3];
+	uint64_t key = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		cell[i] = (int)max(min(floorf(p[i] / sectorSize), 1048575.0f), -1048576.0f);
+		key |= (uint64_t)(cell[i] + 1048576) << (21 * i);
+	}
+
+	auto it = sectorLookup.find(key);
+	if (it != sectorLookup.end())
+	{
+		return it->second;
+	}
+
+	if ((int)sectorOrigins.size() >= MaxSectors)
+	{
+		return MaxSectors - 1;
+	}
+
+	int sector = (int)sectorOrigins.size();
+	sectorOrigins.push_back(XMFLOAT4(cell[0] * sectorSize, cell[1] * sectorSize, cell[2] * sectorSize, sectorSize / 65535.0f));
+	sectorLookup[key] = sector;
+
+	return sector;
+}
+
+void TransformQuantizer::Encode(const XMFLOAT4X4 &_world, int _sector, int _texIndex, QuantizedTransform &_out) const
+{
+	// the world is transposed, column j of the 3x3 is rotation axis j times scale j
+	const XMFLOAT4X4 &m = _world;
+	float axis[3][3] = { { m._11, m._21, m._31 }, { m._12, m._22, m._32 }, { m._13, m._23, m._33 } };
+
+	float scale[3];
+	for (int j = 0; j < 3; j++)
+	{
+		scale[j] = sqrtf(axis[j][0] * axis[j][0] + axis[j][1] * axis[j][1] + axis[j][2] * axis[j][2]);
+	}
+
+	float det = axis[0][0] * (axis[1][1] * axis[2][2] - axis[1][2] * axis[2][1])
+		- axis[0][1] * (axis[1][0] * axis[2][2] - axis[1][2] * axis[2][0])
+		+ axis[0][2] * (axis[1][0] * axis[2][1] - axis[1][1] * axis[2][0]);
+	if (det < 0.0f)
+	{
+		scale[0] = -scale[0];
+	}
+
+	// rotation matrix, a zero scale leaves its axis as identity
+	float r[3][3];
+	for (int j = 0; j < 3; j++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			r[i][j] = (scale[j] != 0.0f) ? axis[j][i] / scale[j] : (i == j ? 1.0f : 0.0f);
+		}
+	}
+
+	float q[4];		// x y z w
+	float trace = r[0][0] + r[1][1] + r[2][2];
+	if (trace > 0.0f)
+	{
+		float s = sqrtf(trace + 1.0f) * 2.0f;
+		q[3] = 0.25f * s;
+		q[0] = (r[2][1] - r[1][2]) / s;
+		q[1] = (r[0][2] - r[2][0]) / s;
+		q[2] = (r[1][0] - r[0][1]) / s;
+	}
+	else if (r[0][0] > r[1][1] && r[0][0] > r[2][2])
+	{
+		float s = sqrtf(1.0f + r[0][0] - r[1][1] - r[2][2]) * 2.0f;
+		q[3] = (r[2][1] - r[1][2]) / s;
+		q[0] = 0.25f * s;
+		q[1] = (r[0][1] + r[1][0]) / s;
+		q[2] = (r[0][2] + r[2][0]) / s;
+	}
+	else if (r[1][1] > r[2][2])
+	{
+		float s = sqrtf(1.0f + r[1][1] - r[0][0] - r[2][2]) * 2.0f;
+		q[3] = (r[0][2] - r[2][0]) / s;
+		q[0] = (r[0][1] + r[1][0]) / s;
+		q[1] = 0.25f * s;
+		q[2] = (r[1][2] + r[2][1]) / s;
+	}
+	else
+	{
+		float s = sqrtf(1.0f + r[2][2] - r[0][0] - r[1][1]) * 2.0f;
+		q[3] = (r[1][0] - r[0][1]) / s;
+		q[0] = (r[0][2] + r[2][0]) / s;
+		q[1] = (r[1][2] + r[2][1]) / s;
+		q[2] = 0.25f * s;
+	}
+
+	// smallest three, q and -q are the same rotation so the dropped component is made positive
+	float length = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+	int largest = 0;
+	for (int i = 1; i < 4; i++)
+	{
+		largest = (fabsf(q[i]) > fabsf(q[largest])) ? i : largest;
+	}
+	float sign = (q[largest] < 0.0f) ? -1.0f : 1.0f;
+
+	uint32_t rotation = (uint32_t)largest << 30;
+	for (int i = 0, shift = 0; i < 4; i++)
+	{
+		if (i == largest)
+		{
+			continue;
+		}
+
+		float c = q[i] * sign / length * 0.70710678f;		// [-0.5, 0.5]
+		uint32_t bits = (uint32_t)min(max(lroundf((c + 0.5f) * 1023.0f), 0L), 1023L);
+		rotation |= bits << shift;
+		shift += 10;
+	}
+
+	// offset from the sector origin in whole steps
+	const XMFLOAT4 &origin = sectorOrigins[_sector];
+	const float offset[3] = { m._14 - origin.x, m._24 - origin.y, m._34 - origin.z };
+	for (int i = 0; i < 3; i++)
+	{
+		_out.position[i] = (uint16_t)min(max(lroundf(offset[i] / origin.w), 0L), 65535L);
+		_out.scale[i] = XMConvertFloatToHalf(scale[i]);
+	}
+
+	_out.sector = (uint16_t)_sector;
+	_out.rotation = rotation;
+	_out.texIndex = (_texIndex < 0) ? 0xffff : (uint16_t)_texIndex;
+}
+
+const vector<XMFLOAT4> &TransformQuantizer::GetSectorOrigins() const
+{
+	return sectorOrigins;
+}
+
+void TransformQuantizer::Clear()
+{
+	sectorLookup.clear();
+	sectorOrigins.clear();
+}
@@ -0,0 +1,73 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+using namespace DirectX;
+using namespace std;
+
+// static caster transform in 20 bytes instead of the 52 of ObjectData or the 256 of a constant buffer.
+// position is a 16-bit fixed point offset from the origin of its sector, the error is at most half a step
+// (sector size / 65535 / 2, under 1 mm with the default 128 m sectors).
+// rotation is a smallest three quaternion: the largest component is dropped and rebuilt from the unit length,
+// the other three take 10 bits each over [-1/sqrt2, 1/sqrt2]. scale is half float.
+// the vertex shader decodes it into the same transposed world ComposeTransposedTRS() writes.
+struct QuantizedTransform
+{
+	uint16_t position[3];
+	uint16_t sector;		// index into the sector origin table
+	uint32_t rotation;		// 2-bit index of the dropped component, then 3 x 10 bits
+	uint16_t scale[3];
+	uint16_t texIndex;		// 0xffff for none
+};
+static_assert(sizeof(QuantizedTransform) == 20, "QuantizedTransform is read as uint[5] by the shader");
+
+class TransformQuantizer
+{
+public:
+	static const int MaxSectors = 65536;
+
+	// only before the first sector is created
+	void SetSectorSize(float _size);
+	float GetSectorSize() const;
+
+	// sector holding the translation of a transposed world, created when it's new.
+	// once the table is full, positions outside every sector clamp to the edge of the last one.
+	int FindSector(const XMFLOAT4X4 &_world);
+
+	// splits a transposed scale * rotation * translation world into its quantized parts.
+	// negative determinants keep the mirror in the x scale.
+	void Encode(const XMFLOAT4X4 &_world, int _sector, int _texIndex, QuantizedTransform &_out) const;
+
+	// xyz origin of every sector, w is the length of one position step
+	const vector<XMFLOAT4> &GetSectorOrigins() const;
+	void Clear();
+
+private:
+	float sectorSize = 128.0f;
+	unordered_map<uint64_t, int> sectorLookup;
+	vector<XMFLOAT4> sectorOrigins;
+};
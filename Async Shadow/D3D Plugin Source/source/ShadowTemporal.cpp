@@ -0,0 +1,339 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+#include "ShadowTemporal.h"
+#include <algorithm>
+#include <cmath>
+
+static const int NumBuckets = 1024;
+static const long long NotScheduled = -1;
+static const long long FarBucket = -2;
+static const double NeverExpire = DBL_MAX;
+
+ShadowTemporalCulling::ShadowTemporalCulling()
+{
+	buckets.resize(NumBuckets);
+}
+
+ShadowTemporalCulling::~ShadowTemporalCulling()
+{
+
+}
+
+void ShadowTemporalCulling::Reset()
+{
+	valid = false;
+}
+
+void ShadowTemporalCulling::MarkDirty(int _index)
+{
+	if (!valid || _index < 0 || _index >= (int)dirtyFlag.size() || dirtyFlag[_index])
+	{
+		return;
+	}
+
+	dirtyFlag[_index] = true;
+	dirtyObjects.push_back(_index);
+}
+
+int ShadowTemporalCulling::Cull(const ShadowFrustum &_frustum, const ShadowBoundsStore &_bounds, vector<int> &_visible)
+{
+	int count = _bounds.Size();
+
+	if (!valid || count != (int)expiry.size())
+	{
+		FullPass(_frustum, _bounds);
+		_visible.assign(visibleList.begin(), visibleList.end());
+		return count;
+	}
+
+	motion += PlaneMotion(_frustum);
+	lastFrustum = _frustum;
+
+	long long currBucket = (long long)(motion / bucketWidth);
+	if (currBucket - baseBucket >= NumBuckets)
+	{
+		// light jumped, nothing to reuse
+		FullPass(_frustum, _bounds);
+		_visible.assign(visibleList.begin(), visibleList.end());
+		return count;
+	}
+
+	// moved objects first, their old margins mean nothing
+	expired.clear();
+	for (int i = 0; i < (int)dirtyObjects.size(); i++)
+	{
+		dirtyFlag[dirtyObjects[i]] = false;
+		expired.push_back(dirtyObjects[i]);
+	}
+	dirtyObjects.clear();
+
+	// then everything the planes may have crossed
+	for (long long b = baseBucket; b <= currBucket; b++)
+	{
+		CollectExpired(b);
+	}
+	baseBucket = currBucket;
+
+	for (int i = 0; i < (int)expired.size(); i++)
+	{
+		TestObject(_frustum, _bounds, expired[i]);
+		Schedule(expired[i]);
+	}
+
+	if (baseBucket - farCheckBucket >= NumBuckets / 2)
+	{
+		RedistributeFar();
+	}
+
+	_visible.assign(visibleList.begin(), visibleList.end());
+	return (int)expired.size();
+}
+
+void ShadowTemporalCulling::FullPass(const ShadowFrustum &_frustum, const ShadowBoundsStore &_bounds)
+{
+	int count = _bounds.Size();
+
+	lastFrustum = _frustum;
+	motion = 0.0;
+	maxReach = 0.0;
+	baseBucket = 0;
+	farCheckBucket = 0;
+	valid = true;
+
+	// pivot at the middle of all finite bounds
+	XMFLOAT3 sceneMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	XMFLOAT3 sceneMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int i = 0; i < count; i++)
+	{
+		if (_bounds.extentX[i] < FLT_MAX && _bounds.extentY[i] < FLT_MAX && _bounds.extentZ[i] < FLT_MAX)
+		{
+			sceneMin.x = min(sceneMin.x, _bounds.centerX[i]);
+			sceneMin.y = min(sceneMin.y, _bounds.centerY[i]);
+			sceneMin.z = min(sceneMin.z, _bounds.centerZ[i]);
+			sceneMax.x = max(sceneMax.x, _bounds.centerX[i]);
+			sceneMax.y = max(sceneMax.y, _bounds.centerY[i]);
+			sceneMax.z = max(sceneMax.z, _bounds.centerZ[i]);
+		}
+	}
+
+	pivot = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	if (sceneMin.x <= sceneMax.x)
+	{
+		pivot = XMFLOAT3((sceneMin.x + sceneMax.x) * 0.5f, (sceneMin.y + sceneMax.y) * 0.5f, (sceneMin.z + sceneMax.z) * 0.5f);
+	}
+
+	expiry.assign(count, 0.0);
+	scheduled.assign(count, NotScheduled);
+	visibleList.clear();
+	visiblePos.assign(count, -1);
+	dirtyObjects.clear();
+	dirtyFlag.assign(count, false);
+
+	for (int i = 0; i < count; i++)
+	{
+		TestObject(_frustum, _bounds, i);
+	}
+
+	// the ring covers about the scene size, margins larger than that are rare
+	bucketWidth = max(maxReach, 1.0) / NumBuckets;
+	for (int i = 0; i < NumBuckets; i++)
+	{
+		buckets[i].clear();
+	}
+	farObjects.clear();
+
+	for (int i = 0; i < count; i++)
+	{
+		Schedule(i);
+	}
+}
+
+void ShadowTemporalCulling::TestObject(const ShadowFrustum &_frustum, const ShadowBoundsStore &_bounds, int _index)
+{
+	float cx = _bounds.centerX[_index];
+	float cy = _bounds.centerY[_index];
+	float cz = _bounds.centerZ[_index];
+	float ex = _bounds.extentX[_index];
+	float ey = _bounds.extentY[_index];
+	float ez = _bounds.extentZ[_index];
+
+	// largest signed distance outside any plane, same test as the culling kernels
+	float maxOutside = -FLT_MAX;
+	for (int p = 0; p < 6; p++)
+	{
+		const XMFLOAT4 &plane = _frustum.planes[p];
+		float dist = cx * plane.x + cy * plane.y + cz * plane.z + plane.w;
+		float radius = ex * fabsf(plane.x) + ey * fabsf(plane.y) + ez * fabsf(plane.z);
+		maxOutside = max(maxOutside, dist - radius);
+	}
+
+	bool visible = !(maxOutside > 0.0f);
+	SetVisible(_index, visible);
+
+	// object state can only flip after planes moved by more than this margin, see PlaneMotion()
+	double margin = fabs((double)maxOutside);
+	double reach = Reach(_bounds, _index);
+
+	if (!(margin < FLT_MAX) || !(reach < FLT_MAX))
+	{
+		// infinite bounds never change state
+		expiry[_index] = NeverExpire;
+	}
+	else
+	{
+		maxReach = max(maxReach, reach);
+		expiry[_index] = motion + margin;
+	}
+}
+
+void ShadowTemporalCulling::SetVisible(int _index, bool _visible)
+{
+	int pos = visiblePos[_index];
+
+	if (_visible && pos < 0)
+	{
+		visiblePos[_index] = (int)visibleList.size();
+		visibleList.push_back(_index);
+	}
+	else if (!_visible && pos >= 0)
+	{
+		// swap remove, draw order doesn't matter for depth only rendering
+		int last = visibleList.back();
+		visibleList[pos] = last;
+		visiblePos[last] = pos;
+		visibleList.pop_back();
+		visiblePos[_index] = -1;
+	}
+}
+
+void ShadowTemporalCulling::Schedule(int _index)
+{
+	if (expiry[_index] == NeverExpire)
+	{
+		scheduled[_index] = NotScheduled;
+		return;
+	}
+
+	long long bucket = max((long long)(expiry[_index] / bucketWidth), baseBucket);
+	if (bucket - baseBucket >= NumBuckets)
+	{
+		if (scheduled[_index] != FarBucket)
+		{
+			scheduled[_index] = FarBucket;
+			farObjects.push_back(_index);
+		}
+		return;
+	}
+
+	if (scheduled[_index] != bucket)
+	{
+		scheduled[_index] = bucket;
+		buckets[bucket % NumBuckets].push_back(_index);
+	}
+}
+
+void ShadowTemporalCulling::CollectExpired(long long _bucket)
+{
+	vector<int> &bucket = buckets[_bucket % NumBuckets];
+
+	// the last bucket is only partly passed, objects that haven't expired stay in it
+	int keep = 0;
+	for (int i = 0; i < (int)bucket.size(); i++)
+	{
+		int idx = bucket[i];
+		if (scheduled[idx] != _bucket)
+		{
+			continue;
+		}
+
+		if (expiry[idx] < motion)
+		{
+			scheduled[idx] = NotScheduled;
+			expired.push_back(idx);
+		}
+		else
+		{
+			bucket[keep++] = idx;
+		}
+	}
+	bucket.resize(keep);
+}
+
+void ShadowTemporalCulling::RedistributeFar()
+{
+	farCheckBucket = baseBucket;
+
+	int keep = 0;
+	for (int i = 0; i < (int)farObjects.size(); i++)
+	{
+		int idx = farObjects[i];
+		if (scheduled[idx] != FarBucket)
+		{
+			continue;
+		}
+
+		scheduled[idx] = NotScheduled;
+		Schedule(idx);
+		if (scheduled[idx] == FarBucket)
+		{
+			farObjects[keep++] = idx;
+		}
+	}
+	farObjects.resize(keep);
+}
+
+double ShadowTemporalCulling::Reach(const ShadowBoundsStore &_bounds, int _index)
+{
+	double dx = (double)_bounds.centerX[_index] - pivot.x;
+	double dy = (double)_bounds.centerY[_index] - pivot.y;
+	double dz = (double)_bounds.centerZ[_index] - pivot.z;
+	double ex = _bounds.extentX[_index];
+	double ey = _bounds.extentY[_index];
+	double ez = _bounds.extentZ[_index];
+
+	return sqrt(dx * dx + dy * dy + dz * dz) + sqrt(ex * ex + ey * ey + ez * ez);
+}
+
+double ShadowTemporalCulling::PlaneMotion(const ShadowFrustum &_frustum)
+{
+	// relative to pivot, a plane change moves (dist - radius) of a box by at most |dn| * reach + |dn . pivot + dw|.
+	// reach of every tested object is below maxReach, so this bounds the change for all of them at once.
+	double motionBound = 0.0;
+
+	for (int p = 0; p < 6; p++)
+	{
+		const XMFLOAT4 &a = _frustum.planes[p];
+		const XMFLOAT4 &b = lastFrustum.planes[p];
+
+		double dx = (double)a.x - b.x;
+		double dy = (double)a.y - b.y;
+		double dz = (double)a.z - b.z;
+		double dw = (double)a.w - b.w;
+
+		double normalMotion = sqrt(dx * dx + dy * dy + dz * dz);
+		double pivotMotion = fabs(dx * pivot.x + dy * pivot.y + dz * pivot.z + dw);
+		motionBound = max(motionBound, normalMotion * maxReach + pivotMotion);
+	}
+
+	return motionBound;
+}
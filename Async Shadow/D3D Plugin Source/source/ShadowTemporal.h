@@ -0,0 +1,73 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+#pragma once
+#include "ShadowCulling.h"
+
+// incremental culling that keeps last frame's visibility.
+// every object remembers how far it is from flipping, accumulated plane motion is compared against that margin,
+// so only moved objects and objects close to moving planes are tested again.
+class ShadowTemporalCulling
+{
+public:
+	ShadowTemporalCulling();
+	~ShadowTemporalCulling();
+
+	// forces a full pass next frame
+	void Reset();
+	void MarkDirty(int _index);
+
+	// returns how many objects were tested this frame
+	int Cull(const ShadowFrustum &_frustum, const ShadowBoundsStore &_bounds, vector<int> &_visible);
+
+private:
+	void FullPass(const ShadowFrustum &_frustum, const ShadowBoundsStore &_bounds);
+	void TestObject(const ShadowFrustum &_frustum, const ShadowBoundsStore &_bounds, int _index);
+	void SetVisible(int _index, bool _visible);
+	void Schedule(int _index);
+	void CollectExpired(long long _bucket);
+	void RedistributeFar();
+	double PlaneMotion(const ShadowFrustum &_frustum);
+	double Reach(const ShadowBoundsStore &_bounds, int _index);
+
+	ShadowFrustum lastFrustum;
+	double motion = 0.0;			// accumulated plane motion in world units since the last full pass
+	double maxReach = 0.0;			// largest distance of any finite bounds from pivot
+	XMFLOAT3 pivot;					// planes turning around this point move nearby objects less
+	bool valid = false;
+
+	// objects wait in a ring of buckets sorted by expiry, far ones wait in a separate list.
+	// an entry is stale when the object got scheduled somewhere else afterwards.
+	vector<double> expiry;			// motion value at which the object must be tested again
+	vector<long long> scheduled;	// bucket the object waits in
+	vector<vector<int>> buckets;
+	vector<int> farObjects;
+	double bucketWidth = 1.0;
+	long long baseBucket = 0;		// bucket at the start of the ring
+	long long farCheckBucket = 0;	// base bucket at the last far list pass
+
+	vector<int> expired;
+	vector<int> visibleList;
+	vector<int> visiblePos;			// position in visibleList, -1 when culled
+	vector<int> dirtyObjects;
+	vector<bool> dirtyFlag;
+};
@@ -0,0 +1,290 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+#include "ShadowTransform.h"
+#include "ShadowCulling.h"
+#include <string.h>
+#include <immintrin.h>
+
+// split 4 packed float3 into x, y, z columns
+static inline void LoadFloat3x4(const float *_src, __m128 &_x, __m128 &_y, __m128 &_z)
+{
+	__m128 a = _mm_loadu_ps(_src);			// x0 y0 z0 x1
+	__m128 b = _mm_loadu_ps(_src + 4);		// y1 z1 x2 y2
+	__m128 c = _mm_loadu_ps(_src + 8);		// z2 x3 y3 z3
+
+	__m128 xy = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));	// x2 y2 x3 y3
+	__m128 yz = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));	// y0 z0 y1 z1
+	_x = _mm_shuffle_ps(a, xy, _MM_SHUFFLE(2, 0, 3, 0));
+	_y = _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+	_z = _mm_shuffle_ps(yz, c, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+// four objects in SoA form, 3 or 4 rows written to each lane's output
+static inline void ComposeSoA(__m128 px, __m128 py, __m128 pz, __m128 sx, __m128 sy, __m128 sz,
+	__m128 qx, __m128 qy, __m128 qz, __m128 qw, float *_out[4], int _rows)
+{
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 two = _mm_set1_ps(2.0f);
+	__m128 x2 = _mm_mul_ps(qx, two);
+	__m128 y2 = _mm_mul_ps(qy, two);
+	__m128 z2 = _mm_mul_ps(qz, two);
+
+	__m128 xx = _mm_mul_ps(qx, x2), yy = _mm_mul_ps(qy, y2), zz = _mm_mul_ps(qz, z2);
+	__m128 xy = _mm_mul_ps(qx, y2), xz = _mm_mul_ps(qx, z2), yz = _mm_mul_ps(qy, z2);
+	__m128 wx = _mm_mul_ps(qw, x2), wy = _mm_mul_ps(qw, y2), wz = _mm_mul_ps(qw, z2);
+
+	// rows of the transposed matrix, column j of rotation row i scaled by scale j
+	__m128 rows[3][4];
+	rows[0][0] = _mm_mul_ps(sx, _mm_sub_ps(one, _mm_add_ps(yy, zz)));
+	rows[0][1] = _mm_mul_ps(sy, _mm_sub_ps(xy, wz));
+	rows[0][2] = _mm_mul_ps(sz, _mm_add_ps(xz, wy));
+	rows[0][3] = px;
+
+	rows[1][0] = _mm_mul_ps(sx, _mm_add_ps(xy, wz));
+	rows[1][1] = _mm_mul_ps(sy, _mm_sub_ps(one, _mm_add_ps(xx, zz)));
+	rows[1][2] = _mm_mul_ps(sz, _mm_sub_ps(yz, wx));
+	rows[1][3] = py;
+
+	rows[2][0] = _mm_mul_ps(sx, _mm_sub_ps(xz, wy));
+	rows[2][1] = _mm_mul_ps(sy, _mm_add_ps(yz, wx));
+	rows[2][2] = _mm_mul_ps(sz, _mm_sub_ps(one, _mm_add_ps(xx, yy)));
+	rows[2][3] = pz;
+
+	// back to one matrix per object
+	for (int r = 0; r < 3; r++)
+	{
+		_MM_TRANSPOSE4_PS(rows[r][0], rows[r][1], rows[r][2], rows[r][3]);
+	}
+
+	__m128 lastRow = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+	for (int j = 0; j < 4; j++)
+	{
+		_mm_storeu_ps(_out[j], rows[0][j]);
+		_mm_storeu_ps(_out[j] + 4, rows[1][j]);
+		_mm_storeu_ps(_out[j] + 8, rows[2][j]);
+		if (_rows == 4)
+		{
+			_mm_storeu_ps(_out[j] + 12, lastRow);
+		}
+	}
+}
+
+static inline void ComposeBlock(const float *_pos, const float *_scale, const float *_rot, XMFLOAT4X4 *_out)
+{
+	__m128 px, py, pz, sx, sy, sz;
+	LoadFloat3x4(_pos, px, py, pz);
+	LoadFloat3x4(_scale, sx, sy, sz);
+
+	__m128 qx = _mm_loadu_ps(_rot);
+	__m128 qy = _mm_loadu_ps(_rot + 4);
+	__m128 qz = _mm_loadu_ps(_rot + 8);
+	__m128 qw = _mm_loadu_ps(_rot + 12);
+	_MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+	float *out[4] = { _out[0].m[0], _out[1].m[0], _out[2].m[0], _out[3].m[0] };
+	ComposeSoA(px, py, pz, sx, sy, sz, qx, qy, qz, qw, out, 4);
+}
+
+void ComposeTransposedTRS(const float *_pos, const float *_scale, const float *_rot, int _count, XMFLOAT4X4 *_out)
+{
+	int i = 0;
+	for (; i + 4 <= _count; i += 4)
+	{
+		ComposeBlock(_pos + i * 3, _scale + i * 3, _rot + i * 4, _out + i);
+	}
+
+	int rest = _count - i;
+	if (rest > 0)
+	{
+		// padded block so the vector loads never read past the caller's arrays
+		float pos[12] = {}, scale[12] = {}, rot[16] = {};
+		XMFLOAT4X4 out[4];
+		memcpy(pos, _pos + i * 3, sizeof(float) * 3 * rest);
+		memcpy(scale, _scale + i * 3, sizeof(float) * 3 * rest);
+		memcpy(rot, _rot + i * 4, sizeof(float) * 4 * rest);
+
+		ComposeBlock(pos, scale, rot, out);
+		memcpy(_out + i, out, sizeof(XMFLOAT4X4) * rest);
+	}
+}
+
+void ComposeTransposedTRS(const TransformRecord *_records, const int *_indices, int _count, XMFLOAT4X4 *_out)
+{
+	XMFLOAT4X4 discard;
+
+	for (int i = 0; i < _count; i += 4)
+	{
+		// short last block repeats its final record and drops the extra lanes
+		const TransformRecord *rec[4];
+		float *out[4];
+		for (int j = 0; j < 4; j++)
+		{
+			bool valid = i + j < _count;
+			int idx = _indices[valid ? i + j : _count - 1];
+			rec[j] = &_records[idx];
+			out[j] = valid ? _out[idx].m[0] : discard.m[0];
+		}
+
+		// each load spills into the next field of the same record, the 4th lane is dropped by the transpose
+		__m128 px = _mm_loadu_ps(&rec[0]->position.x), py = _mm_loadu_ps(&rec[1]->position.x);
+		__m128 pz = _mm_loadu_ps(&rec[2]->position.x), pw = _mm_loadu_ps(&rec[3]->position.x);
+		_MM_TRANSPOSE4_PS(px, py, pz, pw);
+
+		__m128 sx = _mm_loadu_ps(&rec[0]->scale.x), sy = _mm_loadu_ps(&rec[1]->scale.x);
+		__m128 sz = _mm_loadu_ps(&rec[2]->scale.x), sw = _mm_loadu_ps(&rec[3]->scale.x);
+		_MM_TRANSPOSE4_PS(sx, sy, sz, sw);
+
+		__m128 qx = _mm_loadu_ps(&rec[0]->rotation.x), qy = _mm_loadu_ps(&rec[1]->rotation.x);
+		__m128 qz = _mm_loadu_ps(&rec[2]->rotation.x), qw = _mm_loadu_ps(&rec[3]->rotation.x);
+		_MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+		ComposeSoA(px, py, pz, sx, sy, sz, qx, qy, qz, qw, out, 4);
+	}
+}
+
+// lane j of an 8-wide column set goes to _out[j], 4 transposed columns make one row
+static inline void StoreRowAVX(__m256 c0, __m256 c1, __m256 c2, __m256 c3, float *_out[8], int _offset)
+{
+	__m256 t0 = _mm256_unpacklo_ps(c0, c1);		// c0_0 c1_0 c0_1 c1_1 | lanes 4, 5
+	__m256 t1 = _mm256_unpackhi_ps(c0, c1);		// c0_2 c1_2 c0_3 c1_3 | lanes 6, 7
+	__m256 t2 = _mm256_unpacklo_ps(c2, c3);
+	__m256 t3 = _mm256_unpackhi_ps(c2, c3);
+
+	__m256 r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+	_mm_storeu_ps(_out[0] + _offset, _mm256_castps256_ps128(r0));
+	_mm_storeu_ps(_out[1] + _offset, _mm256_castps256_ps128(r1));
+	_mm_storeu_ps(_out[2] + _offset, _mm256_castps256_ps128(r2));
+	_mm_storeu_ps(_out[3] + _offset, _mm256_castps256_ps128(r3));
+	_mm_storeu_ps(_out[4] + _offset, _mm256_extractf128_ps(r0, 1));
+	_mm_storeu_ps(_out[5] + _offset, _mm256_extractf128_ps(r1, 1));
+	_mm_storeu_ps(_out[6] + _offset, _mm256_extractf128_ps(r2, 1));
+	_mm_storeu_ps(_out[7] + _offset, _mm256_extractf128_ps(r3, 1));
+}
+
+// eight objects per step, returns how many were done, the rest is left for the SSE path
+static int ComposeStreamsAVX2(const TransformStreams &_in, int _count, uint8_t *_dst, size_t _dstStride, int _rows)
+{
+	__m256 one = _mm256_set1_ps(1.0f);
+	__m256 zero = _mm256_setzero_ps();
+	__m256 two = _mm256_set1_ps(2.0f);
+
+	int i = 0;
+	for (; i + 8 <= _count; i += 8)
+	{
+		__m256 qx = _mm256_loadu_ps(_in.rotX + i), qy = _mm256_loadu_ps(_in.rotY + i);
+		__m256 qz = _mm256_loadu_ps(_in.rotZ + i), qw = _mm256_loadu_ps(_in.rotW + i);
+		__m256 sx = _mm256_loadu_ps(_in.scaleX + i), sy = _mm256_loadu_ps(_in.scaleY + i), sz = _mm256_loadu_ps(_in.scaleZ + i);
+
+		__m256 x2 = _mm256_mul_ps(qx, two), y2 = _mm256_mul_ps(qy, two), z2 = _mm256_mul_ps(qz, two);
+		__m256 xx = _mm256_mul_ps(qx, x2), yy = _mm256_mul_ps(qy, y2), zz = _mm256_mul_ps(qz, z2);
+		__m256 xy = _mm256_mul_ps(qx, y2), xz = _mm256_mul_ps(qx, z2), yz = _mm256_mul_ps(qy, z2);
+		__m256 wx = _mm256_mul_ps(qw, x2), wy = _mm256_mul_ps(qw, y2), wz = _mm256_mul_ps(qw, z2);
+
+		float *out[8];
+		for (int j = 0; j < 8; j++)
+		{
+			out[j] = (float*)(_dst + (i + j) * _dstStride);
+		}
+
+		// same terms as ComposeSoA, one row of the transposed matrix at a time
+		StoreRowAVX(_mm256_mul_ps(sx, _mm256_sub_ps(one, _mm256_add_ps(yy, zz))),
+			_mm256_mul_ps(sy, _mm256_sub_ps(xy, wz)),
+			_mm256_mul_ps(sz, _mm256_add_ps(xz, wy)),
+			_mm256_loadu_ps(_in.posX + i), out, 0);
+
+		StoreRowAVX(_mm256_mul_ps(sx, _mm256_add_ps(xy, wz)),
+			_mm256_mul_ps(sy, _mm256_sub_ps(one, _mm256_add_ps(xx, zz))),
+			_mm256_mul_ps(sz, _mm256_sub_ps(yz, wx)),
+			_mm256_loadu_ps(_in.posY + i), out, 4);
+
+		StoreRowAVX(_mm256_mul_ps(sx, _mm256_sub_ps(xz, wy)),
+			_mm256_mul_ps(sy, _mm256_add_ps(yz, wx)),
+			_mm256_mul_ps(sz, _mm256_sub_ps(one, _mm256_add_ps(xx, yy))),
+			_mm256_loadu_ps(_in.posZ + i), out, 8);
+
+		if (_rows == 4)
+		{
+			StoreRowAVX(zero, zero, zero, one, out, 12);
+		}
+	}
+
+	return i;
+}
+
+static int ComposeStreamsSSE(const TransformStreams &_in, int _begin, int _count, uint8_t *_dst, size_t _dstStride, int _rows)
+{
+	int i = _begin;
+	for (; i + 4 <= _count; i += 4)
+	{
+		float *out[4];
+		for (int j = 0; j < 4; j++)
+		{
+			out[j] = (float*)(_dst + (i + j) * _dstStride);
+		}
+
+		ComposeSoA(_mm_loadu_ps(_in.posX + i), _mm_loadu_ps(_in.posY + i), _mm_loadu_ps(_in.posZ + i),
+			_mm_loadu_ps(_in.scaleX + i), _mm_loadu_ps(_in.scaleY + i), _mm_loadu_ps(_in.scaleZ + i),
+			_mm_loadu_ps(_in.rotX + i), _mm_loadu_ps(_in.rotY + i), _mm_loadu_ps(_in.rotZ + i), _mm_loadu_ps(_in.rotW + i),
+			out, _rows);
+	}
+
+	return i;
+}
+
+void ComposeTransposedTRS(const TransformStreams &_streams, int _count, void *_dst, size_t _dstStride, int _rows)
+{
+	static const bool hasAVX2 = ShadowCulling::GetSupportedKernel() == CullingKernel_AVX2;
+
+	uint8_t *dst = (uint8_t*)_dst;
+	int i = hasAVX2 ? ComposeStreamsAVX2(_streams, _count, dst, _dstStride, _rows) : 0;
+	i = ComposeStreamsSSE(_streams, i, _count, dst, _dstStride, _rows);
+
+	int rest = _count - i;
+	if (rest > 0)
+	{
+		// padded columns so the vector loads stay inside the caller's streams,
+		// outputs go through a local block since the destination may be tightly packed
+		float column[10][4] = {};
+		const float *src[10] = { _streams.posX, _streams.posY, _streams.posZ, _streams.rotX, _streams.rotY, _streams.rotZ, _streams.rotW,
+			_streams.scaleX, _streams.scaleY, _streams.scaleZ };
+		for (int c = 0; c < 10; c++)
+		{
+			memcpy(column[c], src[c] + i, sizeof(float) * rest);
+		}
+
+		TransformStreams padded = { column[0], column[1], column[2], column[3], column[4], column[5], column[6], column[7], column[8], column[9] };
+		float block[4][16];
+		ComposeStreamsSSE(padded, 0, 4, (uint8_t*)block, sizeof(block[0]), _rows);
+
+		for (int j = 0; j < rest; j++)
+		{
+			memcpy(dst + (i + j) * _dstStride, block[j], sizeof(float) * 4 * _rows);
+		}
+	}
+}
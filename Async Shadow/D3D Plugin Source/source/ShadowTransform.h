@@ -0,0 +1,58 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include <DirectXMath.h>
+#include <cstdint>
+#include <cstddef>
+using namespace DirectX;
+
+// fixed-stride TRS record, the layout the engine writes into the transform arena
+struct TransformRecord
+{
+	XMFLOAT3 position;
+	XMFLOAT3 scale;
+	XMFLOAT4 rotation;
+};
+static_assert(sizeof(TransformRecord) == 40, "TransformRecord is shared with the engine, keep it packed");
+
+// composes scale * rotation(quaternion) * translation for a batch of objects and stores the transposed result,
+// the same matrix XMMatrixTranspose(S * R * T) would give. inputs are tightly packed float3/float3/float4 arrays.
+// four objects are composed per step in SoA form, the tail goes through a padded block.
+void ComposeTransposedTRS(const float *_pos, const float *_scale, const float *_rot, int _count, XMFLOAT4X4 *_out);
+
+// same for the listed records, the result of _records[_indices[i]] goes to _out[_indices[i]]
+void ComposeTransposedTRS(const TransformRecord *_records, const int *_indices, int _count, XMFLOAT4X4 *_out);
+
+// structure of arrays input, one column per component
+struct TransformStreams
+{
+	const float *posX, *posY, *posZ;
+	const float *rotX, *rotY, *rotZ, *rotW;
+	const float *scaleX, *scaleY, *scaleZ;
+};
+
+// composes from SoA streams, 8 objects per step with AVX2 and 4 with SSE otherwise.
+// object i gets _rows (3 for a 3x4, 4 for a 4x4) transposed rows at _dst + i * _dstStride,
+// so it can write into mapped upload memory with the ObjectData or ObjectConstants stride.
+void ComposeTransposedTRS(const TransformStreams &_streams, int _count, void *_dst, size_t _dstStride, int _rows);
@@ -0,0 +1,102 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#include "SlotMap.h"
+
+void SlotMap::Reset(int _count)
+{
+	generation.assign(_count, 0);
+	alive.assign(_count, 1);
+	freeSlots.clear();
+	liveCount = _count;
+}
+
+int SlotMap::Allocate()
+{
+	int index;
+	if (!freeSlots.empty())
+	{
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		if ((int)generation.size() >= MaxSlots)
+		{
+			return -1;
+		}
+
+		index = (int)generation.size();
+		generation.push_back(0);
+		alive.push_back(0);
+	}
+
+	alive[index] = 1;
+	liveCount++;
+
+	return (generation[index] << IndexBits) | index;
+}
+
+bool SlotMap::Free(int _handle)
+{
+	int index = GetIndex(_handle);
+	if (index < 0)
+	{
+		return false;
+	}
+
+	// bump the generation so the freed handle stops resolving
+	alive[index] = 0;
+	generation[index] = (generation[index] + 1) & GenerationMask;
+	freeSlots.push_back(index);
+	liveCount--;
+
+	return true;
+}
+
+int SlotMap::GetIndex(int _handle) const
+{
+	if (_handle < 0)
+	{
+		return -1;
+	}
+
+	int index = _handle & (MaxSlots - 1);
+	int gen = _handle >> IndexBits;
+	if (index >= (int)generation.size() || !alive[index] || generation[index] != gen)
+	{
+		return -1;
+	}
+
+	return index;
+}
+
+int SlotMap::GetSlotCount() const
+{
+	return (int)generation.size();
+}
+
+int SlotMap::GetLiveCount() const
+{
+	return liveCount;
+}
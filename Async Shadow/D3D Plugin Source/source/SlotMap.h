@@ -0,0 +1,59 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// stable slot indices behind handles. freed slots go on a free list and are reused first, so indices stay dense.
+// a handle keeps the generation of its slot in the high bits, once the slot is freed the old handle no longer resolves.
+// handles of the slots created by Reset() equal their indices.
+class SlotMap
+{
+public:
+	static const int IndexBits = 24;
+	static const int MaxSlots = 1 << IndexBits;
+
+	// starts over with _count live slots
+	void Reset(int _count);
+
+	// returns a handle, -1 when every index is taken
+	int Allocate();
+	bool Free(int _handle);
+
+	// slot index of a live handle, -1 for stale or invalid handles
+	int GetIndex(int _handle) const;
+
+	// every slot ever handed out, live or free
+	int GetSlotCount() const;
+	int GetLiveCount() const;
+
+private:
+	static const int GenerationMask = 0x7f;		// keeps handles positive
+
+	vector<uint8_t> generation;
+	vector<uint8_t> alive;
+	vector<int> freeSlots;
+	int liveCount = 0;
+};
@@ -0,0 +1,63 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <emmintrin.h>
+
+// copy with non-temporal stores for write-combined upload heaps.
+// partial lines there cost a full bus transaction each, so data should leave in whole lines and in order.
+// only whole 64-byte lines are streamed, the partial lines at both ends use normal stores.
+// stores are weakly ordered, the writing thread must call StreamFence() before the gpu may read.
+inline void StreamCopy(void *_dst, const void *_src, size_t _bytes)
+{
+	uint8_t *dst = (uint8_t*)_dst;
+	const uint8_t *src = (const uint8_t*)_src;
+
+	size_t head = (64 - ((uintptr_t)dst & 63)) & 63;
+	head = (head < _bytes) ? head : _bytes;
+	memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	_bytes -= head;
+
+	for (; _bytes >= 64; _bytes -= 64, dst += 64, src += 64)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)src);
+		__m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+		__m128i c = _mm_loadu_si128((const __m128i*)(src + 32));
+		__m128i d = _mm_loadu_si128((const __m128i*)(src + 48));
+		_mm_stream_si128((__m128i*)dst, a);
+		_mm_stream_si128((__m128i*)(dst + 16), b);
+		_mm_stream_si128((__m128i*)(dst + 32), c);
+		_mm_stream_si128((__m128i*)(dst + 48), d);
+	}
+
+	memcpy(dst, src, _bytes);
+}
+
+inline void StreamFence()
+{
+	_mm_sfence();
+}
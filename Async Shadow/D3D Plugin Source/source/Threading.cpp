@@ -0,0 +1,176 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "Threading.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#pragma comment(lib, "Synchronization.lib")
+#elif defined(__linux__)
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(atomic<uint32_t>) == sizeof(uint32_t), "futex words must be plain 32-bit integers");
+
+void FutexWait(atomic<uint32_t> *_address, uint32_t _expected)
+{
+#if defined(_WIN32)
+	WaitOnAddress(_address, &_expected, sizeof(uint32_t), INFINITE);
+#elif defined(__linux__)
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(_address), FUTEX_WAIT_PRIVATE, _expected, nullptr, nullptr, 0);
+#else
+	// no address wait here, the callers loop on the word anyway
+	if (_address->load(memory_order_relaxed) == _expected)
+	{
+		this_thread::yield();
+	}
+#endif
+}
+
+void FutexWakeOne(atomic<uint32_t> *_address)
+{
+#if defined(_WIN32)
+	WakeByAddressSingle(_address);
+#elif defined(__linux__)
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(_address), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+}
+
+void FutexWakeAll(atomic<uint32_t> *_address)
+{
+#if defined(_WIN32)
+	WakeByAddressAll(_address);
+#elif defined(__linux__)
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(_address), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+void SleepMs(float _ms)
+{
+	if (_ms > 0.0f)
+	{
+		this_thread::sleep_for(chrono::duration<float, milli>(_ms));
+	}
+}
+
+FrameSignal::FrameSignal()
+	: state(0)
+{
+
+}
+
+void FrameSignal::Set()
+{
+	// only the transition wakes, a waiter that hasn't slept yet sees the word changed
+	if (state.exchange(1, memory_order_release) == 0)
+	{
+		FutexWakeOne(&state);
+	}
+}
+
+void FrameSignal::Wait()
+{
+	while (state.exchange(0, memory_order_acquire) == 0)
+	{
+		FutexWait(&state, 0);
+	}
+}
+
+void FrameSignal::Reset()
+{
+	state.store(0, memory_order_relaxed);
+}
+
+ShadowWorker::ShadowWorker()
+	: delayMs(0.0f), quit(false)
+{
+
+}
+
+ShadowWorker::~ShadowWorker()
+{
+	Stop();
+}
+
+void ShadowWorker::Start(const function<void()> &_frame)
+{
+	if (worker.joinable())
+	{
+		return;
+	}
+
+	frame = _frame;
+	quit = false;
+	beginFrame.Reset();
+	worker = thread(&ShadowWorker::Run, this);
+}
+
+void ShadowWorker::Stop()
+{
+	if (!worker.joinable())
+	{
+		return;
+	}
+
+	quit = true;
+	beginFrame.Set();
+	worker.join();
+	frame = nullptr;
+}
+
+bool ShadowWorker::IsRunning()
+{
+	return worker.joinable();
+}
+
+void ShadowWorker::Notify(float _delayMs)
+{
+	delayMs.store(_delayMs, memory_order_relaxed);
+	beginFrame.Set();
+}
+
+void ShadowWorker::Run()
+{
+	while (true)
+	{
+		beginFrame.Wait();
+		if (quit)
+		{
+			return;
+		}
+
+		// the fake load can be long, a stop that came in meanwhile skips the frame
+		SleepMs(delayMs.load(memory_order_relaxed));
+		if (quit)
+		{
+			return;
+		}
+
+		frame();
+	}
+}
@@ -0,0 +1,88 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+using namespace std;
+
+// futex-style wait on a 32-bit word, WaitOnAddress on Windows and futex on Linux.
+// returns once *_address no longer holds _expected or a wake arrives, spurious returns are allowed.
+void FutexWait(atomic<uint32_t> *_address, uint32_t _expected);
+void FutexWakeOne(atomic<uint32_t> *_address);
+void FutexWakeAll(atomic<uint32_t> *_address);
+
+void SleepMs(float _ms);
+
+// auto-reset event, one Set() releases one Wait(). sets nobody waited for collapse into one.
+class FrameSignal
+{
+public:
+	FrameSignal();
+	FrameSignal(const FrameSignal& rhs) = delete;
+	FrameSignal& operator=(const FrameSignal& rhs) = delete;
+
+	void Set();
+	void Wait();
+
+	// drops a pending Set(), only while nobody waits
+	void Reset();
+
+private:
+	atomic<uint32_t> state;		// 1 while set
+};
+
+// the shadow thread, it sleeps until a frame is signalled and then runs that frame.
+// Stop() joins it and Start() brings it back, so the resources it uses can be rebuilt in between.
+class ShadowWorker
+{
+public:
+	ShadowWorker();
+	~ShadowWorker();
+	ShadowWorker(const ShadowWorker& rhs) = delete;
+	ShadowWorker& operator=(const ShadowWorker& rhs) = delete;
+
+	// does nothing when the thread already runs. frames signalled while it was stopped are dropped
+	void Start(const function<void()> &_frame);
+
+	// lets the frame in progress finish, skips the ones still pending and joins the thread.
+	// does nothing when it isn't running, the destructor calls it too
+	void Stop();
+
+	bool IsRunning();
+
+	// wakes the worker for one frame after _delayMs of fake load, frames signalled while it's busy collapse into one
+	void Notify(float _delayMs);
+
+private:
+	void Run();
+
+	thread worker;
+	FrameSignal beginFrame;
+	function<void()> frame;
+	atomic<float> delayMs;
+	atomic<bool> quit;
+};
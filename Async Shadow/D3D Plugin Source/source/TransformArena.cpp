@@ -0,0 +1,170 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+#include "TransformArena.h"
+#include <string.h>
+
+// arena buffers and their sections start on cache lines
+static size_t AlignUp(size_t _size)
+{
+	return (_size + 63) & ~(size_t)63;
+}
+
+TransformArena::TransformArena()
+{
+	latest = 0;
+	for (int i = 0; i < NumBuffers; i++)
+	{
+		buffers[i] = nullptr;
+	}
+}
+
+TransformArena::~TransformArena()
+{
+	Release();
+}
+
+bool TransformArena::Init(int _recordCount)
+{
+	Release();
+
+	uint32_t dirtyWords = (uint32_t)(_recordCount + 31) / 32;
+	size_t dirtyOffset = AlignUp(sizeof(TransformArenaHeader));
+	size_t recordOffset = AlignUp(dirtyOffset + dirtyWords * sizeof(uint32_t));
+	bufferSize = AlignUp(recordOffset + (size_t)_recordCount * sizeof(TransformRecord));
+
+	memory = (uint8_t*)_aligned_malloc(bufferSize * NumBuffers, 64);
+	if (memory == nullptr)
+	{
+		return false;
+	}
+	memset(memory, 0, bufferSize * NumBuffers);
+
+	for (int i = 0; i < NumBuffers; i++)
+	{
+		TransformArenaHeader *header = (TransformArenaHeader*)(memory + bufferSize * i);
+		header->recordCount = _recordCount;
+		header->recordStride = sizeof(TransformRecord);
+		header->dirtyOffset = (uint32_t)dirtyOffset;
+		header->dirtyWords = dirtyWords;
+		header->recordOffset = (uint32_t)recordOffset;
+		header->bufferIndex = i;
+		buffers[i] = header;
+	}
+
+	// writer starts on 0, reader holds 1, 2 is the shared slot with nothing new in it
+	writeIndex = 0;
+	readIndex = 1;
+	latest = 2;
+	consumedSequence = 0;
+	publishedDirty.assign(dirtyWords, 0);
+
+	return true;
+}
+
+void TransformArena::Release()
+{
+	if (memory != nullptr)
+	{
+		_aligned_free(memory);
+		memory = nullptr;
+	}
+
+	for (int i = 0; i < NumBuffers; i++)
+	{
+		buffers[i] = nullptr;
+	}
+	publishedDirty.clear();
+	bufferSize = 0;
+}
+
+bool TransformArena::IsCreated()
+{
+	return memory != nullptr;
+}
+
+TransformArenaHeader *TransformArena::GetWriteBuffer()
+{
+	return buffers[writeIndex];
+}
+
+TransformArenaHeader *TransformArena::Publish(uint64_t _sequence)
+{
+	if (memory == nullptr)
+	{
+		return nullptr;
+	}
+
+	TransformArenaHeader *published = buffers[writeIndex];
+	published->sequence = _sequence;
+
+	// the reader may clear these as soon as the swap below is done
+	memcpy(publishedDirty.data(), GetDirtyBits(published), publishedDirty.size() * sizeof(uint32_t));
+
+	uint32_t prev = latest.exchange(writeIndex | FreshBit, memory_order_acq_rel);
+	writeIndex = prev & ~FreshBit;
+
+	if (prev & FreshBit)
+	{
+		// reader skipped the older buffer, its dirty records are still owed to it.
+		// records rewritten in the buffer just published are newer, drop them here so they don't go back in time.
+		uint32_t *dirty = GetDirtyBits(buffers[writeIndex]);
+		for (size_t w = 0; w < publishedDirty.size(); w++)
+		{
+			dirty[w] &= ~publishedDirty[w];
+		}
+	}
+
+	return buffers[writeIndex];
+}
+
+TransformArenaHeader *TransformArena::Acquire()
+{
+	if (memory == nullptr || (latest.load(memory_order_acquire) & FreshBit) == 0)
+	{
+		return nullptr;
+	}
+
+	// hand back the buffer consumed last time, its dirty bits are all clear
+	uint32_t prev = latest.exchange(readIndex, memory_order_acq_rel);
+	readIndex = prev & ~FreshBit;
+
+	consumedSequence = buffers[readIndex]->sequence;
+	return buffers[readIndex];
+}
+
+uint64_t TransformArena::GetConsumedSequence()
+{
+	return consumedSequence;
+}
+
+uint32_t *TransformArena::GetDirtyBits(TransformArenaHeader *_buffer)
+{
+	return (uint32_t*)((uint8_t*)_buffer + _buffer->dirtyOffset);
+}
+
+TransformRecord *TransformArena::GetRecords(TransformArenaHeader *_buffer)
+{
+	return (TransformRecord*)((uint8_t*)_buffer + _buffer->recordOffset);
+}
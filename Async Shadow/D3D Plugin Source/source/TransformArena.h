@@ -0,0 +1,87 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include <malloc.h>
+#include "ShadowTransform.h"
+using namespace std;
+
+// start of every arena buffer, offsets are in bytes from the header so the engine can find the data on its own
+struct TransformArenaHeader
+{
+	uint64_t sequence;		// frame number set on publish
+	uint32_t recordCount;
+	uint32_t recordStride;
+	uint32_t dirtyOffset;		// one bit per record, 32-bit words
+	uint32_t dirtyWords;
+	uint32_t recordOffset;		// TransformRecord array
+	uint32_t bufferIndex;
+};
+
+// transform arena shared with the engine, allocated once and never moved until released.
+// the engine writes TRS records and sets their dirty bits in the write buffer, then publishes it.
+// the shadow thread takes the newest published buffer, composes its dirty records and clears the bits.
+// three buffers swapped through one atomic index, so writer and reader never touch the same buffer.
+class TransformArena
+{
+public:
+	static const int NumBuffers = 3;
+
+	TransformArena();
+	~TransformArena();
+	TransformArena(const TransformArena& rhs) = delete;
+	TransformArena& operator=(const TransformArena& rhs) = delete;
+
+	bool Init(int _recordCount);
+	void Release();
+	bool IsCreated();
+
+	// engine side
+	TransformArenaHeader *GetWriteBuffer();
+	TransformArenaHeader *Publish(uint64_t _sequence);
+
+	// shadow thread side, null when nothing new was published since the last call
+	TransformArenaHeader *Acquire();
+	uint64_t GetConsumedSequence();
+
+	static uint32_t *GetDirtyBits(TransformArenaHeader *_buffer);
+	static TransformRecord *GetRecords(TransformArenaHeader *_buffer);
+
+private:
+	static const uint32_t FreshBit = 0x4;	// set on the shared index until the reader takes that buffer
+
+	uint8_t *memory = nullptr;
+	size_t bufferSize = 0;
+	TransformArenaHeader *buffers[NumBuffers];
+
+	atomic<uint32_t> latest;
+	int writeIndex = 0;
+	int readIndex = 0;
+	uint64_t consumedSequence = 0;
+
+	// dirty bits of the last published buffer, kept by the writer since the reader clears the real ones
+	vector<uint32_t> publishedDirty;
+};
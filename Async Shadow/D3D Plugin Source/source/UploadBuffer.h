@@ -1,5 +1,6 @@
 #pragma once
 #include "stdafx.h"
+#include "StreamCopy.h"
 
 template<typename T>
 class UploadBuffer
@@ -64,6 +65,32 @@ public:
 		memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
 	}
 
+	// streams count consecutive elements in order, tightly packed elements go out as one block.
+	// StreamFence() must follow on the same thread before the gpu reads the buffer.
+	void CopyRange(int firstElement, const T* data, int count)
+	{
+		// too short to hold a whole line, plain stores are cheaper
+		if (sizeof(T)*count < 128)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				CopyData(firstElement + i, data[i]);
+			}
+			return;
+		}
+
+		if (mElementByteSize == sizeof(T))
+		{
+			StreamCopy(&mMappedData[firstElement*mElementByteSize], data, sizeof(T)*count);
+			return;
+		}
+
+		for (int i = 0; i < count; i++)
+		{
+			StreamCopy(&mMappedData[(firstElement + i)*mElementByteSize], &data[i], sizeof(T));
+		}
+	}
+
 private:
 	ComPtr<ID3D12Resource> mUploadBuffer;
 	BYTE* mMappedData = nullptr;
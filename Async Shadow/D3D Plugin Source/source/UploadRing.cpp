@@ -0,0 +1,136 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#include "UploadRing.h"
+
+UploadRing::~UploadRing()
+{
+	Release();
+}
+
+bool UploadRing::Init(ID3D12Device *_device, UINT64 _capacity)
+{
+	Release();
+	device = _device;
+	return AddPage(_capacity);
+}
+
+void UploadRing::Release()
+{
+	for (int i = 0; i < (int)pages.size(); i++)
+	{
+		pages[i].resource->Unmap(0, nullptr);
+		SafeReset(pages[i].resource);
+	}
+	pages.clear();
+}
+
+bool UploadRing::Reset()
+{
+	if (pages.empty())
+	{
+		return false;
+	}
+
+	// last frame overflowed, replace the pages with one that holds all of them
+	if (pages.size() > 1)
+	{
+		UINT64 capacity = GetCapacity();
+		Release();
+		if (!AddPage(capacity))
+		{
+			return false;
+		}
+	}
+
+	pages[0].allocator.Reset();
+	return true;
+}
+
+bool UploadRing::Allocate(UINT64 _size, UINT64 _alignment, UploadAllocation &_allocation)
+{
+	if (pages.empty())
+	{
+		return false;
+	}
+
+	UINT64 offset = 0;
+	if (!pages.back().allocator.Allocate(_size, _alignment, offset))
+	{
+		// committed resources start on 64KB, so aligned offsets are aligned addresses as well
+		UINT64 capacity = pages.back().allocator.GetCapacity() * 2;
+		capacity = (capacity > _size + _alignment) ? capacity : _size + _alignment;
+
+		if (!AddPage(capacity) || !pages.back().allocator.Allocate(_size, _alignment, offset))
+		{
+			return false;
+		}
+	}
+
+	Page &page = pages.back();
+	_allocation.cpuAddress = page.mappedData + offset;
+	_allocation.gpuAddress = page.resource->GetGPUVirtualAddress() + offset;
+	_allocation.resource = page.resource.Get();
+	_allocation.offset = offset;
+
+	return true;
+}
+
+UINT64 UploadRing::GetCapacity()
+{
+	UINT64 capacity = 0;
+	for (int i = 0; i < (int)pages.size(); i++)
+	{
+		capacity += pages[i].allocator.GetCapacity();
+	}
+	return capacity;
+}
+
+bool UploadRing::AddPage(UINT64 _capacity)
+{
+	Page page;
+	page.mappedData = nullptr;
+	page.allocator.Init(_capacity);
+
+	HRESULT hr = device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(_capacity),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&page.resource));
+
+	if (FAILED(hr))
+	{
+		return false;
+	}
+
+	hr = page.resource->Map(0, nullptr, reinterpret_cast<void**>(&page.mappedData));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+
+	pages.push_back(page);
+	return true;
+}
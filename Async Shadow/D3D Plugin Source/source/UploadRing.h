@@ -0,0 +1,71 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include "stdafx.h"
+#include "LinearAllocator.h"
+#include <vector>
+using namespace std;
+
+struct UploadAllocation
+{
+	BYTE *cpuAddress;
+	D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+	ID3D12Resource *resource;
+	UINT64 offset;		// from the start of resource, for copies
+};
+
+// transient upload memory of one frame resource, persistently mapped.
+// allocations stay valid until the fence of that frame completes, then Reset() recycles all of them.
+// running out mid frame adds an overflow page, the next Reset() folds the pages into one that fits the whole frame.
+// not thread safe, only the shadow thread allocates.
+class UploadRing
+{
+public:
+	UploadRing() {}
+	~UploadRing();
+	UploadRing(const UploadRing& rhs) = delete;
+	UploadRing& operator=(const UploadRing& rhs) = delete;
+
+	bool Init(ID3D12Device *_device, UINT64 _capacity);
+	void Release();
+
+	// only after the gpu finished the frame that used this ring
+	bool Reset();
+	bool Allocate(UINT64 _size, UINT64 _alignment, UploadAllocation &_allocation);
+
+	UINT64 GetCapacity();
+
+private:
+	struct Page
+	{
+		ComPtr<ID3D12Resource> resource;
+		BYTE *mappedData;
+		LinearAllocator allocator;
+	};
+
+	bool AddPage(UINT64 _capacity);
+
+	ID3D12Device *device = nullptr;
+	vector<Page> pages;
+};
@@ -10,7 +10,6 @@
 #include <wrl.h>
 #include <DirectXMath.h>
 #include <D3Dcompiler.h>
-#include <process.h>
 using namespace DirectX;
 #pragma comment(lib,"D3D12.lib")
 #pragma comment(lib,"D3DCompiler.lib")
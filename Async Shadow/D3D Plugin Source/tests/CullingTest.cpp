@@ -0,0 +1,167 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "ShadowCulling.h"
+#include "TestCommon.h"
+#include <random>
+
+// transposed the same way RenderAPI_D3D12 stores the shadow transform
+static XMFLOAT4X4 ToShadowTransform(FXMMATRIX _viewProj)
+{
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, XMMatrixTranspose(_viewProj));
+	return result;
+}
+
+static XMFLOAT4X4 LightTransform(float _radius)
+{
+	XMMATRIX lightView = XMMatrixLookAtLH(XMVectorSet(0.0f, 50.0f, 0.0f, 0.0f), XMVectorSet(0.3f, 49.0f, 0.2f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+	XMFLOAT3 center;
+	XMStoreFloat3(&center, XMVector3TransformCoord(XMVectorZero(), lightView));
+	XMMATRIX lightProj = XMMatrixOrthographicOffCenterLH(center.x - _radius, center.x + _radius,
+		center.y - _radius, center.y + _radius, center.z - _radius, center.z + _radius);
+
+	return ToShadowTransform(lightView * lightProj);
+}
+
+static void CheckPlane(const XMFLOAT4 &_plane, float _x, float _y, float _z, float _w)
+{
+	CHECK_NEAR(_plane.x, _x, 1e-5);
+	CHECK_NEAR(_plane.y, _y, 1e-5);
+	CHECK_NEAR(_plane.z, _z, 1e-5);
+	CHECK_NEAR(_plane.w, _w, 1e-4);
+}
+
+static void TestPlaneExtraction()
+{
+	// identity view, box x in [-10, 10], y in [-5, 5], z in [0, 100]
+	ShadowCulling culling;
+	culling.SetFrustum(ToShadowTransform(XMMatrixOrthographicOffCenterLH(-10.0f, 10.0f, -5.0f, 5.0f, 0.0f, 100.0f)));
+
+	// outward and normalized, left right bottom top near far
+	const ShadowFrustum &frustum = culling.GetFrustum();
+	CheckPlane(frustum.planes[0], -1.0f, 0.0f, 0.0f, -10.0f);
+	CheckPlane(frustum.planes[1], 1.0f, 0.0f, 0.0f, -10.0f);
+	CheckPlane(frustum.planes[2], 0.0f, -1.0f, 0.0f, -5.0f);
+	CheckPlane(frustum.planes[3], 0.0f, 1.0f, 0.0f, -5.0f);
+	CheckPlane(frustum.planes[4], 0.0f, 0.0f, -1.0f, 0.0f);
+	CheckPlane(frustum.planes[5], 0.0f, 0.0f, 1.0f, -100.0f);
+}
+
+static void TestBoxClassification()
+{
+	ShadowCulling culling;
+
+	// no light yet, everything is accepted
+	CHECK(culling.TestBounds(BoundingBox(XMFLOAT3(1e6f, -1e6f, 1e6f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+
+	culling.SetFrustum(ToShadowTransform(XMMatrixOrthographicOffCenterLH(-10.0f, 10.0f, -5.0f, 5.0f, 0.0f, 100.0f)));
+	XMFLOAT3 unit(1.0f, 1.0f, 1.0f);
+
+	// inside, straddling every plane, and the whole volume inside a big box
+	CHECK(culling.TestBounds(BoundingBox(XMFLOAT3(0.0f, 0.0f, 50.0f), unit)));
+	CHECK(culling.TestBounds(BoundingBox(XMFLOAT3(-10.5f, 0.0f, 50.0f), unit)));
+	CHECK(culling.TestBounds(BoundingBox(XMFLOAT3(10.5f, 0.0f, 50.0f), unit)));
+	CHECK(culling.TestBounds(BoundingBox(XMFLOAT3(0.0f, -5.5f, 50.0f), unit)));
+	CHECK(culling.TestBounds(BoundingBox(XMFLOAT3(0.0f, 5.5f, 50.0f), unit)));
+	CHECK(culling.TestBounds(BoundingBox(XMFLOAT3(0.0f, 0.0f, -0.5f), unit)));
+	CHECK(culling.TestBounds(BoundingBox(XMFLOAT3(0.0f, 0.0f, 100.5f), unit)));
+	CHECK(culling.TestBounds(BoundingBox(XMFLOAT3(0.0f, 0.0f, 50.0f), XMFLOAT3(1000.0f, 1000.0f, 1000.0f))));
+	CHECK(culling.TestBounds(InfiniteBounds));
+
+	// fully outside of each plane
+	CHECK(!culling.TestBounds(BoundingBox(XMFLOAT3(-12.0f, 0.0f, 50.0f), unit)));
+	CHECK(!culling.TestBounds(BoundingBox(XMFLOAT3(12.0f, 0.0f, 50.0f), unit)));
+	CHECK(!culling.TestBounds(BoundingBox(XMFLOAT3(0.0f, -7.0f, 50.0f), unit)));
+	CHECK(!culling.TestBounds(BoundingBox(XMFLOAT3(0.0f, 7.0f, 50.0f), unit)));
+	CHECK(!culling.TestBounds(BoundingBox(XMFLOAT3(0.0f, 0.0f, -2.0f), unit)));
+	CHECK(!culling.TestBounds(BoundingBox(XMFLOAT3(0.0f, 0.0f, 102.0f), unit)));
+}
+
+static void TestKernelsAgree()
+{
+	ShadowCulling culling;
+	culling.SetFrustum(LightTransform(100.0f));
+
+	// odd count so every kernel runs its tail
+	const int count = 10003;
+	ShadowBoundsStore store;
+	store.Resize(count);
+
+	mt19937 rng(1);
+	uniform_real_distribution<float> position(-300.0f, 300.0f);
+	uniform_real_distribution<float> extent(0.5f, 10.0f);
+	for (int i = 0; i < count; i++)
+	{
+		store.SetBounds(i, BoundingBox(XMFLOAT3(position(rng), position(rng) * 0.3f, position(rng)), XMFLOAT3(extent(rng), extent(rng), extent(rng))));
+	}
+	store.SetBounds(0, BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)));
+	store.SetBounds(1, BoundingBox(XMFLOAT3(1000.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)));
+	store.SetBounds(2, InfiniteBounds);
+
+	// reference from the DirectXCollision test
+	vector<int> expected;
+	for (int i = 0; i < count; i++)
+	{
+		if (culling.TestBounds(store.GetBounds(i)))
+		{
+			expected.push_back(i);
+		}
+	}
+	CHECK(expected.size() > 0 && expected.size() < (size_t)count);
+	CHECK(expected[0] == 0 && expected[1] == 2);
+
+	CullingKernel supported = ShadowCulling::GetSupportedKernel();
+	for (int k = CullingKernel_Scalar; k <= supported; k++)
+	{
+		culling.SetKernel((CullingKernel)k);
+		CHECK(culling.GetKernel() == k);
+
+		vector<int> visible;
+		CHECK(culling.Cull(store, visible) == (int)expected.size());
+		CHECK(visible == expected);
+
+		// chunked the way the job system splits it
+		vector<int> chunked;
+		vector<int> chunk(1024 + 8);
+		for (int begin = 0; begin < count; begin += 1024)
+		{
+			int end = (begin + 1024 < count) ? begin + 1024 : count;
+			int n = culling.CullRange(store, begin, end, chunk.data());
+			chunked.insert(chunked.end(), chunk.begin(), chunk.begin() + n);
+		}
+		CHECK(chunked == expected);
+	}
+	printf("kernels up to %d agree on %d of %d visible\n", (int)supported, (int)expected.size(), count);
+}
+
+int main()
+{
+	TestPlaneExtraction();
+	TestBoxClassification();
+	TestKernelsAgree();
+	return TestResult("CullingTest");
+}
@@ -0,0 +1,172 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include "FramePacer.h"
+#include "Threading.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+using namespace std;
+
+// a render queue without a device. a signal completes once the work submitted before it has run,
+// each submit keeps the fake GPU busy for _gpuMs plus up to _jitterMs. waits block on a futex word like fence events do.
+class FakeFence : public FrameFence
+{
+public:
+	static const int MaxSlots = 8;
+
+	FakeFence(float _gpuMs, float _jitterMs, unsigned _seed)
+		: gpuMs(_gpuMs), jitterMs(_jitterMs), rng(_seed), completed(0), word(0), quit(false)
+	{
+		for (int i = 0; i < MaxSlots; i++)
+		{
+			waits[i] = 0;
+		}
+		gpu = thread(&FakeFence::Run, this);
+	}
+
+	~FakeFence()
+	{
+		{
+			lock_guard<mutex> lock(queueMutex);
+			quit = true;
+		}
+		queueCv.notify_one();
+		gpu.join();
+	}
+
+	FakeFence(const FakeFence& rhs) = delete;
+	FakeFence& operator=(const FakeFence& rhs) = delete;
+
+	bool Signal(uint64_t _value) override
+	{
+		{
+			lock_guard<mutex> lock(queueMutex);
+			if (_value < lastSignaled)
+			{
+				backwardSignals++;
+			}
+			lastSignaled = _value;
+			pending.push_back(_value);
+		}
+		queueCv.notify_one();
+		return true;
+	}
+
+	uint64_t GetCompletedValue() override
+	{
+		return completed.load(memory_order_acquire);
+	}
+
+	bool Wait(int _slot, uint64_t _value) override
+	{
+		if (_slot < 0 || _slot >= MaxSlots)
+		{
+			return false;
+		}
+
+		waits[_slot]++;
+		while (completed.load(memory_order_acquire) < _value)
+		{
+			uint32_t w = word.load(memory_order_acquire);
+			if (completed.load(memory_order_acquire) >= _value)
+			{
+				break;
+			}
+			FutexWait(&word, w);
+		}
+		return true;
+	}
+
+	int GetWaits(int _slot)
+	{
+		return waits[_slot].load();
+	}
+
+	uint64_t GetLastSignaled()
+	{
+		lock_guard<mutex> lock(queueMutex);
+		return lastSignaled;
+	}
+
+	// signals that went below an earlier one, fence values must only grow
+	int GetBackwardSignals()
+	{
+		lock_guard<mutex> lock(queueMutex);
+		return backwardSignals;
+	}
+
+private:
+	void Run()
+	{
+		auto busyUntil = chrono::steady_clock::now();
+		while (true)
+		{
+			uint64_t value;
+			{
+				unique_lock<mutex> lock(queueMutex);
+				queueCv.wait(lock, [this]() { return quit || !pending.empty(); });
+				if (quit)
+				{
+					return;
+				}
+				value = pending.front();
+				pending.pop_front();
+			}
+
+			// the work in front of this signal starts when it was submitted or when the previous one finished
+			float ms = gpuMs + ((jitterMs > 0.0f) ? uniform_real_distribution<float>(0.0f, jitterMs)(rng) : 0.0f);
+			auto now = chrono::steady_clock::now();
+			busyUntil = ((busyUntil > now) ? busyUntil : now) + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<float, milli>(ms));
+			this_thread::sleep_until(busyUntil);
+
+			if (value > completed.load(memory_order_relaxed))
+			{
+				completed.store(value, memory_order_release);
+			}
+			word.fetch_add(1, memory_order_release);
+			FutexWakeAll(&word);
+		}
+	}
+
+	float gpuMs;
+	float jitterMs;
+	mt19937 rng;
+
+	atomic<uint64_t> completed;
+	atomic<uint32_t> word;
+	atomic<int> waits[MaxSlots];
+
+	mutex queueMutex;
+	condition_variable queueCv;
+	deque<uint64_t> pending;
+	uint64_t lastSignaled = 0;
+	int backwardSignals = 0;
+	bool quit;
+
+	thread gpu;
+};
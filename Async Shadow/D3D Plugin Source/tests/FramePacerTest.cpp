@@ -0,0 +1,185 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "FakeFence.h"
+#include "FramePacer.h"
+#include "TestCommon.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+using namespace std;
+
+// FramePacer against a fake queue, the same bookkeeping RenderAPI_D3D12 runs on the D3D12 fence
+static const int NumFrames = 3;
+
+// runs _frames frames of _cpuMs each and checks what has to hold after every NextFrame()
+static FenceStats RunFrames(FakeFence &_fence, FramePacer &_pacer, int _frames, float _cpuMs)
+{
+	// stats are read from another thread while frames run, like GetFenceStats() from the main thread
+	atomic<bool> done(false);
+	thread reader([&]()
+	{
+		while (!done.load())
+		{
+			FenceStats stats = _pacer.GetStats(false);
+			CHECK(stats.spinResolved <= stats.stalls);
+			this_thread::sleep_for(chrono::microseconds(200));
+		}
+	});
+
+	int expectedIndex = _pacer.GetFrameIndex();
+	for (int f = 0; f < _frames; f++)
+	{
+		this_thread::sleep_for(chrono::duration<float, milli>(_cpuMs));
+		CHECK(_pacer.NextFrame());
+
+		// the slot we move to is free again, at most the other slots are still in flight
+		expectedIndex = (expectedIndex + 1) % NumFrames;
+		CHECK(_pacer.GetFrameIndex() == expectedIndex);
+		CHECK(_fence.GetLastSignaled() <= _fence.GetCompletedValue() + NumFrames - 1);
+	}
+
+	done = true;
+	reader.join();
+	return _pacer.GetStats(true);
+}
+
+static int TotalWaits(FakeFence &_fence)
+{
+	int waits = 0;
+	for (int i = 0; i < FakeFence::MaxSlots; i++)
+	{
+		waits += _fence.GetWaits(i);
+	}
+	return waits;
+}
+
+static void TestGpuBound()
+{
+	// the GPU takes twice the CPU frame, NextFrame has to stall and block on the slot it moves to
+	FakeFence fence(2.0f, 0.2f, 3);
+	FramePacer pacer;
+	pacer.Init(&fence, NumFrames, 1);
+	pacer.SetSpinTime(0.0f);
+
+	FenceStats stats = RunFrames(fence, pacer, 100, 1.0f);
+	CHECK(stats.frames == 100);
+	CHECK(stats.stalls > 50);
+	CHECK(stats.spinResolved == 0);
+	CHECK(stats.stallMs > 0.0);
+	CHECK(stats.maxStallMs > 0.0 && stats.maxStallMs <= stats.stallMs);
+	CHECK((int)stats.stalls == TotalWaits(fence));
+	for (int i = NumFrames; i < FakeFence::MaxSlots; i++)
+	{
+		CHECK(fence.GetWaits(i) == 0);
+	}
+	CHECK(fence.GetBackwardSignals() == 0);
+
+	// the window was reset
+	FenceStats reset = pacer.GetStats(false);
+	CHECK(reset.frames == 0 && reset.stalls == 0 && reset.spinResolved == 0 && reset.stallMs == 0.0 && reset.maxStallMs == 0.0);
+
+	// flushing every slot drains the queue
+	for (int i = 0; i < NumFrames; i++)
+	{
+		CHECK(pacer.Flush(i));
+	}
+	CHECK(fence.GetCompletedValue() == fence.GetLastSignaled());
+	CHECK(fence.GetBackwardSignals() == 0);
+}
+
+static void TestSpin()
+{
+	// a spin longer than the GPU frame catches every stall before it blocks
+	FakeFence fence(1.0f, 0.0f, 5);
+	FramePacer pacer;
+	pacer.Init(&fence, NumFrames, 1);
+	pacer.SetSpinTime(20000.0f);
+
+	FenceStats stats = RunFrames(fence, pacer, 60, 0.0f);
+	CHECK(stats.frames == 60);
+	CHECK(stats.stalls > 0);
+	CHECK(stats.spinResolved == stats.stalls);
+	CHECK(TotalWaits(fence) == 0);
+
+	for (int i = 0; i < NumFrames; i++)
+	{
+		CHECK(pacer.Flush(i));
+	}
+	CHECK(fence.GetCompletedValue() == fence.GetLastSignaled());
+}
+
+static void TestCpuBound()
+{
+	// the GPU keeps up, only a frame that lands right on a signal may stall
+	FakeFence fence(0.0f, 0.0f, 7);
+	FramePacer pacer;
+	pacer.Init(&fence, NumFrames, 1);
+
+	FenceStats stats = RunFrames(fence, pacer, 100, 1.0f);
+	CHECK(stats.frames == 100);
+	CHECK(stats.stalls < 20);
+	CHECK(fence.GetBackwardSignals() == 0);
+}
+
+static void TestReinit()
+{
+	// CreateResources flushes and starts the pacer again on the same fence, values keep growing
+	FakeFence fence(0.5f, 0.0f, 9);
+	FramePacer pacer;
+	pacer.Init(&fence, NumFrames, 1);
+	RunFrames(fence, pacer, 20, 0.0f);
+
+	for (int i = 0; i < NumFrames; i++)
+	{
+		CHECK(pacer.Flush(i));
+	}
+	uint64_t last = fence.GetLastSignaled();
+	pacer.Init(&fence, NumFrames, last + 1);
+	CHECK(pacer.GetFrameIndex() == 0);
+
+	RunFrames(fence, pacer, 20, 0.0f);
+	for (int i = 0; i < NumFrames; i++)
+	{
+		CHECK(pacer.Flush(i));
+	}
+	CHECK(fence.GetLastSignaled() > last);
+	CHECK(fence.GetCompletedValue() == fence.GetLastSignaled());
+	CHECK(fence.GetBackwardSignals() == 0);
+
+	// without a fence nothing happens
+	FramePacer idle;
+	CHECK(!idle.NextFrame());
+	CHECK(!idle.Flush(0));
+}
+
+int main()
+{
+	TestGpuBound();
+	TestSpin();
+	TestCpuBound();
+	TestReinit();
+	return TestResult("FramePacerTest");
+}
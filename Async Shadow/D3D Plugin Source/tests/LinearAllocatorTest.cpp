@@ -0,0 +1,200 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "LinearAllocator.h"
+#include "TestCommon.h"
+#include <random>
+#include <string.h>
+#include <vector>
+using namespace std;
+
+// the bump allocator under UploadRing, backed by plain host memory
+static void TestAlignment()
+{
+	LinearAllocator allocator;
+	allocator.Init(4096);
+
+	mt19937 rng(3);
+	uint64_t previousEnd = 0;
+	uint64_t offset = 0;
+	int allocations = 0;
+	for (; allocations < 4096; allocations++)
+	{
+		uint64_t alignment = 1ull << (rng() % 9);
+		uint64_t size = 1 + rng() % 100;
+		if (!allocator.Allocate(size, alignment, offset))
+		{
+			break;
+		}
+
+		// aligned, past the previous allocation, inside the block
+		CHECK(offset % alignment == 0);
+		CHECK(offset >= previousEnd);
+		CHECK(offset + size <= allocator.GetCapacity());
+		CHECK(allocator.GetUsed() == offset + size);
+		previousEnd = offset + size;
+	}
+
+	// runs out long before every allocation is one byte
+	CHECK(allocations > 0 && allocations < 4096);
+}
+
+static void TestExhaustion()
+{
+	LinearAllocator allocator;
+	allocator.Init(256);
+
+	uint64_t offset = 0;
+	CHECK(allocator.Allocate(200, 8, offset) && offset == 0);
+
+	// the aligned start is past what's left, the allocator stays as it was
+	CHECK(!allocator.Allocate(56, 256, offset));
+	CHECK(allocator.GetUsed() == 200);
+
+	// exactly what's left fits, one more byte doesn't
+	CHECK(!allocator.Allocate(57, 8, offset));
+	CHECK(allocator.Allocate(56, 8, offset) && offset == 200);
+	CHECK(allocator.GetUsed() == 256);
+	CHECK(!allocator.Allocate(1, 1, offset));
+
+	// sizes near the top of the range must not wrap the bounds check
+	allocator.Reset();
+	CHECK(!allocator.Allocate(UINT64_MAX, 1, offset));
+	CHECK(!allocator.Allocate(UINT64_MAX - 8, 16, offset));
+	CHECK(allocator.GetUsed() == 0);
+
+	// a zero sized block never hands anything out but empty allocations
+	LinearAllocator empty;
+	empty.Init(0);
+	CHECK(!empty.Allocate(1, 1, offset));
+	CHECK(empty.Allocate(0, 1, offset) && offset == 0);
+}
+
+// one allocator per frame resource, reset only once the simulated gpu is done with that frame.
+// the gpu lags two frames behind or more and checks every allocation still holds what was written into it,
+// each allocation gets its own byte so overlapping ones show up too.
+static void TestFrameReuse()
+{
+	const int numFrames = 3;
+	const uint64_t capacity = 64 * 1024;
+
+	struct Frame
+	{
+		vector<uint8_t> memory;
+		LinearAllocator allocator;
+		vector<uint64_t> offsets;
+		vector<uint64_t> sizes;
+		vector<uint8_t> tags;
+		uint64_t fenceValue = 0;
+	};
+
+	Frame frames[numFrames];
+	for (int i = 0; i < numFrames; i++)
+	{
+		frames[i].memory.resize(capacity);
+		frames[i].allocator.Init(capacity);
+	}
+
+	mt19937 rng(11);
+	uint64_t completedFence = 0;
+	uint64_t fence = 0;
+	int corrupted = 0;
+	int exhaustedFrames = 0;
+	int waits = 0;
+
+	auto gpuComplete = [&](Frame &_frame)
+	{
+		for (size_t a = 0; a < _frame.offsets.size(); a++)
+		{
+			const uint8_t *data = _frame.memory.data() + _frame.offsets[a];
+			for (uint64_t b = 0; b < _frame.sizes[a]; b++)
+			{
+				corrupted += (data[b] != _frame.tags[a]) ? 1 : 0;
+			}
+		}
+		completedFence = _frame.fenceValue;
+	};
+
+	for (int f = 0; f < 300; f++)
+	{
+		Frame &frame = frames[f % numFrames];
+
+		// wait for the fence of the last use of this frame resource, then recycle it
+		if (frame.fenceValue > completedFence)
+		{
+			gpuComplete(frame);
+			waits++;
+		}
+		frame.allocator.Reset();
+		frame.offsets.clear();
+		frame.sizes.clear();
+		frame.tags.clear();
+
+		// every 10th frame asks for more than fits, the rest stays inside
+		uint64_t budget = (f % 10 == 9) ? capacity * 2 : capacity / 2;
+		uint64_t asked = 0;
+		uint64_t offset = 0;
+		bool exhausted = false;
+		while (asked < budget)
+		{
+			uint64_t size = 16 + rng() % 2048;
+			asked += size;
+			if (!frame.allocator.Allocate(size, 256, offset))
+			{
+				exhausted = true;
+				break;
+			}
+
+			uint8_t tag = (uint8_t)(f * 7 + frame.offsets.size() + 1);
+			memset(frame.memory.data() + offset, tag, size);
+			frame.offsets.push_back(offset);
+			frame.sizes.push_back(size);
+			frame.tags.push_back(tag);
+		}
+		exhaustedFrames += exhausted ? 1 : 0;
+
+		frame.fenceValue = ++fence;
+
+		// the gpu finishes the frame from two frames ago, unless it's running late
+		Frame &oldest = frames[(f + 1) % numFrames];
+		if (oldest.fenceValue > completedFence && oldest.fenceValue + 2 <= fence && rng() % 4 != 0)
+		{
+			gpuComplete(oldest);
+		}
+	}
+
+	// the frame resources wrap around 100 times, the gpu is still busy with some of them when they come back
+	CHECK(corrupted == 0);
+	CHECK(waits > 0);
+	CHECK(exhaustedFrames == 30);
+}
+
+int main()
+{
+	TestAlignment();
+	TestExhaustion();
+	TestFrameReuse();
+	return TestResult("LinearAllocatorTest");
+}
@@ -0,0 +1,348 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "SceneSnapshot.h"
+#include "TestCommon.h"
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// every field the producer writes for frame f holds f, so a snapshot mixing two frames shows up as a non uniform field
+static bool Uniform(const float *_values, int _count, float &_value)
+{
+	_value = _values[0];
+	for (int i = 1; i < _count; i++)
+	{
+		if (_values[i] != _value)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void FillMatrix(XMFLOAT4X4 &_m, float _value)
+{
+	for (int i = 0; i < 16; i++)
+	{
+		(&_m._11)[i] = _value;
+	}
+}
+
+// the consumer side of ShadowMap::ConsumeSceneSnapshot, bounds first then transforms
+struct SceneState
+{
+	vector<float> world;
+	vector<float> bounds;
+	uint64_t lastSequence = 0;
+	int torn = 0;
+	int backInTime = 0;
+	int badSequence = 0;
+
+	explicit SceneState(int _objects) : world(_objects, 0.0f), bounds(_objects, 0.0f)
+	{
+	}
+
+	void Apply(const SceneSnapshot &_scene)
+	{
+		if (_scene.sequence <= lastSequence)
+		{
+			badSequence++;
+		}
+		lastSequence = _scene.sequence;
+
+		float view, corners;
+		if (!Uniform(&_scene.shadowTransform._11, 16, view) || !Uniform(&_scene.cameraCorners[0].x, 24, corners) || corners != view)
+		{
+			torn++;
+		}
+
+		vector<float> before = bounds;
+		for (const SceneBounds &b : _scene.bounds)
+		{
+			float center, extents;
+			if (!Uniform(&b.center.x, 3, center) || !Uniform(&b.extents.x, 3, extents) || center != extents)
+			{
+				torn++;
+			}
+			bounds[b.index] = center;
+		}
+
+		for (size_t i = 0; i < _scene.transformIndex.size(); i++)
+		{
+			float value;
+			if (!Uniform(&_scene.transformWorld[i]._11, 16, value))
+			{
+				torn++;
+			}
+
+			int idx = _scene.transformIndex[i];
+			if (idx < 0)
+			{
+				continue;
+			}
+
+			if (value < world[idx])
+			{
+				backInTime++;
+			}
+			world[idx] = value;
+		}
+
+		// skipped bounds go out again in front of the newer ones, only the state after the whole snapshot has to move forward
+		for (size_t i = 0; i < bounds.size(); i++)
+		{
+			if (bounds[i] < before[i])
+			{
+				backInTime++;
+			}
+		}
+	}
+};
+
+static void TestSkipped()
+{
+	SceneSnapshotBuffer buffer;
+	CHECK(buffer.Acquire() == nullptr);
+
+	// three frames published while the consumer is busy, it only sees the last one
+	FillMatrix(*buffer.AddTransforms(0, 1), 1.0f);
+	FillMatrix(*buffer.AddTransforms(1, 1), 1.0f);
+	buffer.AddBounds(2, XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 1.0f));
+	buffer.Publish();
+
+	FillMatrix(*buffer.AddTransforms(1, 1), 2.0f);
+	buffer.AddBounds(2, XMFLOAT3(2.0f, 2.0f, 2.0f), XMFLOAT3(2.0f, 2.0f, 2.0f));
+	buffer.Publish();
+
+	FillMatrix(buffer.GetWriteBuffer().shadowTransform, 3.0f);
+	int indices[] = { 3, -1 };
+	XMFLOAT4X4 *m = buffer.AddTransforms(indices, 2);
+	FillMatrix(m[0], 3.0f);
+	FillMatrix(m[1], 3.0f);
+	uint64_t last = buffer.Publish();
+
+	const SceneSnapshot *scene = buffer.Acquire();
+	CHECK(scene != nullptr);
+	if (scene == nullptr)
+	{
+		return;
+	}
+	CHECK(scene->sequence == last);
+	CHECK(buffer.Acquire() == nullptr);
+
+	SceneState state(4);
+	state.Apply(*scene);
+	CHECK(state.world[0] == 1.0f);
+	CHECK(state.world[1] == 2.0f);
+	CHECK(state.world[3] == 3.0f);
+	CHECK(state.bounds[2] == 2.0f);
+	CHECK(state.backInTime == 0);
+
+	// view state carries over and stays readable after the snapshot was taken
+	CHECK(buffer.GetReadBuffer().shadowTransform._11 == 3.0f);
+	CHECK(buffer.GetWriteBuffer().shadowTransform._11 == 3.0f);
+	CHECK(buffer.GetWriteBuffer().transformIndex.empty());
+	CHECK(buffer.GetWriteBuffer().bounds.empty());
+
+	buffer.Reset();
+	CHECK(buffer.Acquire() == nullptr);
+	CHECK(buffer.GetWriteBuffer().shadowTransform._11 == 1.0f);
+}
+
+// single threaded, every interleaving of publishes and reads on a few objects must end on the newest values
+static void TestInterleavings()
+{
+	const int objects = 4;
+	for (int seed = 1; seed < 2000; seed++)
+	{
+		mt19937 rng(seed);
+		SceneSnapshotBuffer buffer;
+		SceneState state(objects);
+		vector<float> expectedWorld(objects, 0.0f);
+		vector<float> expectedBounds(objects, 0.0f);
+
+		for (int f = 1; f <= 12; f++)
+		{
+			int idx = rng() % objects;
+			FillMatrix(*buffer.AddTransforms(idx, 1), (float)f);
+			expectedWorld[idx] = (float)f;
+
+			if (rng() % 3 == 0)
+			{
+				int b = rng() % objects;
+				buffer.AddBounds(b, XMFLOAT3((float)f, (float)f, (float)f), XMFLOAT3((float)f, (float)f, (float)f));
+				expectedBounds[b] = (float)f;
+			}
+
+			FillMatrix(buffer.GetWriteBuffer().shadowTransform, (float)f);
+			for (int i = 0; i < 8; i++)
+			{
+				buffer.GetWriteBuffer().cameraCorners[i] = XMFLOAT3((float)f, (float)f, (float)f);
+			}
+			buffer.Publish();
+
+			if (rng() % 3 == 0)
+			{
+				const SceneSnapshot *scene = buffer.Acquire();
+				if (scene != nullptr)
+				{
+					state.Apply(*scene);
+				}
+			}
+		}
+
+		// null when the last publish was read already
+		const SceneSnapshot *scene = buffer.Acquire();
+		if (scene != nullptr)
+		{
+			state.Apply(*scene);
+		}
+
+		CHECK(state.world == expectedWorld);
+		CHECK(state.bounds == expectedBounds);
+		CHECK(state.torn == 0 && state.backInTime == 0 && state.badSequence == 0);
+	}
+}
+
+// engine thread publishing as fast as it can, shadow thread reading with random stalls
+static void TestStress()
+{
+	const int frames = 20000;
+	const int objects = 4096;
+	SceneSnapshotBuffer buffer;
+	SceneState state(objects);
+	vector<float> expectedWorld(objects, 0.0f);
+	vector<float> expectedBounds(objects, 0.0f);
+	atomic<bool> done(false);
+
+	thread consumer([&]()
+	{
+		mt19937 rng(2);
+		while (!done.load())
+		{
+			const SceneSnapshot *scene = buffer.Acquire();
+			if (scene == nullptr)
+			{
+				continue;
+			}
+
+			state.Apply(*scene);
+
+			// a held snapshot must not change while the engine keeps publishing
+			if (rng() % 8 == 0)
+			{
+				uint64_t sequence = scene->sequence;
+				float view = scene->shadowTransform._11;
+				size_t transforms = scene->transformIndex.size();
+				this_thread::sleep_for(chrono::microseconds(rng() % 50));
+				if (scene->sequence != sequence || scene->shadowTransform._11 != view || scene->transformIndex.size() != transforms)
+				{
+					state.torn++;
+				}
+			}
+		}
+
+		const SceneSnapshot *scene = buffer.Acquire();
+		if (scene != nullptr)
+		{
+			state.Apply(*scene);
+		}
+	});
+
+	mt19937 rng(1);
+	for (int f = 1; f <= frames; f++)
+	{
+		float value = (float)f;
+		SceneSnapshot &scene = buffer.GetWriteBuffer();
+
+		// the view is left alone on some frames, it has to carry over whole
+		if (f % 3 != 0)
+		{
+			FillMatrix(scene.shadowTransform, value);
+			for (int i = 0; i < 8; i++)
+			{
+				scene.cameraCorners[i] = XMFLOAT3(value, value, value);
+			}
+		}
+
+		int ranges = rng() % 4;
+		for (int r = 0; r < ranges; r++)
+		{
+			int first = rng() % (objects - 8);
+			int count = 1 + rng() % 8;
+			XMFLOAT4X4 *m = buffer.AddTransforms(first, count);
+			for (int i = 0; i < count; i++)
+			{
+				FillMatrix(m[i], value);
+				expectedWorld[first + i] = value;
+			}
+		}
+
+		if (rng() % 2)
+		{
+			int indices[] = { (int)(rng() % objects), (int)(rng() % objects), -1 };
+			XMFLOAT4X4 *m = buffer.AddTransforms(indices, 3);
+			for (int i = 0; i < 3; i++)
+			{
+				FillMatrix(m[i], value);
+				if (indices[i] >= 0)
+				{
+					expectedWorld[indices[i]] = value;
+				}
+			}
+		}
+
+		if (rng() % 4 == 0)
+		{
+			int idx = rng() % objects;
+			buffer.AddBounds(idx, XMFLOAT3(value, value, value), XMFLOAT3(value, value, value));
+			expectedBounds[idx] = value;
+		}
+
+		buffer.Publish();
+	}
+
+	done = true;
+	consumer.join();
+
+	CHECK(state.torn == 0);
+	CHECK(state.backInTime == 0);
+	CHECK(state.badSequence == 0);
+	CHECK(state.lastSequence == (uint64_t)frames);
+	CHECK(state.world == expectedWorld);
+	CHECK(state.bounds == expectedBounds);
+}
+
+int main()
+{
+	TestSkipped();
+	TestInterleavings();
+	TestStress();
+	return TestResult("SceneSnapshotTest");
+}
@@ -0,0 +1,231 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "FakeFence.h"
+#include "FramePacer.h"
+#include "JobSystem.h"
+#include "Threading.h"
+#include "TestCommon.h"
+#include <memory>
+#include <random>
+#include <vector>
+#ifdef __linux__
+#include <dirent.h>
+#endif
+using namespace std;
+
+// the resource lifetime of RenderAPI_D3D12 without a device, 1000 create/release cycles with frames in between.
+// Scene stands in for the ShadowMap, FakeFence for the render queue. the queue outlives the cycles here.
+static const int NumFrames = 3;
+
+struct Scene
+{
+	vector<float> data;
+	bool alive;
+
+	Scene() : data(4096, 1.0f), alive(true)
+	{
+	}
+
+	~Scene()
+	{
+		alive = false;
+	}
+};
+
+struct FakeApi
+{
+	FakeFence fence;
+	FramePacer pacer;
+	unique_ptr<Scene> scene;
+	JobSystem jobs;
+	ShadowWorker worker;
+	atomic<int> frames;
+	atomic<int> badFrames;		// frames that ran without a live scene
+	int gpuBusyOnReplace = 0;	// scenes replaced or freed while the GPU still had frames of them
+
+	FakeApi() : fence(0.3f, 0.2f, 11), frames(0), badFrames(0)
+	{
+		pacer.Init(&fence, NumFrames, 1);
+	}
+
+	// RenderAPI_D3D12::CreateResources
+	void CreateResources()
+	{
+		worker.Stop();
+		if (scene != nullptr)
+		{
+			for (int i = 0; i < NumFrames; i++)
+			{
+				pacer.Flush(i);
+			}
+		}
+
+		CheckGpuIdle();
+		scene = make_unique<Scene>();
+		jobs.Init(2);
+		worker.Start([this]() { Execute(); });
+	}
+
+	// RenderAPI_D3D12::ReleaseResources
+	void ReleaseResources()
+	{
+		worker.Stop();
+		for (int i = 0; i < NumFrames; i++)
+		{
+			pacer.Flush(i);
+		}
+
+		CheckGpuIdle();
+		scene.reset();
+		jobs.Shutdown();
+	}
+
+	// RenderAPI_D3D12::NotifyShadowThread
+	void NotifyShadowThread(bool _multithread, float _delayMs)
+	{
+		if (scene == nullptr)
+		{
+			return;
+		}
+
+		if (_multithread)
+		{
+			worker.Start([this]() { Execute(); });
+			worker.Notify(_delayMs);
+		}
+		else
+		{
+			worker.Stop();
+			Execute();
+		}
+	}
+
+	void Execute()
+	{
+		Scene *s = scene.get();
+		if (s == nullptr || !s->alive)
+		{
+			badFrames++;
+			return;
+		}
+
+		jobs.ParallelFor((int)s->data.size(), 512, [s](int _begin, int _end, int)
+		{
+			for (int i = _begin; i < _end; i++)
+			{
+				s->data[i] += 1.0f;
+			}
+		});
+		pacer.NextFrame();
+		frames++;
+	}
+
+	void CheckGpuIdle()
+	{
+		if (scene != nullptr && fence.GetCompletedValue() < fence.GetLastSignaled())
+		{
+			gpuBusyOnReplace++;
+		}
+	}
+};
+
+// threads of this process, -1 where that can't be read
+static int CountThreads()
+{
+#ifdef __linux__
+	DIR *dir = opendir("/proc/self/task");
+	if (dir == nullptr)
+	{
+		return -1;
+	}
+
+	int count = 0;
+	while (dirent *entry = readdir(dir))
+	{
+		count += (entry->d_name[0] != '.') ? 1 : 0;
+	}
+	closedir(dir);
+	return count;
+#else
+	return -1;
+#endif
+}
+
+int main()
+{
+	const int cycles = 1000;
+	mt19937 rng(1);
+	int baseThreads = CountThreads();
+
+	{
+		FakeApi api;
+		int fenceThreads = CountThreads();
+		for (int c = 0; c < cycles; c++)
+		{
+			api.CreateResources();
+			CHECK(api.worker.IsRunning());
+
+			// the script and the device event may both create, the second one replaces the first with frames in flight
+			if (rng() % 4 == 0)
+			{
+				int frames = 1 + rng() % 2;
+				for (int f = 0; f < frames; f++)
+				{
+					api.NotifyShadowThread(rng() % 2 == 0, 0.0f);
+				}
+				api.CreateResources();
+				CHECK(api.worker.IsRunning());
+			}
+
+			// single and multi threaded frames mixed, some with fake load the release has to cut short
+			int frames = rng() % 6;
+			for (int f = 0; f < frames; f++)
+			{
+				api.NotifyShadowThread(rng() % 5 != 0, (rng() % 3 == 0) ? 0.2f : 0.0f);
+			}
+
+			api.ReleaseResources();
+			CHECK(!api.worker.IsRunning());
+			CHECK(baseThreads < 0 || CountThreads() == fenceThreads);
+
+			// a second release and a frame after release do nothing
+			if (rng() % 4 == 0)
+			{
+				api.ReleaseResources();
+				api.NotifyShadowThread(true, 0.0f);
+				CHECK(!api.worker.IsRunning());
+			}
+		}
+
+		CHECK(api.frames > 0);
+		CHECK(api.badFrames == 0);
+		CHECK(api.gpuBusyOnReplace == 0);
+		CHECK(api.fence.GetBackwardSignals() == 0);
+	}
+
+	CHECK(baseThreads < 0 || CountThreads() == baseThreads);
+	return TestResult("ShadowWorkerTest");
+}
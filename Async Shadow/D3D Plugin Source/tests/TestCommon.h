@@ -0,0 +1,47 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include <cstdio>
+#include <cmath>
+
+// tiny check helpers, a failed check prints where it failed and the test returns non-zero
+static int testFailures = 0;
+
+#define CHECK(_cond) \
+	do \
+	{ \
+		if (!(_cond)) \
+		{ \
+			printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #_cond); \
+			testFailures++; \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(_a, _b, _eps) CHECK(fabs((double)(_a) - (double)(_b)) <= (_eps))
+
+static int TestResult(const char *_name)
+{
+	printf("%s: %s\n", _name, (testFailures == 0) ? "passed" : "FAILED");
+	return (testFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,229 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "ShadowTransform.h"
+#include "TestCommon.h"
+#include <random>
+#include <string.h>
+#include <vector>
+using namespace std;
+
+// every batch path against XMMatrixTranspose(S * R * T) composed one object at a time
+struct Transforms
+{
+	vector<float> column[10];	// pos xyz, rot xyzw, scale xyz
+
+	TransformStreams GetStreams()
+	{
+		TransformStreams streams = { column[0].data(), column[1].data(), column[2].data(),
+			column[3].data(), column[4].data(), column[5].data(), column[6].data(),
+			column[7].data(), column[8].data(), column[9].data() };
+		return streams;
+	}
+
+	TransformRecord GetRecord(int _index)
+	{
+		TransformRecord record;
+		record.position = XMFLOAT3(column[0][_index], column[1][_index], column[2][_index]);
+		record.rotation = XMFLOAT4(column[3][_index], column[4][_index], column[5][_index], column[6][_index]);
+		record.scale = XMFLOAT3(column[7][_index], column[8][_index], column[9][_index]);
+		return record;
+	}
+
+	XMFLOAT4X4 GetReference(int _index)
+	{
+		TransformRecord r = GetRecord(_index);
+		XMMATRIX m = XMMatrixScaling(r.scale.x, r.scale.y, r.scale.z)
+			* XMMatrixRotationQuaternion(XMLoadFloat4(&r.rotation))
+			* XMMatrixTranslation(r.position.x, r.position.y, r.position.z);
+
+		XMFLOAT4X4 result;
+		XMStoreFloat4x4(&result, XMMatrixTranspose(m));
+		return result;
+	}
+};
+
+static Transforms MakeTransforms(int _count, mt19937 &_rng)
+{
+	uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	Transforms t;
+	for (int c = 0; c < 10; c++)
+	{
+		t.column[c].resize(_count);
+	}
+
+	for (int i = 0; i < _count; i++)
+	{
+		float q[4], length = 0.0f;
+		for (int k = 0; k < 4; k++)
+		{
+			q[k] = unit(_rng);
+			length += q[k] * q[k];
+		}
+		length = sqrtf(length);
+
+		for (int k = 0; k < 3; k++)
+		{
+			t.column[k][i] = unit(_rng) * 500.0f;
+			t.column[7 + k][i] = unit(_rng) * 5.0f + 6.0f;
+		}
+		for (int k = 0; k < 4; k++)
+		{
+			t.column[3 + k][i] = q[k] / length;
+		}
+	}
+
+	return t;
+}
+
+static float MaxError(const float *_result, const XMFLOAT4X4 &_reference, int _rows)
+{
+	float maxError = 0.0f;
+	for (int r = 0; r < _rows; r++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			maxError = fmaxf(maxError, fabsf(_result[r * 4 + c] - _reference.m[r][c]));
+		}
+	}
+	return maxError;
+}
+
+// counts around the 4 and 8 wide steps, and one long run
+static const int counts[] = { 0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 1001 };
+
+static void TestStreams(mt19937 &_rng)
+{
+	// ObjectData (3 rows, 52 bytes), a tight 4x4, and ObjectConstants (4 rows, 256 bytes)
+	const size_t strides[] = { 52, 64, 256 };
+	const int rows[] = { 3, 4, 4 };
+	const unsigned char fill = 0xAB;
+
+	for (int count : counts)
+	{
+		for (int s = 0; s < 3; s++)
+		{
+			Transforms t = MakeTransforms(count, _rng);
+			size_t stride = strides[s];
+			vector<unsigned char> dst(stride * (count + 1), fill);
+			ComposeTransposedTRS(t.GetStreams(), count, dst.data(), stride, rows[s]);
+
+			float maxError = 0.0f;
+			int clobbered = 0;
+			for (int i = 0; i < count; i++)
+			{
+				maxError = fmaxf(maxError, MaxError((const float*)(dst.data() + i * stride), t.GetReference(i), rows[s]));
+
+				// padding after the rows and the slot past the end stay untouched
+				for (size_t b = rows[s] * 16; b < stride; b++)
+				{
+					clobbered += (dst[i * stride + b] != fill) ? 1 : 0;
+				}
+			}
+			for (size_t b = 0; b < stride; b++)
+			{
+				clobbered += (dst[count * stride + b] != fill) ? 1 : 0;
+			}
+
+			CHECK(maxError <= 1e-4f);
+			CHECK(clobbered == 0);
+		}
+	}
+}
+
+static void TestPacked(mt19937 &_rng)
+{
+	for (int count : counts)
+	{
+		Transforms t = MakeTransforms(count, _rng);
+		vector<float> pos(count * 3), scale(count * 3), rot(count * 4);
+		for (int i = 0; i < count; i++)
+		{
+			TransformRecord r = t.GetRecord(i);
+			memcpy(&pos[i * 3], &r.position, sizeof(XMFLOAT3));
+			memcpy(&scale[i * 3], &r.scale, sizeof(XMFLOAT3));
+			memcpy(&rot[i * 4], &r.rotation, sizeof(XMFLOAT4));
+		}
+
+		vector<XMFLOAT4X4> out(count + 1);
+		memset(out.data(), 0, sizeof(XMFLOAT4X4) * out.size());
+		ComposeTransposedTRS(pos.data(), scale.data(), rot.data(), count, out.data());
+
+		float maxError = 0.0f;
+		for (int i = 0; i < count; i++)
+		{
+			maxError = fmaxf(maxError, MaxError(&out[i]._11, t.GetReference(i), 4));
+		}
+		CHECK(maxError <= 1e-4f);
+		CHECK(out[count]._11 == 0.0f && out[count]._44 == 0.0f);
+	}
+}
+
+static void TestIndexed(mt19937 &_rng)
+{
+	// every third record, out of order, the others keep what they had
+	const int count = 1001;
+	Transforms t = MakeTransforms(count, _rng);
+	vector<TransformRecord> records(count);
+	for (int i = 0; i < count; i++)
+	{
+		records[i] = t.GetRecord(i);
+	}
+
+	vector<int> indices;
+	for (int i = count - 1; i >= 0; i -= 3)
+	{
+		indices.push_back(i);
+	}
+
+	vector<XMFLOAT4X4> out(count);
+	memset(out.data(), 0, sizeof(XMFLOAT4X4) * out.size());
+	ComposeTransposedTRS(records.data(), indices.data(), (int)indices.size(), out.data());
+
+	float maxError = 0.0f;
+	int touched = 0;
+	for (int i = 0; i < count; i++)
+	{
+		if ((count - 1 - i) % 3 == 0)
+		{
+			maxError = fmaxf(maxError, MaxError(&out[i]._11, t.GetReference(i), 4));
+		}
+		else
+		{
+			touched += (out[i]._11 != 0.0f || out[i]._44 != 0.0f) ? 1 : 0;
+		}
+	}
+	CHECK(maxError <= 1e-4f);
+	CHECK(touched == 0);
+}
+
+int main()
+{
+	mt19937 rng(5);
+	TestStreams(rng);
+	TestPacked(rng);
+	TestIndexed(rng);
+	return TestResult("TransformTest");
+}
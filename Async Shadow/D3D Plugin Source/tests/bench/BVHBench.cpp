@@ -0,0 +1,110 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "ShadowBVH.h"
+#include "BenchCommon.h"
+#include <algorithm>
+#include <random>
+
+// cull time against caster count, linear scan with the best kernel against bvh refit plus traversal.
+// the light turns a little every frame, 1% of the casters move a few units in the moving run.
+static XMFLOAT4X4 LightTransform(float _radius, float _angle)
+{
+	XMVECTOR lightPos = XMVectorSet(0.0f, 50.0f, 0.0f, 0.0f);
+	XMVECTOR targetPos = XMVectorSet(0.3f * cosf(_angle), 49.0f, 0.3f * sinf(_angle), 0.0f);
+	XMMATRIX lightView = XMMatrixLookAtLH(lightPos, targetPos, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+	XMFLOAT3 center;
+	XMStoreFloat3(&center, XMVector3TransformCoord(XMVectorZero(), lightView));
+	XMMATRIX lightProj = XMMatrixOrthographicOffCenterLH(center.x - _radius, center.x + _radius,
+		center.y - _radius, center.y + _radius, center.z - _radius, center.z + _radius);
+
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, XMMatrixTranspose(lightView * lightProj));
+	return result;
+}
+
+static void Run(int _count, int _movers)
+{
+	const int frames = 20;
+
+	ShadowBoundsStore store;
+	store.Resize(_count);
+	mt19937 rng(1);
+	uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+	uniform_real_distribution<float> extent(0.5f, 10.0f);
+	uniform_real_distribution<float> step(-2.0f, 2.0f);
+	for (int i = 0; i < _count; i++)
+	{
+		store.SetBounds(i, BoundingBox(XMFLOAT3(position(rng), position(rng) * 0.1f, position(rng)), XMFLOAT3(extent(rng), extent(rng), extent(rng))));
+	}
+
+	ShadowCulling culling;
+	ShadowBVH bvh;
+	double buildMs = BestTimeMs(1, [&]() { bvh.Build(store); });
+
+	double linearMs = 0.0, bvhMs = 0.0;
+	int visibleCount = 0, mismatches = 0;
+	vector<int> linearVisible, bvhVisible;
+	for (int f = 0; f < frames; f++)
+	{
+		culling.SetFrustum(LightTransform(100.0f, f * 0.3f));
+		for (int m = 0; m < _movers; m++)
+		{
+			int i = (int)(rng() % _count);
+			BoundingBox bounds = store.GetBounds(i);
+			bounds.Center.x += step(rng);
+			bounds.Center.z += step(rng);
+			store.SetBounds(i, bounds);
+			bvh.MarkDirty(i);
+		}
+
+		linearMs += BestTimeMs(1, [&]() { culling.Cull(store, linearVisible); });
+		bvhMs += BestTimeMs(1, [&]()
+		{
+			bvh.Update(store);
+			bvh.Cull(culling.GetFrustum(), store, bvhVisible);
+		});
+
+		sort(bvhVisible.begin(), bvhVisible.end());
+		mismatches += (bvhVisible != linearVisible) ? 1 : 0;
+		visibleCount = (int)linearVisible.size();
+	}
+
+	printf("%10d %8d %10.2f %10.3f %10.3f %10d %6d\n", _count, _movers, buildMs, linearMs / frames, bvhMs / frames, visibleCount, mismatches);
+}
+
+int main()
+{
+	printf("%10s %8s %10s %10s %10s %10s %6s   (ms, cull is the mean of 20 frames)\n", "casters", "movers", "build", "linear", "bvh", "visible", "diff");
+	const int counts[] = { 1000, 10000, 100000, 1000000 };
+	for (int count : counts)
+	{
+		Run(count, 0);
+		Run(count, count / 100);
+	}
+
+	return 0;
+}
@@ -0,0 +1,46 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+#include <chrono>
+#include <cstdio>
+using namespace std;
+
+// best of _repeats runs in milliseconds, the best run is the one least disturbed by the rest of the machine
+template<typename Func>
+static double BestTimeMs(int _repeats, Func _func)
+{
+	double best = 1e30;
+	for (int i = 0; i < _repeats; i++)
+	{
+		auto start = chrono::high_resolution_clock::now();
+		_func();
+		double ms = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+		best = (ms < best) ? ms : best;
+	}
+
+	return best;
+}
+
+// keeps results alive so the compiler can't drop the measured work
+static volatile int benchSink = 0;
@@ -0,0 +1,380 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "BenchCommon.h"
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// the caster loops ShadowMap runs every frame, on the old parallel vectors and on the CasterRegistry columns.
+// CasterRegistry.h needs the d3d headers, the structs below mirror its layout and the old per frame command images.
+// cache misses come from the hardware counters where perf_event_open allows it, otherwise they are reported as unavailable.
+struct VertexView
+{
+	uint64_t location;
+	uint32_t size, stride;
+};
+
+struct IndexView
+{
+	uint64_t location;
+	uint32_t size, format;
+};
+
+struct DrawArgs
+{
+	uint32_t indexCount, instanceCount, startIndex;
+	int32_t baseVertex;
+	uint32_t startInstance;
+};
+
+// ShadowMap::ShadowIndirect
+struct ShadowIndirect
+{
+	uint64_t objectCbv;
+	uint64_t lightCbv;
+	VertexView vbv;
+	IndexView ibv;
+	DrawArgs drawIndexArgus;
+};
+
+// CasterDraw
+struct CasterDraw
+{
+	VertexView vbv;
+	IndexView ibv;
+};
+
+const int NumOfFrameResources = 3;
+const uint8_t CasterFlag_DirtyFrames = (1 << NumOfFrameResources) - 1;
+const uint8_t CasterFlag_Alive = 0x80;
+
+// one hardware counter for the calling thread, Read() returns -1 when it could not be opened
+class PerfCounter
+{
+public:
+	PerfCounter(uint32_t _type, uint64_t _config)
+	{
+#ifdef __linux__
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = _type;
+		attr.config = _config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	}
+
+	~PerfCounter()
+	{
+#ifdef __linux__
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+#endif
+	}
+
+	bool Valid() const
+	{
+		return fd >= 0;
+	}
+
+	void Start()
+	{
+#ifdef __linux__
+		if (fd >= 0)
+		{
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	long long Stop()
+	{
+		long long value = -1;
+#ifdef __linux__
+		if (fd >= 0)
+		{
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(fd, &value, sizeof(value)) != sizeof(value))
+			{
+				value = -1;
+			}
+		}
+#endif
+		return value;
+	}
+
+private:
+	int fd = -1;
+};
+
+#ifdef __linux__
+static PerfCounter llcMisses(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+static PerfCounter l1Misses(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#else
+static PerfCounter llcMisses(0, 0);
+static PerfCounter l1Misses(0, 0);
+#endif
+
+// distinct 64 byte lines a loop reads, counted on a separate untimed run
+static vector<uint8_t> lineSeen;
+static vector<uintptr_t> lineList;
+static bool trackLines = false;
+
+static inline void Touch(const void *_p, size_t _size)
+{
+	if (!trackLines)
+	{
+		return;
+	}
+
+	for (uintptr_t line = (uintptr_t)_p >> 6; line <= ((uintptr_t)_p + _size - 1) >> 6; line++)
+	{
+		size_t h = (line * 0x9E3779B97F4A7C15ull) >> 40;
+		size_t slot = h & (lineSeen.size() - 1);
+		bool found = false;
+		for (; lineSeen[slot]; slot = (slot + 1) & (lineSeen.size() - 1))
+		{
+			if (lineList[slot] == line)
+			{
+				found = true;
+				break;
+			}
+		}
+
+		if (!found)
+		{
+			lineSeen[slot] = 1;
+			lineList[slot] = line;
+		}
+	}
+}
+
+static size_t CountLines()
+{
+	size_t count = 0;
+	for (uint8_t seen : lineSeen)
+	{
+		count += seen;
+	}
+	return count;
+}
+
+// mean of 10 cold runs with the counters around each one, then one run that counts the lines read
+static vector<char> evict(64 << 20);
+template<typename Func>
+static void Measure(const char *_name, Func _func)
+{
+	const int runs = 10;
+	double totalMs = 0.0;
+	long long llc = 0;
+	long long l1 = 0;
+	for (int k = 0; k < runs; k++)
+	{
+		memset(evict.data(), k, evict.size());
+		llcMisses.Start();
+		l1Misses.Start();
+		auto start = chrono::high_resolution_clock::now();
+		_func();
+		totalMs += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+		l1 += l1Misses.Stop();
+		llc += llcMisses.Stop();
+	}
+
+	lineSeen.assign(1 << 20, 0);
+	lineList.assign(1 << 20, 0);
+	trackLines = true;
+	_func();
+	trackLines = false;
+	size_t lines = CountLines();
+
+	char llcText[32] = "n/a";
+	char l1Text[32] = "n/a";
+	if (llcMisses.Valid())
+	{
+		snprintf(llcText, sizeof(llcText), "%lld", llc / runs);
+	}
+	if (l1Misses.Valid())
+	{
+		snprintf(l1Text, sizeof(l1Text), "%lld", l1 / runs);
+	}
+	printf("%-28s %10.3f %12s %12s %10zu %10.1f\n", _name, totalMs / runs, l1Text, llcText, lines, lines * 64 / 1024.0);
+}
+
+int main()
+{
+	const int casterCount = 100000;
+	mt19937 rng(1);
+
+	// old layout, vertexBufferView, indexBufferView and a command image per frame resource
+	vector<VertexView> vertexBufferView(casterCount);
+	vector<IndexView> indexBufferView(casterCount);
+	vector<ShadowIndirect> shadowCommands[NumOfFrameResources];
+	vector<uint8_t> casterAlive(casterCount, 1);
+	vector<uint8_t> dirtyFrameMask(casterCount, CasterFlag_DirtyFrames);
+
+	// registry, one draw record and one flags byte per caster
+	vector<CasterDraw> draws(casterCount);
+	vector<uint8_t> flags(casterCount, CasterFlag_Alive | CasterFlag_DirtyFrames);
+
+	for (int i = 0; i < casterCount; i++)
+	{
+		vertexBufferView[i] = { (uint64_t)i * 4096, 1000, 32 };
+		indexBufferView[i] = { (uint64_t)i * 8192, 600, 42 };
+		draws[i] = { vertexBufferView[i], indexBufferView[i] };
+	}
+	for (int f = 0; f < NumOfFrameResources; f++)
+	{
+		shadowCommands[f].resize(casterCount);
+		for (int i = 0; i < casterCount; i++)
+		{
+			shadowCommands[f][i] = { (uint64_t)f * 1000000 + i * 256, 0, vertexBufferView[i], indexBufferView[i], { 150, 1, 0, 0, 0 } };
+		}
+	}
+	for (int i = 0; i < casterCount; i += 97)
+	{
+		casterAlive[i] = 0;
+		flags[i] &= ~CasterFlag_Alive;
+	}
+
+	// about half of the casters visible, a fifth on the upload list
+	vector<int> visible;
+	vector<int> uploadList;
+	for (int i = 0; i < casterCount; i++)
+	{
+		if (rng() % 2)
+		{
+			visible.push_back(i);
+		}
+		if (rng() % 5 == 0)
+		{
+			uploadList.push_back(i);
+		}
+	}
+	vector<ShadowIndirect> compacted(visible.size());
+
+	printf("perf counters: L1D read misses %s, cache misses %s\n", l1Misses.Valid() ? "available" : "unavailable", llcMisses.Valid() ? "available" : "unavailable");
+	printf("%d casters, %zu visible, %zu on the upload list, mean of 10 cold runs\n", casterCount, visible.size(), uploadList.size());
+	printf("%-28s %10s %12s %12s %10s %10s\n", "loop", "ms", "L1D misses", "LLC misses", "lines", "KB read");
+
+	// indirect compaction, the old path copied the frame's command image, the registry builds it from the draw record
+	Measure("compaction, parallel", [&]()
+	{
+		for (size_t k = 0; k < visible.size(); k++)
+		{
+			const ShadowIndirect &cmd = shadowCommands[1][visible[k]];
+			Touch(&cmd, sizeof(cmd));
+			compacted[k] = cmd;
+			compacted[k].lightCbv = 77;
+		}
+		benchSink += (int)compacted[7].objectCbv;
+	});
+
+	Measure("compaction, registry", [&]()
+	{
+		uint64_t base = 1000000;
+		for (size_t k = 0; k < visible.size(); k++)
+		{
+			int obj = visible[k];
+			const CasterDraw &draw = draws[obj];
+			Touch(&draw, sizeof(draw));
+			ShadowIndirect &cmd = compacted[k];
+			cmd.objectCbv = base + obj * 256;
+			cmd.lightCbv = 77;
+			cmd.vbv = draw.vbv;
+			cmd.ibv = draw.ibv;
+			cmd.drawIndexArgus = { draw.ibv.size / 4, 1, 0, 0, 0 };
+		}
+		benchSink += (int)compacted[7].objectCbv;
+	});
+
+	// upload list dirty bits, the alive filter on the visible set and marking every live caster dirty
+	Measure("dirty and alive, parallel", [&]()
+	{
+		int count = 0;
+		for (int obj : uploadList)
+		{
+			Touch(&dirtyFrameMask[obj], 1);
+			count += dirtyFrameMask[obj] & 2;
+		}
+		for (int obj : visible)
+		{
+			Touch(&casterAlive[obj], 1);
+			count += casterAlive[obj];
+		}
+		for (int i = 0; i < casterCount; i++)
+		{
+			Touch(&casterAlive[i], 1);
+			if (casterAlive[i])
+			{
+				Touch(&dirtyFrameMask[i], 1);
+				dirtyFrameMask[i] |= 2;
+			}
+		}
+		benchSink += count;
+	});
+
+	Measure("dirty and alive, registry", [&]()
+	{
+		int count = 0;
+		for (int obj : uploadList)
+		{
+			Touch(&flags[obj], 1);
+			count += flags[obj] & 2;
+		}
+		for (int obj : visible)
+		{
+			Touch(&flags[obj], 1);
+			count += flags[obj] >> 7;
+		}
+		for (int i = 0; i < casterCount; i++)
+		{
+			Touch(&flags[i], 1);
+			if (flags[i] & CasterFlag_Alive)
+			{
+				flags[i] |= 2;
+			}
+		}
+		benchSink += count;
+	});
+
+	printf("resident per caster: parallel %zu B of command images + 2 B flags, registry %zu B draw + 1 B flags\n",
+		NumOfFrameResources * sizeof(ShadowIndirect), sizeof(CasterDraw));
+
+	return 0;
+}
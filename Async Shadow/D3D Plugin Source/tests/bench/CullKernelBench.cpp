@@ -0,0 +1,103 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "ShadowCulling.h"
+#include "BenchCommon.h"
+#include <random>
+
+// per-object DirectXCollision test against the scalar, SSE and AVX2 batch kernels
+static XMFLOAT4X4 LightTransform(float _radius)
+{
+	XMMATRIX lightView = XMMatrixLookAtLH(XMVectorSet(0.0f, 50.0f, 0.0f, 0.0f), XMVectorSet(0.3f, 49.0f, 0.2f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+	XMFLOAT3 center;
+	XMStoreFloat3(&center, XMVector3TransformCoord(XMVectorZero(), lightView));
+	XMMATRIX lightProj = XMMatrixOrthographicOffCenterLH(center.x - _radius, center.x + _radius,
+		center.y - _radius, center.y + _radius, center.z - _radius, center.z + _radius);
+
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, XMMatrixTranspose(lightView * lightProj));
+	return result;
+}
+
+int main()
+{
+	static const char *kernelNames[] = { "scalar", "sse", "avx2" };
+	const int counts[] = { 10000, 100000, 1000000 };
+
+	ShadowCulling culling;
+	culling.SetFrustum(LightTransform(100.0f));
+	CullingKernel supported = ShadowCulling::GetSupportedKernel();
+
+	printf("%10s %12s", "casters", "per-object");
+	for (int k = CullingKernel_Scalar; k <= supported; k++)
+	{
+		printf(" %10s", kernelNames[k]);
+	}
+	printf("   (ms, best of 20)\n");
+
+	for (int count : counts)
+	{
+		// scene spread so roughly a third of the casters are visible
+		ShadowBoundsStore store;
+		store.Resize(count);
+		mt19937 rng(1);
+		uniform_real_distribution<float> position(-200.0f, 200.0f);
+		uniform_real_distribution<float> extent(0.5f, 10.0f);
+		for (int i = 0; i < count; i++)
+		{
+			store.SetBounds(i, BoundingBox(XMFLOAT3(position(rng), position(rng) * 0.3f, position(rng)), XMFLOAT3(extent(rng), extent(rng), extent(rng))));
+		}
+
+		vector<int> visible;
+		visible.reserve(count + 8);
+		double perObject = BestTimeMs(20, [&]()
+		{
+			visible.clear();
+			for (int i = 0; i < count; i++)
+			{
+				if (culling.TestBounds(store.GetBounds(i)))
+				{
+					visible.push_back(i);
+				}
+			}
+			benchSink = (int)visible.size();
+		});
+		printf("%10d %12.3f", count, perObject);
+
+		for (int k = CullingKernel_Scalar; k <= supported; k++)
+		{
+			culling.SetKernel((CullingKernel)k);
+			double ms = BestTimeMs(20, [&]()
+			{
+				benchSink = culling.Cull(store, visible);
+			});
+			printf(" %10.3f", ms);
+		}
+		printf("   %d visible\n", (int)visible.size());
+	}
+
+	return 0;
+}
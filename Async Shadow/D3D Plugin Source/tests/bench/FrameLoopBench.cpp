@@ -0,0 +1,154 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "FakeFence.h"
+#include "FramePacer.h"
+#include "JobSystem.h"
+#include "Threading.h"
+#include "BenchCommon.h"
+#include <algorithm>
+#include <vector>
+
+// the frame loop of RenderAPI_D3D12 without a device: the engine thread notifies the shadow worker every frame,
+// the worker runs its culling chunks through the job system and moves the frame pacer on against a fake queue.
+// engine frames, shadow CPU time and GPU time are fixed per run, what's measured is the scheduling around them.
+struct FrameLoopConfig
+{
+	const char *name;
+	float engineMs;		// engine frame period
+	float cpuMs;		// shadow thread work per frame, split in 8 job chunks
+	float gpuMs;		// fake GPU time per frame
+	float jitterMs;
+	float spinUs;		// FramePacer::SetSpinTime
+};
+
+static void SpinMs(float _ms)
+{
+	auto end = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<float, milli>(_ms));
+	while (chrono::steady_clock::now() < end)
+	{
+	}
+}
+
+static double Percentile(vector<double> &_values, int _percent)
+{
+	if (_values.empty())
+	{
+		return 0.0;
+	}
+
+	sort(_values.begin(), _values.end());
+	return _values[min(_values.size() - 1, _values.size() * _percent / 100)];
+}
+
+static void RunFrameLoop(const FrameLoopConfig &_config, JobSystem &_jobs, int _frames)
+{
+	const int numFrames = 3;
+	const int chunks = 8;
+	FakeFence fence(_config.gpuMs, _config.jitterMs, 1);
+	FramePacer pacer;
+	pacer.Init(&fence, numFrames, 1);
+	pacer.SetSpinTime(_config.spinUs);
+
+	// the engine stamps every notify, the worker reads the stamp when it wakes.
+	// only notifies after the previous shadow frame ended count as wake latency, the others were collapsed into a running frame
+	typedef chrono::steady_clock Clock;
+	auto origin = Clock::now();
+	atomic<int64_t> notifyNs(-1);
+	int64_t lastEndNs = 0;
+	atomic<int> shadowFrames(0);
+	vector<double> wakeUs;
+	vector<double> shadowMs;
+	wakeUs.reserve(_frames);
+	shadowMs.reserve(_frames);
+
+	ShadowWorker worker;
+	worker.Start([&]()
+	{
+		auto start = Clock::now();
+		int64_t stamp = notifyNs.load();
+		if (stamp > lastEndNs)
+		{
+			wakeUs.push_back((chrono::duration_cast<chrono::nanoseconds>(start - origin).count() - stamp) / 1000.0);
+		}
+
+		_jobs.ParallelFor(chunks, 1, [&](int, int, int) { SpinMs(_config.cpuMs / chunks); });
+		pacer.NextFrame();
+
+		shadowMs.push_back(chrono::duration<double, milli>(Clock::now() - start).count());
+		shadowFrames++;
+		lastEndNs = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - origin).count();
+	});
+
+	pacer.GetStats(true);
+	auto start = Clock::now();
+	auto nextFrame = start;
+	for (int f = 0; f < _frames; f++)
+	{
+		nextFrame += chrono::duration_cast<Clock::duration>(chrono::duration<float, milli>(_config.engineMs));
+		this_thread::sleep_until(nextFrame);
+
+		notifyNs = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - origin).count();
+		worker.Notify(0.0f);
+	}
+	worker.Stop();
+	double totalMs = chrono::duration<double, milli>(Clock::now() - start).count();
+	FenceStats stats = pacer.GetStats(true);
+
+	for (int i = 0; i < numFrames; i++)
+	{
+		pacer.Flush(i);
+	}
+
+	printf("%-24s %6.1f %6.1f %6.1f %6.1f %7d %7d %8.3f %8.1f %8.1f %8.3f %8.3f %7llu %7llu %8.2f %8.2f\n",
+		_config.name, _config.engineMs, _config.cpuMs, _config.gpuMs, _config.spinUs, _frames, shadowFrames.load(), totalMs / _frames,
+		Percentile(wakeUs, 50), Percentile(wakeUs, 99), Percentile(shadowMs, 50), Percentile(shadowMs, 99),
+		(unsigned long long)stats.stalls, (unsigned long long)stats.spinResolved, stats.stallMs, stats.maxStallMs);
+}
+
+int main()
+{
+	const FrameLoopConfig configs[] =
+	{
+		{ "cpu bound",			4.0f, 1.0f, 1.0f, 0.0f, 0.0f },
+		{ "gpu bound",			4.0f, 1.0f, 6.0f, 0.0f, 0.0f },
+		{ "gpu bound, spin",	4.0f, 1.0f, 6.0f, 0.0f, 100.0f },
+		{ "gpu at frame, jitter",	4.0f, 1.0f, 3.8f, 0.5f, 0.0f },
+		{ "gpu at frame, spin",	4.0f, 1.0f, 3.8f, 0.5f, 100.0f },
+	};
+
+	JobSystem jobs;
+	jobs.Init(0);
+	printf("job threads %d, hardware threads %u\n", jobs.GetThreadCount(), thread::hardware_concurrency());
+	printf("%-24s %6s %6s %6s %6s %7s %7s %8s %8s %8s %8s %8s %7s %7s %8s %8s\n", "run", "engine", "cpu", "gpu", "spinUs",
+		"frames", "shadow", "ms/frame", "wake p50", "wake p99", "shd p50", "shd p99", "stalls", "spun", "stall ms", "max ms");
+
+	for (const FrameLoopConfig &config : configs)
+	{
+		RunFrameLoop(config, jobs, 500);
+	}
+
+	return 0;
+}
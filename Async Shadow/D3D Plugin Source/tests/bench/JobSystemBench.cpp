@@ -0,0 +1,151 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "JobSystem.h"
+#include "ShadowCulling.h"
+#include "BenchCommon.h"
+#include <random>
+#include <string.h>
+#include <thread>
+
+// culling and object data packing split the way ShadowMap splits them, run on 1 to 8 threads.
+// one thread runs the chunks in a plain loop, the rest go through the job system.
+const int CullChunkSize = 4096;
+const int PackChunkSize = 1024;
+
+struct PackedObject
+{
+	XMFLOAT3X4 world;
+	int texIndex;
+};
+
+static XMFLOAT4X4 LightTransform(float _radius)
+{
+	XMMATRIX lightView = XMMatrixLookAtLH(XMVectorSet(0.0f, 50.0f, 0.0f, 0.0f), XMVectorSet(0.3f, 49.0f, 0.2f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+	XMFLOAT3 center;
+	XMStoreFloat3(&center, XMVector3TransformCoord(XMVectorZero(), lightView));
+	XMMATRIX lightProj = XMMatrixOrthographicOffCenterLH(center.x - _radius, center.x + _radius,
+		center.y - _radius, center.y + _radius, center.z - _radius, center.z + _radius);
+
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, XMMatrixTranspose(lightView * lightProj));
+	return result;
+}
+
+int main()
+{
+	const int count = 1000000;
+
+	ShadowBoundsStore store;
+	store.Resize(count);
+	vector<XMFLOAT4X4> world(count);
+	mt19937 rng(1);
+	uniform_real_distribution<float> position(-200.0f, 200.0f);
+	uniform_real_distribution<float> extent(0.5f, 10.0f);
+	for (int i = 0; i < count; i++)
+	{
+		XMFLOAT3 center(position(rng), position(rng) * 0.3f, position(rng));
+		store.SetBounds(i, BoundingBox(center, XMFLOAT3(extent(rng), extent(rng), extent(rng))));
+		XMStoreFloat4x4(&world[i], XMMatrixTranspose(XMMatrixTranslation(center.x, center.y, center.z)));
+	}
+
+	ShadowCulling culling;
+	culling.SetFrustum(LightTransform(100.0f));
+
+	int numChunks = (count + CullChunkSize - 1) / CullChunkSize;
+	vector<vector<int>> cullChunks(numChunks, vector<int>(CullChunkSize + 8));
+	vector<int> cullChunkCount(numChunks);
+	vector<int> visible;
+	vector<PackedObject> packed(count);
+
+	printf("%d casters, %u hardware threads\n", count, thread::hardware_concurrency());
+	printf("%8s %10s %10s %10s %8s   (ms, best of 10)\n", "threads", "cull", "pack", "total", "speedup");
+
+	double baseline = 0.0;
+	const int threadCounts[] = { 1, 2, 4, 8 };
+	for (int threads : threadCounts)
+	{
+		JobSystem jobs;
+		if (threads > 1)
+		{
+			jobs.Init(threads - 1);
+		}
+
+		auto parallelFor = [&](int _count, int _chunkSize, const function<void(int, int, int)> &_func)
+		{
+			if (threads > 1)
+			{
+				jobs.ParallelFor(_count, _chunkSize, _func);
+				return;
+			}
+
+			for (int begin = 0, chunk = 0; begin < _count; begin += _chunkSize, chunk++)
+			{
+				_func(begin, min(begin + _chunkSize, _count), chunk);
+			}
+		};
+
+		double cullMs = BestTimeMs(10, [&]()
+		{
+			parallelFor(count, CullChunkSize, [&](int _begin, int _end, int _chunk)
+			{
+				cullChunkCount[_chunk] = culling.CullRange(store, _begin, _end, cullChunks[_chunk].data());
+			});
+
+			// merged in chunk order, same as ShadowMap
+			int total = 0;
+			for (int i = 0; i < numChunks; i++)
+			{
+				total += cullChunkCount[i];
+			}
+			visible.resize(total);
+			for (int i = 0, offset = 0; i < numChunks; offset += cullChunkCount[i], i++)
+			{
+				memcpy(visible.data() + offset, cullChunks[i].data(), sizeof(int) * cullChunkCount[i]);
+			}
+		});
+
+		double packMs = BestTimeMs(10, [&]()
+		{
+			parallelFor((int)visible.size(), PackChunkSize, [&](int _begin, int _end, int _chunk)
+			{
+				for (int i = _begin; i < _end; i++)
+				{
+					int obj = visible[i];
+					memcpy(&packed[i].world, &world[obj], sizeof(XMFLOAT3X4));
+					packed[i].texIndex = obj & 15;
+				}
+			});
+		});
+
+		double total = cullMs + packMs;
+		baseline = (threads == 1) ? total : baseline;
+		printf("%8d %10.3f %10.3f %10.3f %8.2f\n", threads, cullMs, packMs, total, baseline / total);
+	}
+
+	benchSink = (int)visible.size();
+	return 0;
+}
@@ -0,0 +1,237 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+
+
+#include "StreamCopy.h"
+#include "BenchCommon.h"
+#include <algorithm>
+#include <random>
+#include <stdlib.h>
+#include <vector>
+
+// per element memcpy in dirty order and in slot order, against sorted runs staged and streamed with non-temporal stores.
+// ordinary host memory stands in for the upload heap, which is enough to see the store pattern.
+// HostBuffer and StreamRuns below mirror UploadBuffer and the staging in ShadowMap.cpp.
+struct ObjectConstants
+{
+	float world[16];
+	unsigned int texIndex;
+	float padding[47];
+};
+
+struct ObjectData
+{
+	float world[12];
+	unsigned int texIndex;
+};
+
+struct IndirectCommand
+{
+	uint64_t cbv;
+	uint64_t srv;
+	uint64_t vbLocation;
+	unsigned int vbSize, vbStride;
+	uint64_t ibLocation;
+	unsigned int ibSize, ibFormat;
+	unsigned int drawArgs[5];
+	unsigned int padding;
+};
+
+template<typename T>
+class HostBuffer
+{
+public:
+	HostBuffer(int _count, size_t _elementSize) : elementSize(_elementSize)
+	{
+		data = (uint8_t*)_mm_malloc(_count * _elementSize, 256);
+	}
+
+	~HostBuffer()
+	{
+		_mm_free(data);
+	}
+
+	void CopyData(int _index, const T &_data)
+	{
+		memcpy(&data[_index * elementSize], &_data, sizeof(T));
+	}
+
+	void CopyRange(int _first, const T *_data, int _count)
+	{
+		if (sizeof(T) * _count < 128)
+		{
+			for (int i = 0; i < _count; i++)
+			{
+				CopyData(_first + i, _data[i]);
+			}
+			return;
+		}
+
+		if (elementSize == sizeof(T))
+		{
+			StreamCopy(&data[_first * elementSize], _data, sizeof(T) * _count);
+			return;
+		}
+
+		for (int i = 0; i < _count; i++)
+		{
+			StreamCopy(&data[(_first + i) * elementSize], &_data[i], sizeof(T));
+		}
+	}
+
+private:
+	uint8_t *data;
+	size_t elementSize;
+};
+
+template<typename T, typename Slot, typename Pack>
+static void StreamRuns(HostBuffer<T> &_buffer, int _begin, int _end, Slot _slot, Pack _pack)
+{
+	static const int StageCount = (4096 / sizeof(T) > 0) ? 4096 / sizeof(T) : 1;
+	T stage[StageCount];
+	int runStart = 0;
+	int runCount = 0;
+
+	for (int i = _begin; i < _end; i++)
+	{
+		int slot = _slot(i);
+		if (runCount == StageCount || (runCount > 0 && slot != runStart + runCount))
+		{
+			_buffer.CopyRange(runStart, stage, runCount);
+			runCount = 0;
+		}
+
+		if (runCount == 0)
+		{
+			runStart = slot;
+		}
+		_pack(i, stage[runCount++]);
+	}
+
+	if (runCount > 0)
+	{
+		_buffer.CopyRange(runStart, stage, runCount);
+	}
+	StreamFence();
+}
+
+// mean of 10 runs, the caches are flushed with unrelated writes before each one
+static vector<char> evict(64 << 20);
+template<typename Func>
+static double ColdTimeMs(Func _func)
+{
+	double total = 0.0;
+	for (int k = 0; k < 10; k++)
+	{
+		memset(evict.data(), k, evict.size());
+		total += BestTimeMs(1, _func);
+	}
+	return total / 10.0;
+}
+
+template<typename T>
+static void RunScattered(const char *_name, int _count, int _dirty, size_t _elementSize)
+{
+	mt19937 rng(1);
+	vector<int> dirty(_count);
+	for (int i = 0; i < _count; i++)
+	{
+		dirty[i] = i;
+	}
+	shuffle(dirty.begin(), dirty.end(), rng);
+	dirty.resize(_dirty);
+
+	vector<T> source(_count);
+	memset(source.data(), 1, sizeof(T) * _count);
+	HostBuffer<T> buffer(_count, _elementSize);
+
+	double memcpyMs = ColdTimeMs([&]()
+	{
+		for (int i = 0; i < _dirty; i++)
+		{
+			buffer.CopyData(dirty[i], source[dirty[i]]);
+		}
+	});
+
+	// ShadowMap sorts the upload list before streaming, timed on its own here
+	vector<int> sorted(_dirty);
+	double sortMs = ColdTimeMs([&]()
+	{
+		sorted = dirty;
+		sort(sorted.begin(), sorted.end());
+	});
+
+	double sortedMemcpyMs = ColdTimeMs([&]()
+	{
+		for (int i = 0; i < _dirty; i++)
+		{
+			buffer.CopyData(sorted[i], source[sorted[i]]);
+		}
+	});
+
+	double streamMs = ColdTimeMs([&]()
+	{
+		StreamRuns(buffer, 0, _dirty, [&](int i) { return sorted[i]; }, [&](int i, T &_data) { _data = source[sorted[i]]; });
+	});
+
+	printf("%-22s %8d %8d %10.3f %10.3f %10.3f %10.3f\n", _name, _count, _dirty, memcpyMs, sortMs, sortedMemcpyMs, streamMs);
+}
+
+int main()
+{
+	printf("%-22s %8s %8s %10s %10s %10s %10s   (ms, mean of 10, cold caches)\n", "buffer", "objects", "dirty", "memcpy", "sort", "sorted", "stream");
+	const int dirtyCounts[] = { 1000, 10000, 100000 };
+	for (int dirty : dirtyCounts)
+	{
+		RunScattered<ObjectConstants>("ObjectConstants 256B", 100000, dirty, 256);
+		RunScattered<ObjectData>("ObjectData 52B", 100000, dirty, sizeof(ObjectData));
+		RunScattered<ObjectData>("ObjectData 52B", 1000000, dirty * 10, sizeof(ObjectData));
+	}
+
+	// indirect compaction, every other command lands in the next free slot
+	const int count = 100000;
+	vector<IndirectCommand> commands(count);
+	memset(commands.data(), 1, sizeof(IndirectCommand) * count);
+	vector<int> visible;
+	for (int i = 0; i < count; i += 2)
+	{
+		visible.push_back(i);
+	}
+	HostBuffer<IndirectCommand> buffer(count, sizeof(IndirectCommand));
+
+	double memcpyMs = ColdTimeMs([&]()
+	{
+		for (int i = 0; i < (int)visible.size(); i++)
+		{
+			buffer.CopyData(i, commands[visible[i]]);
+		}
+	});
+	double streamMs = ColdTimeMs([&]()
+	{
+		StreamRuns(buffer, 0, (int)visible.size(), [](int i) { return i; }, [&](int i, IndirectCommand &_command) { _command = commands[visible[i]]; });
+	});
+	printf("%-22s %8d %8d %10.3f %10s %10s %10.3f\n", "IndirectCommand 72B", count, (int)visible.size(), memcpyMs, "-", "-", streamMs);
+
+	return 0;
+}
@@ -0,0 +1,43 @@
+//MIT License
+//
+//Copyright(c) 2018 Chieh Hung Liu(Squall Liu)
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files(the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions :
+//
+//The above copyright notice and this permission notice shall be included in all
+//copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+//SOFTWARE.
+
+
+#pragma once
+// msvc intrinsics the plugin sources use, mapped onto gcc and clang builtins for the tests
+#include <immintrin.h>
+#include <cpuid.h>
+
+#undef __cpuid
+static inline void __cpuid(int _info[4], int _leaf)
+{
+	__cpuid_count(_leaf, 0, _info[0], _info[1], _info[2], _info[3]);
+}
+
+static inline void *_aligned_malloc(size_t _size, size_t _alignment)
+{
+	return _mm_malloc(_size, _alignment);
+}
+
+static inline void _aligned_free(void *_ptr)
+{
+	_mm_free(_ptr);
+}